@@ -0,0 +1,155 @@
+#include "application/radosgw-admin/HttpServer.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <map>
+#include <string>
+
+namespace
+{
+  struct MockUser
+  {
+    std::string displayName_;
+    std::string email_;
+
+  }; // struct
+
+  /** Users by uid and the uid of each email, as a gateway would keep them */
+  std::map<std::string, MockUser> users;
+  std::map<std::string, std::string> emails;
+
+  /** Every failEvery'th request is answered 503, none if zero */
+  unsigned long failEvery = 0;
+  unsigned long requests = 0;
+
+  std::string quoted(const std::string& value)
+  {
+    std::string text = "\"";
+    for ( char character : value )
+    {
+      if ( character == '"' || character == '\\' )
+      {
+        text.push_back('\\');
+        text.push_back(character);
+      }
+      else if ( static_cast<unsigned char>(character) < 0x20 )
+      {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+        text.append(escaped);
+      }
+      else
+      {
+        text.push_back(character);
+      }
+    }
+    return text + "\"";
+  }
+
+  basic::HttpResponse reply(int status, const std::string& body)
+  {
+    basic::HttpResponse response;
+    response.status_ = status;
+    response.contentType_ = body.empty() ? "" : "application/json";
+    response.body_ = body;
+    return response;
+  }
+
+  basic::HttpResponse error(int status, const std::string& code)
+  {
+    return reply(status, "{\"Code\":\"" + code + "\",\"RequestId\":\"tx000000000000000000001-mock\",\"HostId\":\"mock\"}");
+  }
+
+  /** A user as RGW describes one, with the fields radosgw-admin doesn't keep around the ones it does */
+  basic::HttpResponse describe(const std::string& uid, const MockUser& user)
+  {
+    return reply(200, "{\"tenant\":\"\",\"user_id\":" + quoted(uid) + ",\"display_name\":" + quoted(user.displayName_)
+                      + ",\"email\":" + quoted(user.email_) + ",\"suspended\":0,\"max_buckets\":1000,\"subusers\":[],"
+                      "\"keys\":[{\"user\":" + quoted(uid) + ",\"access_key\":\"MOCKACCESSKEY\",\"secret_key\":"
+                      "\"mock/secret\\\"key\"}],\"swift_keys\":[],\"caps\":[{\"type\":\"users\",\"perm\":\"*\"}],"
+                      "\"op_mask\":\"read, write, delete\",\"bucket_quota\":{\"enabled\":false,\"max_size\":-1}}");
+  }
+
+  basic::HttpResponse handle(const basic::HttpRequest& request)
+  {
+    if ( failEvery && ++requests % failEvery == 0 )
+    {
+      return error(503, "ServiceUnavailable");
+    }
+    if ( request.path_ != "/admin/user" && request.path_ != "/admin/user/" )
+    {
+      return error(404, "NoSuchKey");
+    }
+
+    std::map<std::string, std::string>::const_iterator uid = request.query_.find("uid");
+    if ( uid == request.query_.end() || uid->second.empty() )
+    {
+      return error(400, "InvalidArgument");
+    }
+    std::map<std::string, MockUser>::iterator user = users.find(uid->second);
+
+    if ( request.method_ == "GET" )
+    {
+      return user == users.end() ? error(404, "NoSuchUser") : describe(user->first, user->second);
+    }
+    if ( request.method_ == "DELETE" )
+    {
+      if ( user == users.end() )
+      {
+        return error(404, "NoSuchUser");
+      }
+      emails.erase(user->second.email_);
+      users.erase(user);
+      return reply(200, "");
+    }
+    if ( request.method_ != "PUT" )
+    {
+      return error(405, "MethodNotAllowed");
+    }
+
+    if ( user != users.end() )
+    {
+      return error(409, "UserAlreadyExists");
+    }
+    MockUser created;
+    std::map<std::string, std::string>::const_iterator value = request.query_.find("display-name");
+    created.displayName_ = value == request.query_.end() ? "" : value->second;
+    value = request.query_.find("email");
+    created.email_ = value == request.query_.end() ? "" : value->second;
+    if ( ! created.email_.empty() && ! emails.insert(std::make_pair(created.email_, uid->second)).second )
+    {
+      return error(409, "EmailExists");
+    }
+    return describe(uid->second, users.insert(std::make_pair(uid->second, created)).first->second);
+  }
+
+} // namespace
+
+/** Stand-in for an RGW admin ops endpoint, for trying radosgw-admin --endpoint without a gateway
+ *
+ * Serves the user resource from memory on 127.0.0.1 until interrupted.
+ */
+int main(int argc, char** argv)
+{
+  if ( argc < 2 )
+  {
+    std::fprintf(stderr, "Usage: admin-mock <port> [fail-every]\n");
+    return 1;
+  }
+  failEvery = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0;
+
+  try
+  {
+    basic::HttpServer server(static_cast<uint16_t>(std::strtoul(argv[1], nullptr, 10)));
+    std::printf("Serving the admin ops user API on 127.0.0.1:%u\n", static_cast<unsigned>(server.port()));
+    std::fflush(stdout);
+    server.run(handle);
+  }
+  catch(std::exception& e)
+  {
+    std::fprintf(stderr, "ERROR: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,26 @@
+
+-----------------------------------------------------------------------------------------------------------------------
+project "admin-mock"
+  language "C++"
+  kind "ConsoleApp"
+
+  files { "*.cpp", "*.hpp",
+          "../radosgw-admin/HttpServer.cpp", "../radosgw-admin/HttpServer.hpp" }
+
+  libdirs { "../../boost/stage/lib" }
+  includedirs { "../../boost", "../../" }
+
+  targetdir( "../../builds/bin")
+
+  configuration { "gmake" }
+    linkoptions { "-static -pthread" }
+    buildoptions { "-std=c++11" }
+
+  configuration "Debug"
+       defines { "DEBUG" }
+       flags { "Symbols" }
+
+  configuration "Release"
+      defines { "NDEBUG" }
+      flags { "Optimize" }
+
@@ -0,0 +1,623 @@
+#include "oberon/ArgvParser.hpp"
+#include "oberon/OptionCollection.hpp"
+#include "oberon/Subcommand.hpp"
+#include "oberon/SubcommandCLI.hpp"
+#include "oberon/SubcommandCollection.hpp"
+
+#include "boost/optional.hpp"
+#include "boost/program_options.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace
+{
+  /** Every operator new in the process, counted by the replacements below for the allocations per operation */
+  std::atomic<uint64_t> allocations(0);
+
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+/** Both are kept out of line, where GCC would see through them to malloc() and free() and take every delete for a
+ *  mismatch */
+void* operator new(size_t size) __attribute__((noinline));
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if ( void* memory = std::malloc(size ? size : 1) )
+  {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete(void* memory) noexcept __attribute__((noinline));
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+namespace
+{
+  namespace po = boost::program_options;
+
+  const int SUCCESS = 0;
+  const int FAILURE = 1;
+
+  typedef std::chrono::steady_clock Clock;
+  typedef std::function<int(const std::vector<std::string>&)> Benchmark;
+
+  const unsigned DEFAULT_PARSER_LINES = 20 * 1000;
+  const unsigned OPTIONS_PER_LINE = 6;
+  const unsigned SHORT_NAMES = 26;
+
+  const unsigned DEFAULT_STARTUP_RUNS = 100;
+  const char* const DEFAULT_STARTUP_ARGUMENT = "--version";
+
+  const unsigned DEFAULT_MAX_SUBCOMMANDS = 1000;
+  const unsigned DEFAULT_MAX_SUBCOMMAND_OPTIONS = 500;
+  const unsigned DEFAULT_SAMPLES = 200;
+  const unsigned MIN_SAMPLES = 5;
+  const Clock::duration SAMPLE_BUDGET = std::chrono::seconds(2); // per phase and collection size, after MIN_SAMPLES
+  const unsigned SUBCOMMAND_COUNTS[] = { 10, 100, 1000 };
+  const unsigned SUBCOMMAND_OPTION_COUNTS[] = { 10, 100, 500 };
+  const unsigned SYNTHETIC_LINES = 64;
+  const unsigned OPTIONS_PER_SUBCOMMAND_LINE = 4;
+
+  double nanosecondsPer(Clock::duration elapsed, uint64_t operations)
+  {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+  }
+
+  double ratio(Clock::duration numerator, Clock::duration denominator)
+  {
+    return std::chrono::duration<double>(numerator).count() / std::chrono::duration<double>(denominator).count();
+  }
+
+  /** Latencies of an operation, sorted, and the allocations it made over all of them */
+  struct Distribution
+  {
+    std::vector<double> microseconds_;
+    uint64_t allocations_;
+
+    double percentile(unsigned percent) const { return microseconds_[(microseconds_.size() - 1) * percent / 100]; }
+
+  }; // struct
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Time the operation up to samples times, fewer if they take longer than SAMPLE_BUDGET between them, each after an
+   *  untimed call to prepare, which is where state a sample consumes is made and the previous sample's freed
+   */
+  Distribution sample(unsigned samples, const std::function<void()>& prepare, const std::function<void()>& operation)
+  {
+    Distribution distribution = Distribution();
+    Clock::duration spent = Clock::duration::zero();
+    while ( distribution.microseconds_.size() < samples
+            && (distribution.microseconds_.size() < MIN_SAMPLES || spent < SAMPLE_BUDGET) )
+    {
+      prepare();
+      uint64_t allocationsBefore = allocations.load();
+      Clock::time_point start = Clock::now();
+      operation();
+      Clock::duration elapsed = Clock::now() - start;
+      distribution.allocations_ += allocations.load() - allocationsBefore;
+
+      spent += elapsed;
+      distribution.microseconds_.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+
+    std::sort(distribution.microseconds_.begin(), distribution.microseconds_.end());
+    return distribution;
+  }
+
+  /** Every third option is a switch, every third takes an int and the rest a string, the first 26 have a short name
+   *  as well, so lines exercise each kind of token the parsers resolve
+   */
+  void syntheticOptions(unsigned count,
+                        po::options_description& options,
+                        po::positional_options_description& positional)
+  {
+    for (unsigned index = 0; index < count; ++index)
+    {
+      std::string name = "synthetic-option-" + std::to_string(index);
+      if ( index < SHORT_NAMES )
+      {
+        name += "," + std::string(1, static_cast<char>('a' + index));
+      }
+
+      switch (index % 3)
+      {
+        case 0:  options.add_options()(name.c_str(), "a switch"); break;
+        case 1:  options.add_options()(name.c_str(), po::value<int>(), "an int"); break;
+        default: options.add_options()(name.c_str(), po::value<std::string>(), "a string"); break;
+      }
+    }
+    options.add_options()("positional", po::value<std::vector<std::string> >(), "the positionals");
+    positional.add("positional", -1);
+  }
+
+  /** A line of distinct options spelled every way the default style allows, with a positional or two among them */
+  std::vector<std::string> syntheticLine(unsigned optionCount, std::mt19937& random)
+  {
+    std::vector<std::string> line;
+    std::vector<bool> used(optionCount, false);
+    for (unsigned option = 0; option < OPTIONS_PER_LINE && option < optionCount; ++option)
+    {
+      unsigned index = random() % optionCount;
+      while ( used[index] )
+      {
+        index = (index + 1) % optionCount;
+      }
+      used[index] = true;
+
+      std::string name = "synthetic-option-" + std::to_string(index);
+      std::string value = index % 3 == 1 ? std::to_string(random() % 1000) : "value" + std::to_string(random() % 1000);
+      unsigned spelling = random() % 4;
+      if ( index % 3 == 0 )
+      {
+        line.push_back(index < SHORT_NAMES && spelling < 2 ? "-" + std::string(1, static_cast<char>('a' + index))
+                                                           : "--" + name);
+      }
+      else if ( index < SHORT_NAMES && spelling == 0 )
+      {
+        line.push_back("-" + std::string(1, static_cast<char>('a' + index)) + value);
+      }
+      else if ( spelling == 1 )
+      {
+        line.push_back("--" + name + "=" + value);
+      }
+      else
+      {
+        line.push_back("--" + name);
+        line.push_back(value);
+      }
+
+      if ( random() % 3 == 0 )
+      {
+        line.push_back("positional" + std::to_string(option));
+      }
+    }
+    return line;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Cost of parsing and storing a command line with boost::program_options::command_line_parser and with
+   *  oberon::ArgvParser, the two engines SubcommandCLI can be built with, as the number of options grows
+   *
+   * Times are ns per line, for parsing alone and for parsing and storing into a variables_map.
+   * args: [lines], command lines parsed per option count (default 20000).
+   */
+  int parserBenchmark(const std::vector<std::string>& args)
+  {
+    unsigned lineCount = args.empty() ? DEFAULT_PARSER_LINES : std::stoul(args[0]);
+
+    std::printf("%10s %14s %14s %10s %14s %14s %10s\n", "options", "boost parse", "native parse", "speedup",
+                "boost +store", "native +store", "speedup");
+    for (unsigned optionCount : { 10u, 50u, 200u, 500u })
+    {
+      po::options_description options;
+      po::positional_options_description positional;
+      syntheticOptions(optionCount, options, positional);
+      oberon::ArgvParser parser(options, positional);
+
+      /** The lines are made up front, and held as views the way tokenise() hands argv to the native parser */
+      std::mt19937 random(optionCount);
+      std::vector<std::vector<std::string> > lines;
+      std::vector<oberon::ArgvParser::Tokens> tokens;
+      for (unsigned line = 0; line < lineCount; ++line)
+      {
+        lines.push_back(syntheticLine(optionCount, random));
+      }
+      for (const std::vector<std::string>& line : lines)
+      {
+        tokens.push_back(oberon::ArgvParser::Tokens(line.begin(), line.end()));
+      }
+
+      /** Parsing alone, then parsing and storing, which is where typing, defaults and required options are handled */
+      size_t parsedCount = 0, storedCount = 0;
+      Clock::time_point start = Clock::now();
+      for (const std::vector<std::string>& line : lines)
+      {
+        parsedCount += po::command_line_parser(line).options(options).positional(positional).run().options.size();
+      }
+      Clock::duration boostParseTime = Clock::now() - start;
+
+      start = Clock::now();
+      for (const oberon::ArgvParser::Tokens& line : tokens)
+      {
+        parsedCount -= parser.parse(line).options.size();
+      }
+      Clock::duration nativeParseTime = Clock::now() - start;
+
+      start = Clock::now();
+      for (const std::vector<std::string>& line : lines)
+      {
+        po::variables_map vm;
+        po::store(po::command_line_parser(line).options(options).positional(positional).run(), vm);
+        storedCount += vm.size();
+      }
+      Clock::duration boostTime = Clock::now() - start;
+
+      start = Clock::now();
+      for (const oberon::ArgvParser::Tokens& line : tokens)
+      {
+        po::variables_map vm;
+        po::store(parser.parse(line), vm);
+        storedCount -= vm.size();
+      }
+      Clock::duration nativeTime = Clock::now() - start;
+
+      /** The timed runs only compare sizes, every line is checked option by option here */
+      for (unsigned line = 0; line < lineCount; ++line)
+      {
+        po::parsed_options expected = po::command_line_parser(lines[line]).options(options)
+                                                                           .positional(positional).run();
+        po::parsed_options native = parser.parse(tokens[line]);
+        bool same = parsedCount == 0 && storedCount == 0 && expected.options.size() == native.options.size();
+        for (size_t option = 0; same && option < native.options.size(); ++option)
+        {
+          same = expected.options[option].string_key == native.options[option].string_key
+                 && expected.options[option].position_key == native.options[option].position_key
+                 && expected.options[option].value == native.options[option].value
+                 && expected.options[option].original_tokens == native.options[option].original_tokens;
+        }
+        if ( ! same )
+        {
+          std::cerr << "ERROR: the parsers disagree on line " << line << " with " << optionCount << " options"
+                    << std::endl;
+          return FAILURE;
+        }
+      }
+
+      std::printf("%10u %14.1f %14.1f %10.2f %14.1f %14.1f %10.2f\n", optionCount,
+                  nanosecondsPer(boostParseTime, lineCount), nanosecondsPer(nativeParseTime, lineCount),
+                  ratio(boostParseTime, nativeParseTime), nanosecondsPer(boostTime, lineCount),
+                  nanosecondsPer(nativeTime, lineCount), ratio(boostTime, nativeTime));
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** The path of a binary built alongside this one */
+  std::string siblingBinary(const std::string& name)
+  {
+    char self[PATH_MAX];
+    ssize_t length = ::readlink("/proc/self/exe", self, sizeof(self) - 1);
+    std::string path = length > 0 ? std::string(self, length) : std::string();
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? name : path.substr(0, slash + 1) + name;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Wall time from spawning a process to reaping it, with its output discarded, and the peak RSS of the largest run
+   *
+   * args: [runs] [binary [args...]], runs defaults to 100 and the binary to the radosgw-admin built alongside this one,
+   * run as radosgw-admin --version. Any arguments after the binary are passed to it instead. Every run starts a new
+   * process but the binary and its libraries stay in the page cache, so this is start up without the disk reads.
+   */
+  int startupBenchmark(const std::vector<std::string>& args)
+  {
+    unsigned runs = args.empty() ? DEFAULT_STARTUP_RUNS : std::stoul(args[0]);
+    std::vector<std::string> command;
+    if ( args.size() > 1 )
+    {
+      command.assign(args.begin() + 1, args.end());
+    }
+    else
+    {
+      command = { siblingBinary("radosgw-admin"), DEFAULT_STARTUP_ARGUMENT };
+    }
+    if ( command.size() == 1 )
+    {
+      command.push_back(DEFAULT_STARTUP_ARGUMENT);
+    }
+    if ( ::access(command[0].c_str(), X_OK) != 0 )
+    {
+      std::cerr << "ERROR: " << command[0] << " isn't an executable" << std::endl;
+      return FAILURE;
+    }
+
+    std::vector<char*> argv;
+    for (std::string& argument : command)
+    {
+      argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t discardOutput;
+    ::posix_spawn_file_actions_init(&discardOutput);
+    ::posix_spawn_file_actions_addopen(&discardOutput, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    ::posix_spawn_file_actions_addopen(&discardOutput, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    bool failed = false;
+    long peakKilobytes = 0;
+    auto run = [&]()
+    {
+      pid_t pid = 0;
+      int status = 0;
+      struct rusage usage = rusage();
+      failed = ::posix_spawn(&pid, argv[0], &discardOutput, nullptr, argv.data(), environ) != 0
+               || ::wait4(pid, &status, 0, &usage) != pid || ! WIFEXITED(status) || failed;
+      peakKilobytes = std::max(peakKilobytes, usage.ru_maxrss);
+    };
+    Distribution distribution = sample(runs, []() {}, run);
+    ::posix_spawn_file_actions_destroy(&discardOutput);
+
+    if ( failed )
+    {
+      std::cerr << "ERROR: " << command[0] << " couldn't be run to completion" << std::endl;
+      return FAILURE;
+    }
+
+    std::printf("%8s %10s %10s %10s %10s %12s\n", "runs", "p50 ms", "p90 ms", "p99 ms", "max ms", "peak RSS MB");
+    std::printf("%8zu %10.2f %10.2f %10.2f %10.2f %12.1f\n", distribution.microseconds_.size(),
+                distribution.percentile(50) / 1000, distribution.percentile(90) / 1000,
+                distribution.percentile(99) / 1000, distribution.microseconds_.back() / 1000, peakKilobytes / 1024.0);
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::string syntheticSubcommandName(unsigned index)
+  {
+    return "command-" + std::to_string(index);
+  }
+
+  /** Names are unique across subcommands, which a collection requires of options that aren't shared */
+  std::string syntheticSubcommandOption(unsigned subcommand, unsigned option)
+  {
+    return "c" + std::to_string(subcommand) + "-option-" + std::to_string(option);
+  }
+
+//**********************************************************************************************************************
+  /** A subcommand with a number of options of its own, of the same three kinds as syntheticOptions() makes
+   */
+  class SyntheticSubcommand : public oberon::Subcommand
+  {
+  public: // interface
+    SyntheticSubcommand(unsigned index, unsigned optionCount) :
+      oberon::Subcommand(syntheticSubcommandName(index), "a generated subcommand for benchmarking"),
+      index_(index),
+      optionCount_(optionCount)
+    {
+      /** **/
+    }
+
+    po::options_description uniqueOptions(bool includeHidden, bool enableRestrictions) const
+    {
+      po::options_description returnOptions;
+      for (unsigned option = 0; option < optionCount_; ++option)
+      {
+        std::string name = syntheticSubcommandOption(index_, option);
+        switch (option % 3)
+        {
+          case 0:  returnOptions.add_options()(name.c_str(), "a switch"); break;
+          case 1:  returnOptions.add_options()(name.c_str(), getOptionValue<int>(), "an int"); break;
+          default: returnOptions.add_options()(name.c_str(), getOptionValue<std::string>(), "a string"); break;
+        }
+      }
+
+      return returnOptions;
+    }
+
+  private: // data
+    unsigned index_;
+    unsigned optionCount_;
+
+  }; // class
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** The subcommands are registered with creators, a collection sized at run time can't be a SubcommandTable */
+  std::unique_ptr<oberon::SubcommandCollection> syntheticCollection(unsigned subcommandCount, unsigned optionCount)
+  {
+    std::unique_ptr<oberon::SubcommandCollection> collection(new oberon::SubcommandCollection());
+    for (unsigned index = 0; index < subcommandCount; ++index)
+    {
+      collection->add(syntheticSubcommandName(index), [index, optionCount]()
+                                                      {
+                                                        return oberon::SubcommandCollection::SubcommandPtr(
+                                                          new SyntheticSubcommand(index, optionCount));
+                                                      });
+    }
+    return collection;
+  }
+
+  /** A subcommand and distinct options of its own, a value following those that take one */
+  std::vector<std::string> syntheticSubcommandLine(unsigned subcommandCount, unsigned optionCount, std::mt19937& random)
+  {
+    unsigned subcommand = random() % subcommandCount;
+    std::vector<std::string> line = { "oberon-bench", syntheticSubcommandName(subcommand) };
+    unsigned options = std::min(OPTIONS_PER_SUBCOMMAND_LINE, optionCount);
+    unsigned first = random() % (optionCount - options + 1);
+    for (unsigned option = first; option < first + options; ++option)
+    {
+      line.push_back("--" + syntheticSubcommandOption(subcommand, option));
+      if ( option % 3 )
+      {
+        line.push_back(std::to_string(random() % 1000));
+      }
+    }
+    return line;
+  }
+
+  void printDistribution(unsigned subcommandCount, unsigned optionCount, const char* phase,
+                         const Distribution& distribution)
+  {
+    std::printf("%11u %8u %-17s %8zu %10.1f %10.1f %10.1f %10.1f %11.1f\n", subcommandCount, optionCount, phase,
+                distribution.microseconds_.size(), distribution.percentile(50), distribution.percentile(90),
+                distribution.percentile(99), distribution.microseconds_.back(),
+                static_cast<double>(distribution.allocations_) / distribution.microseconds_.size());
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Latency distributions and allocations of each step of handling a command line, for generated collections of 10
+   *  to 1000 subcommands with 10 to 500 options each
+   *
+   * The steps: finaliseRegistrations() building the option registry, SubcommandCLI::parseCommandLine() of a line
+   * selecting a random subcommand with a few of its options, the subcommand's own parse through ParseOutput::vm(),
+   * which is Subcommand::parseCommandLine(), and help rendered through OptionPrinter for a subcommand and for the
+   * application. Latencies are in microseconds, allocations are the mean per operation.
+   * args: [max-subcommands] [max-options] [samples], samples per step and size (default 200), fewer where they take
+   * longer than 2s between them.
+   */
+  int collectionBenchmark(const std::vector<std::string>& args)
+  {
+    unsigned maxSubcommands = args.empty() ? DEFAULT_MAX_SUBCOMMANDS : std::stoul(args[0]);
+    unsigned maxOptions = args.size() < 2 ? DEFAULT_MAX_SUBCOMMAND_OPTIONS : std::stoul(args[1]);
+    unsigned samples = args.size() < 3 ? DEFAULT_SAMPLES : std::stoul(args[2]);
+
+#ifdef OBERON_NATIVE_PARSER
+    std::printf("command lines parsed with oberon::ArgvParser\n");
+#else
+    std::printf("command lines parsed with boost::program_options\n");
+#endif
+    std::printf("%11s %8s %-17s %8s %10s %10s %10s %10s %11s\n", "subcommands", "options", "step", "samples",
+                "p50 us", "p90 us", "p99 us", "max us", "allocs/op");
+    for (unsigned subcommandCount : SUBCOMMAND_COUNTS)
+    {
+      for (unsigned optionCount : SUBCOMMAND_OPTION_COUNTS)
+      {
+        if ( subcommandCount > maxSubcommands || optionCount > maxOptions )
+        {
+          continue;
+        }
+
+        std::unique_ptr<oberon::SubcommandCollection> collection;
+        Distribution finalise = sample(samples,
+                                       [&]() { collection = syntheticCollection(subcommandCount, optionCount); },
+                                       [&]() { collection->finaliseRegistrations(); });
+        printDistribution(subcommandCount, optionCount, "finalise", finalise);
+
+        oberon::SubcommandCLI cli("oberon-bench", "generated subcommands", *collection);
+        collection.reset();
+
+        /** argv is kept for as long as the parses, ArgvParser's hold views of it */
+        std::mt19937 random(subcommandCount * optionCount);
+        std::vector<std::vector<std::string> > lines;
+        std::vector<std::vector<char*> > argvs;
+        for (unsigned line = 0; line < SYNTHETIC_LINES; ++line)
+        {
+          lines.push_back(syntheticSubcommandLine(subcommandCount, optionCount, random));
+        }
+        for (std::vector<std::string>& line : lines)
+        {
+          argvs.push_back(std::vector<char*>());
+          for (std::string& argument : line)
+          {
+            argvs.back().push_back(&argument[0]);
+          }
+          argvs.back().push_back(nullptr);
+        }
+
+        unsigned next = 0;
+        boost::optional<oberon::SubcommandCLI::ParseOutput> output;
+        size_t stored = 0;
+        auto parseNext = [&]()
+        {
+          std::vector<char*>& argv = argvs[next++ % argvs.size()];
+          output = cli.parseCommandLine(static_cast<int>(argv.size() - 1), argv.data());
+        };
+
+        Distribution parse = sample(samples, [&]() { output = boost::none; }, parseNext);
+        printDistribution(subcommandCount, optionCount, "parse", parse);
+
+        Distribution subcommandParse = sample(samples, parseNext, [&]() { stored += output->vm().size(); });
+        printDistribution(subcommandCount, optionCount, "subcommand parse", subcommandParse);
+        output = boost::none;
+
+        /** Each generated line stores an entry per option, a parse that went wrong would show here */
+        if ( stored != subcommandParse.microseconds_.size() * std::min(OPTIONS_PER_SUBCOMMAND_LINE, optionCount) )
+        {
+          std::cerr << "ERROR: subcommand parses stored " << stored << " values, not the options on their lines"
+                    << std::endl;
+          return FAILURE;
+        }
+
+        oberon::SubcommandCollection subcommands = cli.subcommands();
+        oberon::SubcommandCollection::SubcommandHandle subcommand;
+        size_t rendered = 0;
+        Distribution subcommandHelp = sample(samples,
+                                             [&]()
+                                             {
+                                               subcommand = subcommands.getSubcommand(
+                                                 syntheticSubcommandName(random() % subcommandCount));
+                                             },
+                                             [&]() { rendered += subcommand->usageDescription().size(); });
+        printDistribution(subcommandCount, optionCount, "subcommand help", subcommandHelp);
+
+        Distribution applicationHelp = sample(samples, []() {}, [&]() { rendered += cli.applicationUsage().size(); });
+        printDistribution(subcommandCount, optionCount, "application help", applicationHelp);
+      }
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  const std::map<std::string, Benchmark> BENCHMARKS =
+  {
+    { "parser", parserBenchmark },
+    { "startup", startupBenchmark },
+    { "collection", collectionBenchmark },
+  };
+
+  void usage(std::ostream& out)
+  {
+    out << "USAGE: oberon-bench <benchmark> [args...]" << std::endl
+        << "Available benchmarks:" << std::endl;
+    for (auto benchmark : BENCHMARKS)
+    {
+      out << "\t" << benchmark.first << std::endl;
+    }
+  }
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+  if ( argc < 2 || ! BENCHMARKS.count(argv[1]) )
+  {
+    usage(std::cerr);
+    return FAILURE;
+  }
+
+  try
+  {
+    return BENCHMARKS.at(argv[1])( std::vector<std::string>(argv + 2, argv + argc) );
+  }
+  catch(po::error& e)
+  {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return FAILURE;
+  }
+  catch(oberon::CommandLineParsingError& e)
+  {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return FAILURE;
+  }
+
+} // main
+
+//----------------------------------------------------------------------------------------------------------------------
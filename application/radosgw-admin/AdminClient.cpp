@@ -0,0 +1,749 @@
+#include "AdminClient.hpp"
+
+#include "boost/algorithm/string/predicate.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace
+{
+  /** A call is sent at most this many times before it is given up on */
+  const unsigned MAX_ATTEMPTS = 2;
+
+  const size_t RECEIVE_CHUNK = 64 * 1024;
+
+  const boost::string_view HEADER_END("\r\n\r\n");
+  const boost::string_view LINE_END("\r\n");
+
+  boost::string_view trim(boost::string_view text)
+  {
+    while ( ! text.empty() && (text.front() == ' ' || text.front() == '\t') )
+    {
+      text.remove_prefix(1);
+    }
+    while ( ! text.empty() && (text.back() == ' ' || text.back() == '\t') )
+    {
+      text.remove_suffix(1);
+    }
+    return text;
+  }
+
+  void skipSpace(boost::string_view& json)
+  {
+    while ( ! json.empty() && (json.front() == ' ' || json.front() == '\t' || json.front() == '\n'
+                               || json.front() == '\r') )
+    {
+      json.remove_prefix(1);
+    }
+  }
+
+  void appendUtf8(std::string& text, uint32_t codePoint)
+  {
+    if ( codePoint < 0x80 )
+    {
+      text.push_back(static_cast<char>(codePoint));
+    }
+    else if ( codePoint < 0x800 )
+    {
+      text.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+      text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else if ( codePoint < 0x10000 )
+    {
+      text.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+      text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else
+    {
+      text.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+      text.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+      text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+  }
+
+  /** Take a json string off the front of the text, which starts at its opening quote
+   *
+   * @returns false if it is malformed or unterminated.
+   */
+  bool takeString(boost::string_view& json, std::string& value)
+  {
+    value.clear();
+    if ( json.empty() || json.front() != '"' )
+    {
+      return false;
+    }
+    json.remove_prefix(1);
+
+    while ( ! json.empty() )
+    {
+      char character = json.front();
+      json.remove_prefix(1);
+      if ( character == '"' )
+      {
+        return true;
+      }
+      if ( character != '\\' )
+      {
+        value.push_back(character);
+        continue;
+      }
+      if ( json.empty() )
+      {
+        return false;
+      }
+
+      char escaped = json.front();
+      json.remove_prefix(1);
+      switch ( escaped )
+      {
+        case 'b': value.push_back('\b'); break;
+        case 'f': value.push_back('\f'); break;
+        case 'n': value.push_back('\n'); break;
+        case 'r': value.push_back('\r'); break;
+        case 't': value.push_back('\t'); break;
+        case 'u':
+        {
+          if ( json.size() < 4 )
+          {
+            return false;
+          }
+          char* end;
+          std::string digits(json.data(), 4);
+          uint32_t codePoint = std::strtoul(digits.c_str(), &end, 16);
+          if ( end != digits.c_str() + 4 )
+          {
+            return false;
+          }
+          json.remove_prefix(4);
+
+          /** A high surrogate followed by its low half is one code point, a lone half is kept as it is */
+          if ( codePoint >= 0xD800 && codePoint < 0xDC00 && json.size() >= 6 && json[0] == '\\' && json[1] == 'u' )
+          {
+            std::string low(json.data() + 2, 4);
+            uint32_t lowHalf = std::strtoul(low.c_str(), &end, 16);
+            if ( end == low.c_str() + 4 && lowHalf >= 0xDC00 && lowHalf < 0xE000 )
+            {
+              codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowHalf - 0xDC00);
+              json.remove_prefix(6);
+            }
+          }
+          appendUtf8(value, codePoint);
+          break;
+        }
+        default: value.push_back(escaped); break; // \" \\ and \/
+      }
+    }
+    return false;
+  }
+
+  /** Take any json value off the front of the text without interpreting it */
+  bool skipValue(boost::string_view& json)
+  {
+    std::string ignored;
+    if ( ! json.empty() && json.front() == '"' )
+    {
+      return takeString(json, ignored);
+    }
+
+    int depth = 0;
+    while ( ! json.empty() )
+    {
+      char character = json.front();
+      if ( character == '"' )
+      {
+        if ( ! takeString(json, ignored) )
+        {
+          return false;
+        }
+        continue;
+      }
+      if ( character == '{' || character == '[' )
+      {
+        ++depth;
+      }
+      else if ( character == '}' || character == ']' )
+      {
+        if ( depth == 0 )
+        {
+          return true; // the end of the enclosing object
+        }
+        --depth;
+      }
+      else if ( character == ',' && depth == 0 )
+      {
+        return true;
+      }
+      json.remove_prefix(1);
+    }
+    return depth == 0;
+  }
+
+  /** Length of a complete chunked body at the front of the text and the body itself, or npos if more is to come */
+  size_t dechunk(boost::string_view text, std::string& body)
+  {
+    body.clear();
+    size_t position = 0;
+    while ( true )
+    {
+      size_t lineEnd = text.find(LINE_END, position);
+      if ( lineEnd == boost::string_view::npos )
+      {
+        return boost::string_view::npos;
+      }
+      size_t chunkSize = std::strtoul(std::string(text.data() + position, lineEnd - position).c_str(), nullptr, 16);
+      position = lineEnd + LINE_END.size();
+      if ( chunkSize == 0 ) // the last chunk, then trailers up to an empty line
+      {
+        size_t trailerEnd = text.find(LINE_END, position);
+        while ( trailerEnd != boost::string_view::npos && trailerEnd != position )
+        {
+          position = trailerEnd + LINE_END.size();
+          trailerEnd = text.find(LINE_END, position);
+        }
+        return trailerEnd == boost::string_view::npos ? boost::string_view::npos : position + LINE_END.size();
+      }
+      if ( text.size() < position + chunkSize + LINE_END.size() )
+      {
+        return boost::string_view::npos;
+      }
+      body.append(text.data() + position, chunkSize);
+      position += chunkSize + LINE_END.size();
+    }
+  }
+
+} // namespace
+
+namespace basic {
+
+//----------------------------------------------------------------------------------------------------------------------
+  AdminClient::AdminClient(const std::string& endpoint, unsigned connections, unsigned window,
+                           std::chrono::milliseconds timeout, const std::string& token) :
+    authorization_(token.empty() ? std::string() : "\r\nAuthorization: Bearer " + token),
+    addressLength_(0),
+    window_(std::max(window, 1u)),
+    timeout_(timeout)
+  {
+    boost::string_view rest(endpoint);
+    if ( boost::algorithm::istarts_with(rest, "https://") )
+    {
+      throw AdminClientError("Endpoint " + endpoint + " uses https, only http is supported");
+    }
+    if ( boost::algorithm::istarts_with(rest, "http://") )
+    {
+      rest.remove_prefix(7);
+    }
+    rest = rest.substr(0, rest.find('/'));
+
+    std::string host, port = "80";
+    size_t portStart = rest.rfind(':');
+    if ( ! rest.empty() && rest.front() == '[' ) // [ipv6]:port
+    {
+      size_t close = rest.find(']');
+      if ( close == boost::string_view::npos )
+      {
+        throw AdminClientError("Malformed endpoint " + endpoint);
+      }
+      host = std::string(rest.data() + 1, close - 1);
+      portStart = close + 1 < rest.size() && rest[close + 1] == ':' ? close + 1 : boost::string_view::npos;
+    }
+    else
+    {
+      host = std::string(rest.substr(0, portStart));
+    }
+    if ( portStart != boost::string_view::npos )
+    {
+      port = std::string(rest.substr(portStart + 1));
+    }
+    if ( host.empty() || port.empty() )
+    {
+      throw AdminClientError("Malformed endpoint " + endpoint);
+    }
+    host_ = std::string(rest);
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* resolved = nullptr;
+    int error = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &resolved);
+    if ( error != 0 )
+    {
+      throw AdminClientError("Unable to resolve endpoint " + endpoint + ": " + ::gai_strerror(error));
+    }
+    std::memcpy(&address_, resolved->ai_addr, resolved->ai_addrlen);
+    addressLength_ = resolved->ai_addrlen;
+    ::freeaddrinfo(resolved);
+
+    pool_.resize(std::max(1u, std::min(connections, window_)));
+    for (Connection& connection : pool_)
+    {
+      connection.fd_ = -1;
+      connection.sent_ = 0;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  AdminClient::~AdminClient()
+  {
+    for (Connection& connection : pool_)
+    {
+      if ( connection.fd_ >= 0 )
+      {
+        ::close(connection.fd_);
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void AdminClient::run(const CallSource& source, const ReplySink& sink)
+  {
+    const size_t depth = (window_ + pool_.size() - 1) / pool_.size();
+    std::deque<Pending> retries;
+    bool exhausted = false;
+    unsigned inFlight = 0;
+    std::vector<pollfd> polled;
+    std::vector<Connection*> polledConnections;
+
+    while ( true )
+    {
+      /** Top every connection up to its share of the window, calls dropped with a connection go first */
+      for (Connection& connection : pool_)
+      {
+        while ( inFlight < window_ && connection.inFlight_.size() < depth )
+        {
+          Pending next;
+          next.attempts_ = 0;
+          if ( ! retries.empty() )
+          {
+            next = std::move(retries.front());
+            retries.pop_front();
+          }
+          else if ( exhausted || ! source(next.call_) )
+          {
+            exhausted = true;
+            break;
+          }
+
+          if ( connection.fd_ < 0 )
+          {
+            open(connection);
+          }
+          size_t start = connection.out_.size();
+          connection.out_.append(next.call_.method_).append(" ").append(next.call_.target_)
+                         .append(" HTTP/1.1\r\nHost: ").append(host_).append(authorization_)
+                         .append(next.call_.method_ == "PUT" ? "\r\nContent-Length: 0\r\n\r\n" : "\r\n\r\n");
+          next.length_ = connection.out_.size() - start;
+          next.deadline_ = Clock::now() + timeout_;
+          connection.inFlight_.push_back(std::move(next));
+          ++inFlight;
+        }
+      }
+      if ( inFlight == 0 )
+      {
+        return; // the source is exhausted, or the loop above would have found more
+      }
+
+      polled.clear();
+      polledConnections.clear();
+      for (Connection& connection : pool_)
+      {
+        if ( connection.fd_ >= 0 && ! connection.inFlight_.empty() )
+        {
+          if ( ! send(connection) )
+          {
+            inFlight -= connection.inFlight_.size();
+            drop(connection, retries, sink, "the connection to " + host_ + " was lost before a reply");
+            continue;
+          }
+          pollfd entry = { connection.fd_, static_cast<short>(POLLIN | (connection.out_.empty() ? 0 : POLLOUT)), 0 };
+          polled.push_back(entry);
+          polledConnections.push_back(&connection);
+        }
+      }
+      if ( polled.empty() )
+      {
+        continue; // everything in flight was dropped and is queued to be retried
+      }
+
+      /** Replies come in order, so the oldest call on each connection is the one that can run out of time first */
+      Clock::time_point now = Clock::now();
+      Clock::time_point firstDeadline = now + timeout_;
+      for (Connection* connection : polledConnections)
+      {
+        firstDeadline = std::min(firstDeadline, connection->inFlight_.front().deadline_);
+      }
+      int wait = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    std::max(firstDeadline - now, Clock::duration::zero())).count()) + 1;
+      if ( ::poll(polled.data(), polled.size(), wait) < 0 && errno != EINTR )
+      {
+        throw AdminClientError(std::string("Unable to wait for the endpoint: ") + std::strerror(errno));
+      }
+      for (size_t index = 0; index < polled.size(); ++index)
+      {
+        Connection& connection = *polledConnections[index];
+        bool open = true;
+        if ( polled[index].revents & (POLLIN | POLLHUP | POLLERR) )
+        {
+          char buffer[RECEIVE_CHUNK];
+          while ( true )
+          {
+            ssize_t received = ::recv(connection.fd_, buffer, sizeof(buffer), 0);
+            if ( received > 0 )
+            {
+              connection.in_.append(buffer, received);
+              continue;
+            }
+            if ( received < 0 && errno == EINTR )
+            {
+              continue;
+            }
+            open = received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+          }
+
+          unsigned completed = 0;
+          open = takeReplies(connection, sink, completed) && open;
+          inFlight -= completed;
+        }
+
+        if ( ! open )
+        {
+          inFlight -= connection.inFlight_.size();
+          drop(connection, retries, sink, "the connection to " + host_ + " was lost before a reply");
+        }
+        else if ( ! connection.inFlight_.empty() && Clock::now() >= connection.inFlight_.front().deadline_ )
+        {
+          inFlight -= connection.inFlight_.size();
+          drop(connection, retries, sink, host_ + " didn't answer within "
+                                          + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                             timeout_).count()) + " ms");
+        }
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  AdminReply AdminClient::call(const AdminCall& call)
+  {
+    bool taken = false;
+    AdminReply result = { 0, "", false };
+    run([&](AdminCall& next)
+    {
+      if ( taken )
+      {
+        return false;
+      }
+      next = call;
+      taken = true;
+      return true;
+    },
+    [&](const AdminCall&, const AdminReply& reply)
+    {
+      result = reply;
+    });
+    return result;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::string AdminClient::encode(boost::string_view value)
+  {
+    static const char HEX[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(value.size());
+    for (char character : value)
+    {
+      unsigned char byte = static_cast<unsigned char>(character);
+      if ( (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9')
+           || byte == '-' || byte == '_' || byte == '.' || byte == '~' )
+      {
+        encoded.push_back(character);
+      }
+      else
+      {
+        encoded.push_back('%');
+        encoded.push_back(HEX[byte >> 4]);
+        encoded.push_back(HEX[byte & 0xF]);
+      }
+    }
+    return encoded;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::string AdminClient::errorCode(const AdminReply& reply)
+  {
+    static const boost::string_view JSON_CODE("\"Code\":\"");
+    static const boost::string_view XML_CODE("<Code>");
+
+    boost::string_view body(reply.body_);
+    size_t start = body.find(JSON_CODE);
+    if ( start != boost::string_view::npos )
+    {
+      start += JSON_CODE.size();
+      return std::string(body.substr(start, body.find('"', start) - start));
+    }
+    start = body.find(XML_CODE);
+    if ( start != boost::string_view::npos )
+    {
+      start += XML_CODE.size();
+      return std::string(body.substr(start, body.find('<', start) - start));
+    }
+    return "";
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool AdminClient::parseUser(boost::string_view json, RemoteUser& user)
+  {
+    bool haveUuid = false;
+    skipSpace(json);
+    if ( json.empty() || json.front() != '{' )
+    {
+      return false;
+    }
+    json.remove_prefix(1);
+
+    std::string name;
+    while ( true )
+    {
+      skipSpace(json);
+      if ( ! json.empty() && json.front() == '}' )
+      {
+        return haveUuid;
+      }
+      if ( ! takeString(json, name) )
+      {
+        return false;
+      }
+      skipSpace(json);
+      if ( json.empty() || json.front() != ':' )
+      {
+        return false;
+      }
+      json.remove_prefix(1);
+      skipSpace(json);
+
+      std::string* field = name == "user_id" ? &user.uuid_ :
+                             name == "display_name" ? &user.displayName_ :
+                               name == "email" ? &user.email_ : nullptr;
+      if ( field && ! json.empty() && json.front() == '"' )
+      {
+        if ( ! takeString(json, *field) )
+        {
+          return false;
+        }
+        haveUuid = haveUuid || field == &user.uuid_;
+      }
+      else if ( ! skipValue(json) )
+      {
+        return false;
+      }
+
+      skipSpace(json);
+      if ( ! json.empty() && json.front() == ',' )
+      {
+        json.remove_prefix(1);
+      }
+      else if ( json.empty() || json.front() != '}' )
+      {
+        return false;
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void AdminClient::open(Connection& connection)
+  {
+    /** Connected without blocking, so an endpoint that never accepts costs the timeout rather than the kernel's */
+    int fd = ::socket(address_.ss_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    int error = fd < 0 ? errno : 0;
+    if ( fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr*>(&address_), addressLength_) != 0 )
+    {
+      error = errno;
+      if ( error == EINPROGRESS )
+      {
+        pollfd entry = { fd, POLLOUT, 0 };
+        int ready = ::poll(&entry, 1, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                         timeout_).count()));
+        socklen_t errorLength = sizeof(error);
+        error = ready < 0 ? errno : ready == 0 ? ETIMEDOUT :
+                  ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) != 0 ? errno : error;
+      }
+    }
+    if ( error )
+    {
+      if ( fd >= 0 )
+      {
+        ::close(fd);
+      }
+      throw AdminClientError("Unable to connect to " + host_ + ": " + std::strerror(error));
+    }
+
+    /** Requests are written whole, so Nagle would only hold back the tail of each pipelined batch */
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    connection.fd_ = fd;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void AdminClient::drop(Connection& connection, std::deque<Pending>& retries, const ReplySink& sink,
+                         const std::string& reason)
+  {
+    /** Calls still wholly in the unsent tail of the output never reached the endpoint */
+    size_t unsent = connection.out_.size() - connection.sent_;
+    size_t neverSent = 0;
+    for (std::deque<Pending>::reverse_iterator pending = connection.inFlight_.rbegin();
+         pending != connection.inFlight_.rend() && pending->length_ <= unsent; ++pending)
+    {
+      unsent -= pending->length_;
+      ++neverSent;
+    }
+
+    ::close(connection.fd_);
+    connection.fd_ = -1;
+    connection.out_.clear();
+    connection.sent_ = 0;
+    connection.in_.clear();
+
+    for (size_t index = 0; index < connection.inFlight_.size(); ++index)
+    {
+      Pending& pending = connection.inFlight_[index];
+      bool sent = index < connection.inFlight_.size() - neverSent;
+      bool repeatable = ! sent || pending.call_.method_ == "GET";
+      if ( repeatable && ++pending.attempts_ < MAX_ATTEMPTS )
+      {
+        retries.push_back(std::move(pending));
+      }
+      else
+      {
+        AdminReply reply = { 0, reason, sent && ! repeatable };
+        sink(pending.call_, reply);
+      }
+    }
+    connection.inFlight_.clear();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool AdminClient::send(Connection& connection)
+  {
+    while ( connection.sent_ < connection.out_.size() )
+    {
+      ssize_t sent = ::send(connection.fd_, connection.out_.data() + connection.sent_,
+                            connection.out_.size() - connection.sent_, MSG_NOSIGNAL);
+      if ( sent < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      connection.sent_ += sent;
+    }
+
+    connection.out_.clear();
+    connection.sent_ = 0;
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool AdminClient::takeReplies(Connection& connection, const ReplySink& sink, unsigned& completed)
+  {
+    boost::string_view input(connection.in_);
+    size_t consumed = 0;
+    bool keepOpen = true;
+    while ( keepOpen && ! connection.inFlight_.empty() )
+    {
+      boost::string_view rest = input.substr(consumed);
+      size_t headerEnd = rest.find(HEADER_END);
+      if ( headerEnd == boost::string_view::npos )
+      {
+        break;
+      }
+
+      /** Status line, HTTP/1.x SP code SP reason */
+      boost::string_view headers = rest.substr(0, headerEnd + LINE_END.size());
+      size_t lineEnd = headers.find(LINE_END);
+      boost::string_view statusLine = headers.substr(0, lineEnd);
+      headers.remove_prefix(lineEnd + LINE_END.size());
+      if ( ! boost::algorithm::starts_with(statusLine, "HTTP/1.") || statusLine.size() < 12 )
+      {
+        return false; // not a reply to anything sent, nothing more on the connection can be trusted
+      }
+
+      AdminReply reply;
+      reply.outcomeUnknown_ = false;
+      reply.status_ = std::atoi(std::string(statusLine.substr(9, 3)).c_str());
+      size_t contentLength = 0;
+      bool chunked = false;
+      while ( ! headers.empty() )
+      {
+        lineEnd = headers.find(LINE_END);
+        boost::string_view header = headers.substr(0, lineEnd);
+        headers.remove_prefix(lineEnd + LINE_END.size());
+
+        size_t colon = header.find(':');
+        if ( colon == boost::string_view::npos )
+        {
+          continue;
+        }
+        boost::string_view name = trim(header.substr(0, colon));
+        boost::string_view value = trim(header.substr(colon + 1));
+        if ( boost::algorithm::iequals(name, "content-length") )
+        {
+          contentLength = std::strtoull(std::string(value).c_str(), nullptr, 10);
+        }
+        else if ( boost::algorithm::iequals(name, "transfer-encoding") )
+        {
+          chunked = boost::algorithm::icontains(value, "chunked");
+        }
+        else if ( boost::algorithm::iequals(name, "connection") )
+        {
+          keepOpen = ! boost::algorithm::icontains(value, "close");
+        }
+      }
+
+      size_t bodyStart = headerEnd + HEADER_END.size();
+      size_t replySize;
+      if ( chunked )
+      {
+        size_t bodySize = dechunk(rest.substr(bodyStart), reply.body_);
+        if ( bodySize == boost::string_view::npos )
+        {
+          break;
+        }
+        replySize = bodyStart + bodySize;
+      }
+      else
+      {
+        if ( rest.size() < bodyStart + contentLength )
+        {
+          break;
+        }
+        reply.body_ = std::string(rest.substr(bodyStart, contentLength));
+        replySize = bodyStart + contentLength;
+      }
+
+      Pending answered = std::move(connection.inFlight_.front());
+      connection.inFlight_.pop_front();
+      consumed += replySize;
+      ++completed;
+      sink(answered.call_, reply);
+    }
+
+    connection.in_.erase(0, consumed);
+    return keepOpen;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
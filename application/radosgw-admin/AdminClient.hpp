@@ -0,0 +1,169 @@
+#ifndef ADMINCLIENT_HPP
+#define ADMINCLIENT_HPP
+
+#include "boost/utility/string_view.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+namespace basic
+{
+//**********************************************************************************************************************
+  /** Exception type raised when the endpoint can't be parsed or reached
+   */
+  class AdminClientError : public std::runtime_error
+  {
+  public: // interface
+    AdminClientError(const std::string& whatMessage) : std::runtime_error(whatMessage) {}
+
+    virtual ~AdminClientError() throw() {} // required by runtime_error inheritance
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** A request to the admin ops API, the label is the caller's, to tell replies apart
+   */
+  struct AdminCall
+  {
+    std::string method_;
+    std::string target_; // path and query string, already percent encoded
+    std::string label_;
+
+  }; // struct
+
+  /** The reply to a call, a status of zero means there was none and the body says why
+   */
+  struct AdminReply
+  {
+    int status_;
+    std::string body_;
+    bool outcomeUnknown_; // there was no reply to a call the endpoint received, it may have been applied or not
+
+  }; // struct
+
+  /** A user as the admin ops API describes one, the fields radosgw-admin keeps */
+  struct RemoteUser
+  {
+    std::string uuid_;
+    std::string displayName_;
+    std::string email_;
+
+  }; // struct
+
+//**********************************************************************************************************************
+  /** Client of an RGW admin ops compatible endpoint over a pool of persistent HTTP/1.1 connections
+   *
+   * Calls are pipelined: each connection carries up to window / connections calls at once and the window bounds the
+   * calls in flight over the whole pool, so a bulk run costs a round trip per window rather than per call and never
+   * queues more than the window on the server. Connections are opened as they are first needed and kept for every
+   * later run.
+   *
+   * Each call has the timeout to be answered from when it is written, and a connection whose oldest call runs out of
+   * time is dropped, as is one the endpoint closes. The unanswered calls of a dropped connection are sent again on a
+   * fresh one, once, if they are GETs or were never sent whole, since neither can have changed anything; a call that is
+   * dropped twice is answered with status zero. A PUT or DELETE the endpoint may already have applied isn't sent again,
+   * as repeating it would fail where the first succeeded; it is answered with status zero and its outcome unknown.
+   */
+  class AdminClient
+  {
+  public: // types
+    /** Fills in the next call, @returns false once there are no more */
+    typedef std::function<bool(AdminCall&)> CallSource;
+
+    /** Called with each call and its reply as it completes, calls on different connections complete in any order */
+    typedef std::function<void(const AdminCall&, const AdminReply&)> ReplySink;
+
+  public: // interface
+    /** @param endpoint: http://host[:port][/] or host:port.
+     *  @param timeout: for connecting and for each call to be answered.
+     *  @param token: sent with every call as "Authorization: Bearer <token>" unless empty, see serve --http.
+     *  @throws AdminClientError: if the endpoint can't be parsed or its host resolved.
+     */
+    AdminClient(const std::string& endpoint, unsigned connections, unsigned window, std::chrono::milliseconds timeout,
+                const std::string& token=std::string());
+    ~AdminClient();
+
+    AdminClient(const AdminClient&) = delete;
+    AdminClient& operator=(const AdminClient&) = delete;
+
+    /** Make every call the source gives and return once all of them are answered
+     *
+     * @throws AdminClientError: if the endpoint refuses connections or doesn't accept one within the timeout.
+     */
+    void run(const CallSource& source, const ReplySink& sink);
+
+    /** Make a single call */
+    AdminReply call(const AdminCall& call);
+
+    /** Percent encode a query string value */
+    static std::string encode(boost::string_view value);
+
+    /** The error code from an error reply's body, empty if it has none */
+    static std::string errorCode(const AdminReply& reply);
+
+    /** Read the user from the json the admin ops API describes one with, fields it doesn't know are skipped
+     *
+     * @returns false if the body isn't a json object with a user_id.
+     */
+    static bool parseUser(boost::string_view json, RemoteUser& user);
+
+  private: // types
+    typedef std::chrono::steady_clock Clock;
+
+    struct Pending
+    {
+      AdminCall call_;
+      unsigned attempts_;
+      size_t length_;             // of the request as written
+      Clock::time_point deadline_; // for its reply
+
+    }; // struct
+
+    struct Connection
+    {
+      int fd_;
+      std::string out_;
+      size_t sent_;
+      std::string in_;
+      std::deque<Pending> inFlight_;
+
+    }; // struct
+
+  private: // methods
+    void open(Connection& connection);
+
+    /** Close the connection, queueing the calls that are safe to send again and answering the rest
+     *
+     * @param reason: why the connection is dropped, the body of the replies it answers with.
+     */
+    void drop(Connection& connection, std::deque<Pending>& retries, const ReplySink& sink, const std::string& reason);
+
+    /** Send what the socket takes, @returns false if the connection failed */
+    bool send(Connection& connection);
+
+    /** Hand every complete response to the sink, @returns false if the server closed the connection after one */
+    bool takeReplies(Connection& connection, const ReplySink& sink, unsigned& completed);
+
+  private: // data
+    std::string host_;  // as sent in the Host header
+    std::string authorization_; // header line ending the Host header's, empty without a token
+    sockaddr_storage address_;
+    socklen_t addressLength_;
+    unsigned window_;
+    Clock::duration timeout_;
+    std::vector<Connection> pool_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // ADMINCLIENT_HPP
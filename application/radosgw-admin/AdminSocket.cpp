@@ -0,0 +1,317 @@
+#include "AdminSocket.hpp"
+
+#include <csignal>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+  const uint32_t MAX_FRAME_STRINGS = 64 * 1024;
+  const uint32_t MAX_FRAME_STRING_LENGTH = 64 * 1024 * 1024;
+  const int LISTEN_BACKLOG = 128;
+
+  volatile std::sig_atomic_t stopRequested = 0;
+
+  void requestStop(int)
+  {
+    stopRequested = 1;
+  }
+
+  sockaddr_un socketAddress(const std::string& path)
+  {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if ( path.size() >= sizeof(address.sun_path) )
+    {
+      throw basic::AdminSocketError("Admin socket path is too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+  }
+
+  /** @returns a connected socket or -1 if nothing is listening on the path */
+  int connectTo(const std::string& path)
+  {
+    sockaddr_un address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ( fd < 0 )
+    {
+      return -1;
+    }
+    if ( ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 )
+    {
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  /** @returns false if the peer closed the connection before anything was read */
+  bool readExact(int fd, void* buffer, size_t length)
+  {
+    char* cursor = static_cast<char*>(buffer);
+    size_t remaining = length;
+    while ( remaining > 0 )
+    {
+      ssize_t received = ::recv(fd, cursor, remaining, 0);
+      if ( received < 0 && errno == EINTR )
+      {
+        continue;
+      }
+      if ( received <= 0 )
+      {
+        if ( received == 0 && remaining == length )
+        {
+          return false;
+        }
+        throw basic::AdminSocketError("Admin connection closed mid frame");
+      }
+      cursor += received;
+      remaining -= received;
+    }
+    return true;
+  }
+
+  void writeAll(int fd, const std::string& data)
+  {
+    const char* cursor = data.data();
+    size_t remaining = data.size();
+    while ( remaining > 0 )
+    {
+      ssize_t sent = ::send(fd, cursor, remaining, MSG_NOSIGNAL);
+      if ( sent < 0 && errno == EINTR )
+      {
+        continue;
+      }
+      if ( sent < 0 )
+      {
+        throw basic::AdminSocketError(std::string("Unable to write to admin connection: ") + std::strerror(errno));
+      }
+      cursor += sent;
+      remaining -= sent;
+    }
+  }
+
+  template <typename T_Integer>
+  void appendInteger(std::string& frame, T_Integer value)
+  {
+    frame.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void appendString(std::string& frame, const std::string& value)
+  {
+    appendInteger<uint32_t>(frame, static_cast<uint32_t>(value.size()));
+    frame.append(value);
+  }
+
+  std::string readString(int fd)
+  {
+    uint32_t length;
+    if ( ! readExact(fd, &length, sizeof(length)) || length > MAX_FRAME_STRING_LENGTH )
+    {
+      throw basic::AdminSocketError("Malformed admin frame");
+    }
+
+    std::string value(length, '\0');
+    if ( length && ! readExact(fd, &value[0], length) )
+    {
+      throw basic::AdminSocketError("Malformed admin frame");
+    }
+    return value;
+  }
+
+  /** @returns none if the peer closed the connection cleanly between requests */
+  boost::optional<basic::AdminRequest> readRequest(int fd)
+  {
+    uint32_t count;
+    if ( ! readExact(fd, &count, sizeof(count)) )
+    {
+      return boost::none;
+    }
+    if ( count < 1 || count > MAX_FRAME_STRINGS )
+    {
+      throw basic::AdminSocketError("Malformed admin request");
+    }
+
+    basic::AdminRequest request;
+    request.defaultStore_ = readString(fd);
+    for (uint32_t argument = 1; argument < count; ++argument)
+    {
+      request.arguments_.push_back(readString(fd));
+    }
+    return request;
+  }
+
+} // namespace
+
+namespace basic {
+
+//----------------------------------------------------------------------------------------------------------------------
+  AdminServer::AdminServer(const std::string& socketPath) :
+    socketPath_(socketPath),
+    listener_(-1)
+  {
+    int existing = connectTo(socketPath_);
+    if ( existing >= 0 )
+    {
+      ::close(existing);
+      throw AdminSocketError("A daemon is already serving on " + socketPath_);
+    }
+
+    struct stat status;
+    if ( ::lstat(socketPath_.c_str(), &status) == 0 )
+    {
+      if ( ! S_ISSOCK(status.st_mode) )
+      {
+        throw AdminSocketError("Not replacing " + socketPath_ + " with an admin socket, it isn't a socket");
+      }
+      ::unlink(socketPath_.c_str()); // stale socket from a server that died
+    }
+
+    sockaddr_un address = socketAddress(socketPath_);
+    listener_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ( listener_ < 0
+         || ::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+         || ::listen(listener_, LISTEN_BACKLOG) != 0 )
+    {
+      std::string reason = std::strerror(errno);
+      if ( listener_ >= 0 )
+      {
+        ::close(listener_);
+      }
+      throw AdminSocketError("Unable to listen on admin socket (" + socketPath_ + "): " + reason);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  AdminServer::~AdminServer()
+  {
+    ::close(listener_);
+    ::unlink(socketPath_.c_str());
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void AdminServer::run(const Handler& handler)
+  {
+    /** No SA_RESTART, so a signal interrupts accept() and the loop sees the stop request */
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    stopRequested = 0;
+    while ( ! stopRequested )
+    {
+      serveNext(handler);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void AdminServer::serveNext(const Handler& handler)
+  {
+    int connection = ::accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+    if ( connection < 0 )
+    {
+      if ( errno == EINTR || errno == ECONNABORTED )
+      {
+        return;
+      }
+      throw AdminSocketError(std::string("Unable to accept admin connection: ") + std::strerror(errno));
+    }
+
+    try
+    {
+      serveConnection(connection, handler);
+    }
+    catch (AdminSocketError&)
+    {
+      // a misbehaving client only loses its own connection
+    }
+    ::close(connection);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void AdminServer::serveConnection(int connection, const Handler& handler)
+  {
+    while ( boost::optional<AdminRequest> request = readRequest(connection) )
+    {
+      AdminResponse response = handler(request.get());
+
+      std::string frame;
+      appendInteger<uint8_t>(frame, response.handled_ ? 1 : 0);
+      appendInteger<int32_t>(frame, response.status_);
+      appendString(frame, response.out_);
+      appendString(frame, response.err_);
+      writeAll(connection, frame);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<int> forwardToDaemon(const std::string& socketPath, const AdminRequest& request)
+  {
+    int connection;
+    try
+    {
+      connection = connectTo(socketPath);
+    }
+    catch (AdminSocketError&)
+    {
+      return boost::none; // a path that can't be a socket can't have a daemon behind it
+    }
+    if ( connection < 0 )
+    {
+      return boost::none;
+    }
+
+    AdminResponse response;
+    try
+    {
+      std::string frame;
+      appendInteger<uint32_t>(frame, static_cast<uint32_t>(request.arguments_.size() + 1));
+      appendString(frame, request.defaultStore_);
+      for (const std::string& argument : request.arguments_)
+      {
+        appendString(frame, argument);
+      }
+      writeAll(connection, frame);
+
+      uint8_t handled;
+      int32_t status;
+      if ( ! readExact(connection, &handled, sizeof(handled)) || ! readExact(connection, &status, sizeof(status)) )
+      {
+        throw AdminSocketError("Admin daemon closed the connection without responding");
+      }
+      response.handled_ = handled != 0;
+      response.status_ = status;
+      response.out_ = readString(connection);
+      response.err_ = readString(connection);
+    }
+    catch (...)
+    {
+      ::close(connection);
+      throw;
+    }
+    ::close(connection);
+
+    if ( ! response.handled_ )
+    {
+      return boost::none;
+    }
+
+    std::cout.write(response.out_.data(), response.out_.size()).flush();
+    std::cerr.write(response.err_.data(), response.err_.size()).flush();
+    return response.status_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,101 @@
+#ifndef ADMINSOCKET_HPP
+#define ADMINSOCKET_HPP
+
+#include "boost/optional.hpp"
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace basic
+{
+//**********************************************************************************************************************
+  /** Exception type raised when the admin socket can't be set up or a peer breaks the protocol
+   */
+  class AdminSocketError : public std::runtime_error
+  {
+  public: // interface
+    AdminSocketError(const std::string& whatMessage) : std::runtime_error(whatMessage) {}
+
+    virtual ~AdminSocketError() throw() {} // required by runtime_error inheritance
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** A command line forwarded from a client, along with the parts of the client's environment it depends on
+   */
+  struct AdminRequest
+  {
+    std::string defaultStore_;           // store the client uses when --store isn't given, absolute
+    std::vector<std::string> arguments_; // argv without the program name, paths in it made absolute
+
+  }; // struct
+
+  /** The result of running a forwarded command, handled_ is false if the daemon declined to run it
+   */
+  struct AdminResponse
+  {
+    bool handled_;
+    int status_;
+    std::string out_;
+    std::string err_;
+
+  }; // struct
+
+//**********************************************************************************************************************
+  /** Unix domain socket server that runs forwarded command lines one at a time
+   *
+   * Frames are length prefixed: a request is a count of strings followed by that many [uint32_t length][bytes]
+   * strings, a response is [uint8_t handled][int32_t status] followed by the out and err strings. A connection may
+   * carry any number of requests, the server handles connections one after another so commands never run concurrently.
+   */
+  class AdminServer
+  {
+  public: // types
+    typedef std::function<AdminResponse(const AdminRequest&)> Handler;
+
+  public: // interface
+    /** Bind and listen on the socket path, a stale socket left by a dead server is replaced
+     *
+     * @throws AdminSocketError: if the path is in use by a live server or the socket can't be created.
+     */
+    AdminServer(const std::string& socketPath);
+
+    /** Closes the socket and removes the socket file */
+    ~AdminServer();
+
+    AdminServer(const AdminServer&) = delete;
+    AdminServer& operator=(const AdminServer&) = delete;
+
+    /** Accept and serve connections until SIGINT or SIGTERM is received */
+    void run(const Handler& handler);
+
+    /** Accept one connection and serve it until the client closes it, for a caller running its own event loop */
+    void serveNext(const Handler& handler);
+
+    /** The listening socket, readable when a connection is waiting */
+    int descriptor() const { return listener_; }
+
+  private: // methods
+    void serveConnection(int connection, const Handler& handler);
+
+  private: // data
+    std::string socketPath_;
+    int listener_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Send the request to a daemon listening on the socket path and return its exit status
+   *
+   * The daemon's output is written to stdout and stderr. Returns none, having written nothing, if there is no daemon
+   * listening or it declined the command, so the caller can run the command itself.
+   */
+  boost::optional<int> forwardToDaemon(const std::string& socketPath, const AdminRequest& request);
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // ADMINSOCKET_HPP
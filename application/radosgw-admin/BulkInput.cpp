@@ -0,0 +1,219 @@
+#include "BulkInput.hpp"
+
+#include "userstore/Uuid.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace
+{
+  const char COLUMN_SEPARATOR = '\t';
+  const char COMMENT_MARKER = '#';
+
+  const size_t MAX_COLUMNS = 3;
+
+  /** Drop a trailing carriage return so files written on windows read the same */
+  boost::string_view stripCarriageReturn(boost::string_view line)
+  {
+    if ( ! line.empty() && line.back() == '\r' )
+    {
+      line.remove_suffix(1);
+    }
+    return line;
+  }
+
+} // namespace
+
+namespace basic {
+
+//----------------------------------------------------------------------------------------------------------------------
+  LineReader::LineReader(const std::string& path, size_t bufferSize) :
+    path_(path),
+    fd_(-1),
+    ownsDescriptor_(path != "-"),
+    endOfFile_(false),
+    buffer_(bufferSize),
+    begin_(0),
+    end_(0),
+    lineNumber_(0)
+  {
+    fd_ = ownsDescriptor_ ? ::open(path_.c_str(), O_RDONLY | O_CLOEXEC) : STDIN_FILENO;
+    if ( fd_ < 0 )
+    {
+      throw BulkInputError("Unable to open bulk input file (" + path_ + "): " + std::strerror(errno));
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  LineReader::~LineReader()
+  {
+    if ( ownsDescriptor_ )
+    {
+      ::close(fd_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool LineReader::next(boost::string_view& line)
+  {
+    for (;;)
+    {
+      const char* start = buffer_.data() + begin_;
+      const char* newline = static_cast<const char*>(std::memchr(start, '\n', end_ - begin_));
+      if ( newline )
+      {
+        line = stripCarriageReturn(boost::string_view(start, newline - start));
+        begin_ += newline - start + 1;
+        ++lineNumber_;
+        return true;
+      }
+
+      if ( ! fill() )
+      {
+        if ( begin_ == end_ )
+        {
+          return false;
+        }
+
+        line = stripCarriageReturn(boost::string_view(buffer_.data() + begin_, end_ - begin_)); // no final newline
+        begin_ = end_;
+        ++lineNumber_;
+        return true;
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool LineReader::nextLines(std::string& lines)
+  {
+    for (;;)
+    {
+      const char* start = buffer_.data() + begin_;
+      const char* lastNewline = static_cast<const char*>(::memrchr(start, '\n', end_ - begin_));
+      if ( lastNewline )
+      {
+        lines.assign(start, lastNewline - start + 1);
+        begin_ += lastNewline - start + 1;
+        return true;
+      }
+
+      if ( ! fill() )
+      {
+        if ( begin_ == end_ )
+        {
+          return false;
+        }
+
+        lines.assign(buffer_.data() + begin_, end_ - begin_); // no final newline
+        begin_ = end_;
+        return true;
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool LineReader::fill()
+  {
+    if ( endOfFile_ )
+    {
+      return false;
+    }
+
+    if ( begin_ > 0 )
+    {
+      std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+      end_ -= begin_;
+      begin_ = 0;
+    }
+    if ( end_ == buffer_.size() )
+    {
+      throw BulkInputError("Line " + std::to_string(lineNumber_ + 1) + " of " + path_ + " is longer than "
+                           + std::to_string(buffer_.size()) + " bytes");
+    }
+
+    waitReadable();
+    for (;;)
+    {
+      ssize_t bytesRead = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+      if ( bytesRead < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        throw BulkInputError("Unable to read bulk input file (" + path_ + "): " + std::strerror(errno));
+      }
+      if ( bytesRead == 0 )
+      {
+        endOfFile_ = true;
+        return false;
+      }
+
+      end_ += bytesRead;
+      return true;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void LineReader::waitReadable()
+  {
+    for (int timeout = idle_ ? idle_() : -1; timeout >= 0; timeout = idle_())
+    {
+      pollfd descriptor = { fd_, POLLIN, 0 };
+      int ready = ::poll(&descriptor, 1, timeout);
+      if ( ready > 0 )
+      {
+        return;
+      }
+      if ( ready < 0 && errno != EINTR )
+      {
+        throw BulkInputError("Unable to wait for bulk input (" + path_ + "): " + std::strerror(errno));
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool parseBulkUserLine(boost::string_view line, BulkUserLine& user)
+  {
+    if ( line.empty() || line.front() == COMMENT_MARKER )
+    {
+      return false;
+    }
+
+    boost::string_view columns[MAX_COLUMNS];
+    size_t column = 0;
+    for (;;)
+    {
+      size_t separator = line.find(COLUMN_SEPARATOR);
+      if ( column == MAX_COLUMNS )
+      {
+        throw BulkInputError("Too many columns, expected uuid, display name and email");
+      }
+      columns[column++] = line.substr(0, separator);
+      if ( separator == boost::string_view::npos )
+      {
+        break;
+      }
+      line.remove_prefix(separator + 1);
+    }
+
+    if ( columns[0].empty() )
+    {
+      throw BulkInputError("Missing uuid");
+    }
+    if ( userstore::isMalformedUuid(columns[0]) )
+    {
+      throw BulkInputError("Malformed uuid");
+    }
+
+    user = BulkUserLine{ columns[0], columns[1], columns[2] };
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,119 @@
+#ifndef BULKINPUT_HPP
+#define BULKINPUT_HPP
+
+#include "boost/utility/string_view.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace basic
+{
+//**********************************************************************************************************************
+  /** Exception type raised when a bulk input file can't be read or holds a line that can't be used
+   */
+  class BulkInputError : public std::runtime_error
+  {
+  public: // interface
+    BulkInputError(const std::string& whatMessage) : std::runtime_error(whatMessage) {}
+
+    virtual ~BulkInputError() throw() {} // required by runtime_error inheritance
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Reads a file (or stdin) a line at a time through a fixed size buffer, the file is never held in memory whole
+   *
+   * Lines are handed out as views into the buffer so no line is copied or allocated, a view is only valid until the
+   * next call to next(). A line longer than the buffer is an error rather than a reason to grow it.
+   */
+  class LineReader
+  {
+  public: // types
+    /** Called before each wait for more input, @returns how many milliseconds the wait may last before it is called
+     *  again, -1 for as long as the input takes */
+    typedef std::function<int()> Idle;
+
+  public: // interface
+    /** @param path: file to read, "-" reads stdin
+     *  @throws BulkInputError: if the file can't be opened.
+     */
+    LineReader(const std::string& path, size_t bufferSize=64 * 1024);
+    ~LineReader();
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    /** Fetch the next line without its terminator
+     *
+     * @returns false at the end of the input.
+     * @throws BulkInputError: if reading fails or a line doesn't fit in the buffer.
+     */
+    bool next(boost::string_view& line);
+
+    /** Fetch every complete line currently buffered, reading more first if there isn't one, terminators included
+     *
+     * For handing input to other threads in blocks without splitting it into lines here, so the block is copied out of
+     * the buffer and lineNumber() is not advanced. A final line without a terminator is returned as its own block.
+     *
+     * @returns false at the end of the input.
+     * @throws BulkInputError: if reading fails or a line doesn't fit in the buffer.
+     */
+    bool nextLines(std::string& lines);
+
+    /** Have work that falls due while waiting for input done on time, such as a commit, rather than when input comes */
+    void setIdle(const Idle& idle) { idle_ = idle; }
+
+    /** One based number of the line last returned by next() */
+    uint64_t lineNumber() const { return lineNumber_; }
+
+    const std::string& path() const { return path_; }
+
+  private: // methods
+    /** Move any partial line to the front of the buffer and read more after it, @returns false at end of file */
+    bool fill();
+
+    /** Wait for input in the spells idle_ allows, calling it between them */
+    void waitReadable();
+
+  private: // data
+    std::string path_;
+    int fd_;
+    bool ownsDescriptor_;
+    bool endOfFile_;
+    Idle idle_;
+
+    std::vector<char> buffer_;
+    size_t begin_; // start of the unconsumed data
+    size_t end_;   // end of the data read so far
+
+    uint64_t lineNumber_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** A line of a bulk user file: uuid, then optionally display name and email, separated by tabs
+   */
+  struct BulkUserLine
+  {
+    boost::string_view uuid_;
+    boost::string_view displayName_;
+    boost::string_view email_;
+
+  }; // struct
+
+  /** Split a line into its columns, blank lines and lines starting with '#' are skipped
+   *
+   * @returns false if the line should be skipped.
+   * @throws BulkInputError: if there are too many columns or the uuid is missing or malformed (see
+   *                         userstore::isMalformedUuid).
+   */
+  bool parseBulkUserLine(boost::string_view line, BulkUserLine& user);
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // BULKINPUT_HPP
@@ -0,0 +1,1330 @@
+#include "CommandRunner.hpp"
+
+#include "AdminClient.hpp"
+#include "AdminSocket.hpp"
+#include "BulkInput.hpp"
+#include "HttpServer.hpp"
+
+#include "oberon/Utils.hpp"
+
+#include "userstore/Utils.hpp"
+#include "userstore/Uuid.hpp"
+#include "userstore/WorkStealingPool.hpp"
+
+#include "boost/filesystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  namespace po = boost::program_options;
+
+  const char* const STORE_ENVIRONMENT_VARIABLE = "RADOSGW_ADMIN_STORE";
+  const std::string DEFAULT_STORE_DIRECTORY = "radosgw-admin.store";
+  const std::string SOCKET_FILE_NAME = "admin.sock";
+
+  /** Bulk runs commit in batches unless told otherwise, a crash loses at most one batch */
+  const uint32_t BULK_COMMIT_RECORDS = 4096;
+
+  /** Threaded bulk runs hand out input in blocks of whole lines read through a buffer this large */
+  const size_t PARALLEL_READ_BUFFER = 1024 * 1024;
+
+  /** Blocks staged ahead of the merge per thread, bounds memory while keeping every thread busy */
+  const size_t BLOCKS_IN_FLIGHT_PER_THREAD = 4;
+
+  const char BATCH_COMMENT_MARKER = '#';
+
+  /** Format of a command's output when it isn't given --format */
+  const std::string DEFAULT_FORMAT = "plain";
+
+  /** Pool size, calls in flight and seconds to wait for each for --endpoint runs without --connections, --window or
+   *  --timeout */
+  const unsigned DEFAULT_REMOTE_CONNECTIONS = 4;
+  const unsigned DEFAULT_REMOTE_WINDOW = 64;
+  const unsigned DEFAULT_REMOTE_TIMEOUT = 30;
+
+  /** The one resource of the RGW admin ops API served over HTTP */
+  const std::string ADMIN_USER_PATH = "/admin/user";
+
+  /** serve --http writes the token PUT and DELETE requests must carry here, in the store directory */
+  const std::string TOKEN_FILE_NAME = "admin.token";
+  const size_t TOKEN_BYTES = 16;
+
+  /** Make a random token and write it to a file only its owner can read, replacing any an earlier daemon left */
+  std::string writeAdminToken(const std::string& path)
+  {
+    unsigned char random[TOKEN_BYTES];
+    int source = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    bool generated = source >= 0 && ::read(source, random, sizeof(random)) == static_cast<ssize_t>(sizeof(random));
+    if ( source >= 0 )
+    {
+      ::close(source);
+    }
+    if ( ! generated )
+    {
+      throw basic::HttpServerError(std::string("Unable to generate the admin token: ") + std::strerror(errno));
+    }
+
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    std::string token;
+    for (unsigned char byte : random)
+    {
+      token.push_back(HEX_DIGITS[byte >> 4]);
+      token.push_back(HEX_DIGITS[byte & 0xF]);
+    }
+
+    /** Made afresh rather than truncated, so the file is the daemon's own with no permissions beyond the owner's */
+    ::unlink(path.c_str());
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    std::string contents = token + '\n';
+    bool written = fd >= 0 && ::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size());
+    int error = errno;
+    if ( fd >= 0 )
+    {
+      ::close(fd);
+    }
+    if ( ! written )
+    {
+      throw basic::HttpServerError("Unable to write the admin token (" + path + "): " + std::strerror(error));
+    }
+    return token;
+  }
+
+  /** Compare every byte whatever the first difference, so the time taken doesn't tell how much of a guess was right */
+  bool sameCredential(const std::string& given, const std::string& expected)
+  {
+    if ( given.size() != expected.size() )
+    {
+      return false;
+    }
+    unsigned char difference = 0;
+    for (size_t index = 0; index < given.size(); ++index)
+    {
+      difference |= given[index] ^ expected[index];
+    }
+    return difference == 0;
+  }
+
+  /** An admin ops API error, the body carries the RGW error code in the requested format */
+  basic::HttpResponse adminError(int status, const std::string& code, const std::string& format)
+  {
+    basic::HttpResponse response;
+    response.status_ = status;
+    if ( format == "xml" )
+    {
+      response.contentType_ = "application/xml";
+      response.body_ = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><Error><Code>" + code + "</Code></Error>\n";
+    }
+    else
+    {
+      response.contentType_ = "application/json";
+      response.body_ = "{\"Code\":\"" + code + "\"}\n";
+    }
+    return response;
+  }
+
+  /** Group commit bounds for the store's write ahead log, by default every mutation is committed on its own and bulk
+   *  input or batch runs commit in batches
+   */
+  userstore::WriteAheadLog::CommitWindow commitWindow(const po::variables_map& vm, bool batching)
+  {
+    userstore::WriteAheadLog::CommitWindow window;
+    if ( batching || vm.count("from-file") )
+    {
+      window.records_ = BULK_COMMIT_RECORDS;
+    }
+    if ( vm.count("commit-records") )
+    {
+      window.records_ = vm["commit-records"].as<uint32_t>();
+    }
+    if ( vm.count("commit-us") )
+    {
+      window.microseconds_ = vm["commit-us"].as<uint64_t>();
+    }
+    return window;
+  }
+
+  /** Commit what has waited out the store's --commit-us bound, as a LineReader::Idle for input read into the store
+   *
+   * @returns the milliseconds until what is left is due, rounded up so it is due by then, -1 if nothing is waiting.
+   */
+  int commitIfDue(userstore::UserStore& store)
+  {
+    boost::optional<userstore::WriteAheadLog::Clock::time_point> due = store.commitIfDue();
+    if ( ! due )
+    {
+      return -1;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(*due - userstore::WriteAheadLog::Clock::now());
+    return static_cast<int>(std::min<int64_t>(wait.count() + 1, INT_MAX));
+  }
+
+  /** Explain why a user wasn't created */
+  void reportRejected(std::ostream& err, boost::string_view uuid, userstore::UserStore::InsertResult result)
+  {
+    if ( result == userstore::UserStore::InsertResult::EmailExists )
+    {
+      err << "User with uuid " << uuid << " not created, its email is already used by another user" << '\n';
+    }
+    else
+    {
+      err << "User with uuid " << uuid << " already exists" << '\n';
+    }
+  }
+
+  /** The admin ops API target for a user, with the details a create sends */
+  std::string userTarget(boost::string_view uuid,
+                         boost::string_view displayName=boost::string_view(),
+                         boost::string_view email=boost::string_view())
+  {
+    std::string target = ADMIN_USER_PATH + "?uid=" + basic::AdminClient::encode(uuid);
+    if ( ! displayName.empty() )
+    {
+      target.append("&display-name=").append(basic::AdminClient::encode(displayName));
+    }
+    if ( ! email.empty() )
+    {
+      target.append("&email=").append(basic::AdminClient::encode(email));
+    }
+    return target;
+  }
+
+  /** Explain why a call to an endpoint failed, as the same failure is explained locally where there is one */
+  void reportRemoteFailure(std::ostream& err, const basic::AdminCall& call, const basic::AdminReply& reply)
+  {
+    std::string code = basic::AdminClient::errorCode(reply);
+    if ( reply.status_ == 0 && reply.outcomeUnknown_ )
+    {
+      err << "ERROR: " << call.method_ << " of user " << call.label_ << " has an unknown outcome, it was sent but "
+          << reply.body_ << '\n';
+    }
+    else if ( reply.status_ == 0 )
+    {
+      err << "ERROR: " << call.method_ << " of user " << call.label_ << " failed, " << reply.body_ << '\n';
+    }
+    else if ( code == "NoSuchUser" )
+    {
+      err << "User with uuid " << call.label_ << " does not exist" << '\n';
+    }
+    else if ( code == "UserAlreadyExists" || code == "EmailExists" )
+    {
+      reportRejected(err, call.label_, code == "EmailExists" ? userstore::UserStore::InsertResult::EmailExists :
+                                                                 userstore::UserStore::InsertResult::UuidExists);
+    }
+    else
+    {
+      err << "ERROR: " << call.method_ << " of user " << call.label_ << " answered " << reply.status_
+          << (code.empty() ? "" : " ") << code << '\n';
+    }
+  }
+
+  /** Create every user listed in the file, users that already exist or lines that can't be parsed are reported and
+   *  skipped rather than stopping the run
+   *
+   * @returns false if any line failed.
+   */
+  bool bulkCreate(userstore::UserStore& store, const std::string& path, std::ostream& out, std::ostream& err)
+  {
+    basic::LineReader reader(path);
+    reader.setIdle([&store]() { return commitIfDue(store); });
+    uint64_t created = 0, failed = 0;
+
+    boost::string_view line;
+    while ( reader.next(line) )
+    {
+      basic::BulkUserLine user;
+      try
+      {
+        if ( ! basic::parseBulkUserLine(line, user) )
+        {
+          continue;
+        }
+      }
+      catch(basic::BulkInputError& e)
+      {
+        err << path << ":" << reader.lineNumber() << ": " << e.what() << '\n';
+        ++failed;
+        continue;
+      }
+
+      userstore::UserStore::InsertResult result = store.insert(user.uuid_, user.displayName_, user.email_);
+      if ( result == userstore::UserStore::InsertResult::Inserted )
+      {
+        ++created;
+      }
+      else
+      {
+        reportRejected(err, user.uuid_, result);
+        ++failed;
+      }
+    }
+
+    out << "Created " << created << " users, " << failed << " failed" << '\n';
+    return failed == 0;
+  }
+
+  /** A block of input lines and the users staged from it, staged on a pool thread and merged on the calling thread
+   */
+  struct StagedBlock
+  {
+    std::string lines_;
+    userstore::StagedUsers users_;
+    std::vector<uint64_t> userLines_;                      // line within the block each staged user came from
+    std::vector<std::pair<uint64_t, std::string>> errors_; // line within the block and what was wrong with it
+    uint64_t lineCount_;
+    std::exception_ptr failure_; // an error that stops the whole run, as it would without threads
+    std::atomic<bool> staged_; // set once the pool is done with the block, read by the merge without the lock
+
+    /** Parse every line of the block, nothing here touches the store */
+    void stage()
+    {
+      users_.clear();
+      userLines_.clear();
+      errors_.clear();
+      lineCount_ = 0;
+      try
+      {
+        boost::string_view remaining(lines_);
+        while ( ! remaining.empty() )
+        {
+          size_t newline = remaining.find('\n');
+          boost::string_view line = remaining.substr(0, newline);
+          remaining.remove_prefix(newline == boost::string_view::npos ? remaining.size() : newline + 1);
+          if ( ! line.empty() && line.back() == '\r' )
+          {
+            line.remove_suffix(1);
+          }
+          ++lineCount_;
+
+          basic::BulkUserLine user;
+          try
+          {
+            if ( basic::parseBulkUserLine(line, user) )
+            {
+              users_.add(user.uuid_, user.displayName_, user.email_);
+              userLines_.push_back(lineCount_);
+            }
+          }
+          catch(basic::BulkInputError& e)
+          {
+            errors_.emplace_back(lineCount_, e.what());
+          }
+        }
+      }
+      catch(...)
+      {
+        failure_ = std::current_exception();
+      }
+    }
+
+  }; // struct
+
+  /** bulkCreate with parsing, validation, hashing and encoding spread over a pool of threads
+   *
+   * The store has a single writer, so blocks are staged in parallel and merged into it on this thread in input order.
+   * That keeps the result, including which of two duplicate lines wins, the same as a single threaded run. Merging
+   * happens whenever the oldest block is ready, so staging runs ahead of the merge by a bounded number of blocks.
+   */
+  bool parallelBulkCreate(userstore::UserStore& store,
+                          const std::string& path,
+                          unsigned threads,
+                          std::ostream& out,
+                          std::ostream& err)
+  {
+    basic::LineReader reader(path, PARALLEL_READ_BUFFER);
+    reader.setIdle([&store]() { return commitIfDue(store); });
+    uint64_t created = 0, failed = 0, linesMerged = 0;
+
+    std::mutex mutex;
+    std::condition_variable blockStaged;
+    std::deque<std::unique_ptr<StagedBlock>> inFlight, spare;
+
+    auto mergeOldest = [&]()
+    {
+      std::unique_ptr<StagedBlock> block = std::move(inFlight.front());
+      inFlight.pop_front();
+      if ( block->failure_ )
+      {
+        std::rethrow_exception(block->failure_);
+      }
+
+      /** Parse errors are reported as the merge passes their lines, so errors come out in the same order as without
+       *  threads */
+      size_t nextError = 0;
+      auto reportErrorsBefore = [&](uint64_t line)
+      {
+        for (; nextError < block->errors_.size() && block->errors_[nextError].first < line; ++nextError)
+        {
+          err << path << ":" << linesMerged + block->errors_[nextError].first << ": "
+              << block->errors_[nextError].second << '\n';
+          ++failed;
+        }
+      };
+
+      created += store.insert(block->users_, [&](size_t position, userstore::UserStore::InsertResult result)
+      {
+        reportErrorsBefore(block->userLines_[position]);
+        reportRejected(err, block->users_.uuid(position), result);
+        ++failed;
+      });
+      reportErrorsBefore(UINT64_MAX);
+      linesMerged += block->lineCount_;
+      spare.push_back(std::move(block));
+    };
+
+    auto waitForOldest = [&]()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      blockStaged.wait(lock, [&]() { return inFlight.front()->staged_.load(); });
+    };
+
+    /** Declared after the blocks so it is destroyed first, even on an error its threads are done before the blocks go */
+    userstore::WorkStealingPool pool(threads);
+    for (;;)
+    {
+      std::unique_ptr<StagedBlock> block;
+      if ( spare.empty() )
+      {
+        block.reset( new StagedBlock() );
+      }
+      else
+      {
+        block = std::move(spare.front());
+        spare.pop_front();
+      }
+      if ( ! reader.nextLines(block->lines_) )
+      {
+        break;
+      }
+
+      block->staged_ = false;
+      block->failure_ = nullptr;
+      StagedBlock* staging = block.get();
+      inFlight.push_back(std::move(block));
+      pool.submit([staging, &mutex, &blockStaged]()
+      {
+        staging->stage();
+        std::lock_guard<std::mutex> lock(mutex);
+        staging->staged_ = true;
+        blockStaged.notify_all();
+      });
+
+      if ( inFlight.size() >= threads * BLOCKS_IN_FLIGHT_PER_THREAD )
+      {
+        waitForOldest();
+      }
+      while ( ! inFlight.empty() && inFlight.front()->staged_ )
+      {
+        mergeOldest();
+      }
+    }
+
+    while ( ! inFlight.empty() )
+    {
+      waitForOldest();
+      mergeOldest();
+    }
+
+    out << "Created " << created << " users, " << failed << " failed" << '\n';
+    return failed == 0;
+  }
+
+  /** Delete every user listed in the file, only the uuid column is used
+   *
+   * @returns false if any line failed.
+   */
+  bool bulkDelete(userstore::UserStore& store, const std::string& path, std::ostream& out, std::ostream& err)
+  {
+    basic::LineReader reader(path);
+    reader.setIdle([&store]() { return commitIfDue(store); });
+    uint64_t deleted = 0, failed = 0;
+
+    boost::string_view line;
+    while ( reader.next(line) )
+    {
+      basic::BulkUserLine user;
+      try
+      {
+        if ( ! basic::parseBulkUserLine(line, user) )
+        {
+          continue;
+        }
+      }
+      catch(basic::BulkInputError& e)
+      {
+        err << path << ":" << reader.lineNumber() << ": " << e.what() << '\n';
+        ++failed;
+        continue;
+      }
+
+      if ( store.remove(user.uuid_) )
+      {
+        ++deleted;
+      }
+      else
+      {
+        err << "User with uuid " << user.uuid_ << " does not exist" << '\n';
+        ++failed;
+      }
+    }
+
+    out << "Deleted " << deleted << " users, " << failed << " failed" << '\n';
+    return failed == 0;
+  }
+
+} // namespace
+
+namespace basic {
+
+  const int CommandRunner::SUCCESS;
+  const int CommandRunner::FAILURE;
+  const int CommandRunner::NOT_SERVED;
+
+//----------------------------------------------------------------------------------------------------------------------
+  CommandRunner::CommandRunner(oberon::SubcommandCLI& application) :
+    application_(application),
+    attachedStore_(nullptr),
+    defaultStore_(environmentStore()),
+    defaultFormat_(DEFAULT_FORMAT),
+    batching_(false),
+    batchStoreWritable_(false)
+  {
+
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::run(int argc, char** argv, std::ostream& out, std::ostream& err)
+  {
+    try
+    {
+      oberon::SubcommandCLI::ParseOutput parseOutput = application_.parseCommandLine(argc, argv);
+      const po::variables_map& parsedVars = parseOutput.vm();
+
+      if ( boost::optional<std::string> subcommandNameOptional = parseOutput.subcommandUsed() )
+      {
+        return dispatch(subcommandNameOptional.get(), parsedVars, out, err);
+      }
+
+      if ( parsedVars.count("batch") )
+      {
+        if ( batching_ || attachedStore_ )
+        {
+          err << "ERROR: --batch can't be used from within a batch or through a daemon" << '\n';
+          return FAILURE;
+        }
+        return runBatch(parsedVars, out, err);
+      }
+      else if ( parsedVars.count("version") ) // act on the version option
+      {
+        out << "Application Version: 0.1.0 - demo" << '\n';
+      }
+      else
+      {
+        application_.displayHelp(boost::none, out);
+      }
+    }
+    catch(oberon::CommandLineParsingError& e)
+    {
+      application_.displayParsingError(e, out, err);
+      return FAILURE;
+
+    }
+    catch(userstore::StoreError& e)
+    {
+      err << "ERROR: " << e.what() << std::endl;
+      return FAILURE;
+
+    }
+    catch(BulkInputError& e)
+    {
+      err << "ERROR: " << e.what() << std::endl;
+      return FAILURE;
+
+    }
+    catch(AdminSocketError& e)
+    {
+      err << "ERROR: " << e.what() << std::endl;
+      return FAILURE;
+
+    }
+    catch(AdminClientError& e)
+    {
+      err << "ERROR: " << e.what() << std::endl;
+      return FAILURE;
+
+    }
+    catch(HttpServerError& e)
+    {
+      err << "ERROR: " << e.what() << std::endl;
+      return FAILURE;
+
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::run(const std::vector<std::string>& arguments, std::ostream& out, std::ostream& err)
+  {
+    /** The parser wants a mutable argv, it doesn't modify it but the strings are copied to be safe */
+    std::vector<std::string> storage;
+    storage.reserve(arguments.size() + 1);
+    storage.push_back("radosgw-admin");
+    storage.insert(storage.end(), arguments.begin(), arguments.end());
+
+    std::vector<char*> argv;
+    for (std::string& argument : storage)
+    {
+      argv.push_back(&argument[0]);
+    }
+    argv.push_back(nullptr);
+
+    return run(static_cast<int>(storage.size()), argv.data(), out, err);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::runBatch(const po::variables_map& options, std::ostream& out, std::ostream& err)
+  {
+    /** The top level parse takes every subcommand's options, only those that make sense for every line are kept */
+    for (const auto& option : options)
+    {
+      if ( option.first != "batch" && option.first != "store" && option.first != "format" )
+      {
+        throw oberon::CommandLineParsingError("--" + option.first + " can't be given with --batch, only --store and "
+                                              "--format, which are the defaults for its lines.");
+      }
+    }
+    if ( options.count("format") && ! Formatter::isFormat(options["format"].as<std::string>()) )
+    {
+      throw oberon::CommandLineParsingError("Unknown format '" + options["format"].as<std::string>() + "', use plain, "
+                                            "json or xml.");
+    }
+
+    /** The batch's store is kept open between lines, so what it has waiting is committed while the next is awaited */
+    LineReader reader("-");
+    reader.setIdle([this]() { return batchStore_ ? commitIfDue(*batchStore_) : -1; });
+    int status = SUCCESS;
+
+    std::string previousStore = defaultStore_;
+    defaultStore_ = storeDirectory(options);
+    defaultFormat_ = options.count("format") ? options["format"].as<std::string>() : DEFAULT_FORMAT;
+    batching_ = true;
+    try
+    {
+      boost::string_view line;
+      while ( reader.next(line) )
+      {
+        std::vector<std::string> arguments = po::split_unix(std::string(line.data(), line.size()));
+        if ( arguments.empty() || arguments.front()[0] == BATCH_COMMENT_MARKER )
+        {
+          continue;
+        }
+
+        if ( run(arguments, out, err) != SUCCESS )
+        {
+          status = FAILURE;
+        }
+      }
+    }
+    catch(...)
+    {
+      batching_ = false;
+      batchStore_.reset();
+      defaultStore_ = previousStore;
+      defaultFormat_ = DEFAULT_FORMAT;
+      throw;
+    }
+    batching_ = false;
+    batchStore_.reset(); // commits whatever the last window left pending
+    defaultStore_ = previousStore;
+    defaultFormat_ = DEFAULT_FORMAT;
+
+    return status;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::string CommandRunner::storeDirectory(const po::variables_map& vm) const
+  {
+    return vm.count("store") ? vm["store"].as<std::string>() : defaultStore_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::string CommandRunner::environmentStore()
+  {
+    const char* fromEnvironment = std::getenv(STORE_ENVIRONMENT_VARIABLE);
+    return fromEnvironment && *fromEnvironment ? std::string(fromEnvironment) : DEFAULT_STORE_DIRECTORY;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::string CommandRunner::defaultSocketPath(const std::string& storeDirectory)
+  {
+    return (boost::filesystem::path(storeDirectory) / SOCKET_FILE_NAME).string();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::dispatch(const std::string& subcommandName,
+                              const po::variables_map& vm,
+                              std::ostream& out,
+                              std::ostream& err)
+  {
+    if ( subcommandName == "help" )
+    {
+      application_.displayHelp(vm.count("topic") ?
+                                 vm["topic"].as< std::vector<std::string> >() :
+                                    std::vector<std::string>(),
+                               out);
+      return SUCCESS;
+    }
+    if ( subcommandName == "serve" )
+    {
+      return serve(vm, out, err);
+    }
+
+    if ( vm.count("endpoint") ) // create, delete or info on a gateway, no store is involved
+    {
+      return remote(subcommandName, vm, out, err);
+    }
+
+    if ( ! servesStore(vm)
+         || (attachedStore_ && vm.count("from-file")
+             && ! boost::filesystem::path(vm["from-file"].as<std::string>()).is_absolute()) )
+    {
+      return NOT_SERVED; // another store, or input only the client can read or find (stdin, a relative path)
+    }
+    if ( batching_ && vm.count("from-file") && vm["from-file"].as<std::string>() == "-" )
+    {
+      err << "ERROR: --from-file - can't be used in a batch, stdin holds the batch itself" << '\n';
+      return FAILURE;
+    }
+
+    if ( subcommandName == "create" ) // processing for the user create subcommand
+    {
+      return create(vm, out, err);
+    }
+    else if ( subcommandName == "delete" ) // processing for the user delete subcommand
+    {
+      return remove(vm, out, err);
+    }
+    else if ( subcommandName == "info" ) // processing for the user info subcommand
+    {
+      return info(vm, out, err);
+    }
+    else if ( subcommandName == "list" ) // processing for the user list subcommand
+    {
+      return list(vm, out, err);
+    }
+    else if ( subcommandName == "stats" ) // processing for the user stats subcommand
+    {
+      return stats(vm, out, err);
+    }
+    else if ( subcommandName == "store" ) // processing for the store maintenance subcommand
+    {
+      return store(vm, out, err);
+    }
+
+    assert(false && "Unrecognised subcommand used and it somehow got through parsing");
+    return FAILURE;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::create(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    std::unique_ptr<userstore::UserStore> ownedStore;
+    userstore::UserStore& store = storeFor(vm, userstore::UserStore::OpenMode::ReadWrite, ownedStore);
+    store.setCommitWindow(commitWindow(vm, batching_));
+
+    int status = SUCCESS;
+    if ( vm.count("from-file") )
+    {
+      unsigned threads = vm.count("threads") ? vm["threads"].as<unsigned>() : 1;
+      bool created = threads > 1 ?
+                       parallelBulkCreate(store, vm["from-file"].as<std::string>(), threads, out, err) :
+                          bulkCreate(store, vm["from-file"].as<std::string>(), out, err);
+      status = created ? SUCCESS : FAILURE;
+    }
+    else
+    {
+      std::string u_str = vm["uuid-String"].as<std::string>();
+      std::string displayName = vm.count("display-name") ? vm["display-name"].as<std::string>() : "";
+      std::string email = vm.count("email") ? vm["email"].as<std::string>() : "";
+      userstore::UserStore::InsertResult result = store.insert(u_str, displayName, email);
+      if ( result == userstore::UserStore::InsertResult::Inserted )
+      {
+        out << "User with uuid " << u_str << " created" << '\n';
+      }
+      else
+      {
+        reportRejected(err, u_str, result);
+        status = FAILURE;
+      }
+    }
+
+    commitCommand(store); // an owned store commits on close anyway, an attached one must before the command reports back
+    return status;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::remove(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    std::unique_ptr<userstore::UserStore> ownedStore;
+    userstore::UserStore& store = storeFor(vm, userstore::UserStore::OpenMode::ReadWrite, ownedStore);
+    store.setCommitWindow(commitWindow(vm, batching_));
+
+    int status = SUCCESS;
+    if ( vm.count("from-file") )
+    {
+      status = bulkDelete(store, vm["from-file"].as<std::string>(), out, err) ? SUCCESS : FAILURE;
+    }
+    else
+    {
+      std::string u_str = vm["uuid-String"].as<std::string>();
+      if ( store.remove(u_str) )
+      {
+        out << "User with uuid " << u_str << " deleted" << '\n';
+      }
+      else
+      {
+        err << "User with uuid " << u_str << " does not exist" << '\n';
+        status = FAILURE;
+      }
+    }
+
+    commitCommand(store);
+    return status;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::info(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    std::unique_ptr<userstore::UserStore> ownedStore;
+    const userstore::UserStore& store = storeFor(vm, userstore::UserStore::OpenMode::ReadOnly, ownedStore);
+
+    std::unique_ptr<Formatter> formatter = formatterFor(vm, out);
+    if ( vm.count("uuid-String") ) // single user, an index probe rather than a scan
+    {
+      std::string u_str = vm["uuid-String"].as<std::string>();
+      boost::optional<userstore::UserRecord> user = store.get(u_str);
+      if ( ! user )
+      {
+        err << "User with uuid " << u_str << " does not exist" << '\n';
+        return FAILURE;
+      }
+
+      formatter->user(*user);
+    }
+    else if ( vm.count("email") ) // emails are unique, so this is a single index probe too
+    {
+      std::string email = vm["email"].as<std::string>();
+      boost::optional<userstore::UserRecord> user = store.getByEmail(email);
+      if ( ! user )
+      {
+        err << "User with email " << email << " does not exist" << '\n';
+        return FAILURE;
+      }
+
+      formatter->user(*user);
+    }
+    else if ( vm.count("display-name") ) // any number of users can share a display name
+    {
+      std::string displayName = vm["display-name"].as<std::string>();
+      bool found = false;
+      formatter->openUsers();
+      store.forEachWithDisplayName(displayName, [&](const userstore::UserRecord& user)
+      {
+        formatter->listedUser(user);
+        found = true;
+      });
+      formatter->closeUsers(); // an empty collection still leaves json and xml output well formed
+      formatter->flush();
+      if ( ! found )
+      {
+        err << "No user with display name " << displayName << " exists" << '\n';
+        return FAILURE;
+      }
+    }
+    else
+    {
+      formatter->openUsers();
+      store.forEach([&formatter](const userstore::UserRecord& user) { formatter->listedUser(user); });
+      formatter->closeUsers();
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::list(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    std::unique_ptr<userstore::UserStore> ownedStore;
+    const userstore::UserStore& store = storeFor(vm, userstore::UserStore::OpenMode::ReadOnly, ownedStore);
+
+    std::string marker = vm.count("marker") ? vm["marker"].as<std::string>() : "";
+    uint64_t maxEntries = vm.count("max-entries") ? vm["max-entries"].as<uint64_t>() : UINT64_MAX;
+
+    std::unique_ptr<Formatter> formatter = formatterFor(vm, out);
+    formatter->openKeys();
+
+    std::string last = marker;
+    bool truncated = store.forEach(marker, maxEntries, [&](const userstore::UserRecord& user)
+    {
+      formatter->key(user.uuid_);
+      last.assign(user.uuid_.data(), user.uuid_.size());
+    });
+
+    formatter->closeKeys(truncated, last);
+    formatter->flush();
+    if ( truncated ) // like radosgw-admin, the marker for the next page is the last user listed
+    {
+      err << "More users follow, continue with --marker " << last << '\n';
+    }
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::stats(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    bool recording = vm.count("add-objects") || vm.count("add-bytes");
+    std::unique_ptr<userstore::UserStore> ownedStore;
+    userstore::UserStore& store = storeFor(vm,
+                                           recording || vm.count("sync") ? userstore::UserStore::OpenMode::ReadWrite :
+                                                                           userstore::UserStore::OpenMode::ReadOnly,
+                                           ownedStore);
+
+    std::string u_str = vm.count("uuid-String") ? vm["uuid-String"].as<std::string>() : "";
+    if ( recording )
+    {
+      userstore::UserUsage delta;
+      delta.objects_ = vm.count("add-objects") ? vm["add-objects"].as<int64_t>() : 0;
+      delta.bytes_ = vm.count("add-bytes") ? vm["add-bytes"].as<int64_t>() : 0;
+      delta.ops_ = 1;
+      if ( ! store.addUsage(u_str, delta) )
+      {
+        err << "User with uuid " << u_str << " does not exist" << '\n';
+        return FAILURE;
+      }
+    }
+    if ( vm.count("sync") ) // like radosgw-admin user stats --sync-stats, bring the stored counters up to date first
+    {
+      store.sync();
+    }
+    if ( recording && ! vm.count("sync") )
+    {
+      return SUCCESS;
+    }
+
+    std::unique_ptr<Formatter> formatter = formatterFor(vm, out);
+    if ( u_str.empty() )
+    {
+      formatter->usage(u_str, store.totalUsage());
+      return SUCCESS;
+    }
+
+    boost::optional<userstore::UserUsage> usage = store.usage(u_str);
+    if ( ! usage )
+    {
+      err << "User with uuid " << u_str << " does not exist" << '\n';
+      return FAILURE;
+    }
+    formatter->usage(u_str, *usage);
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::store(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    batchStore_.reset(); // the batch's own hold on the store would keep these waiting on themselves
+    std::string action = vm["action"].as<std::string>();
+    try
+    {
+      if ( action == "init" )
+      {
+        unsigned shards = vm["shards"].as<unsigned>();
+        userstore::UserStore::create(storeDirectory(vm), shards);
+        out << "Store created with " << shards << " shards" << '\n';
+        return SUCCESS;
+      }
+
+      /** A daemon compacts the store it holds, otherwise the copy is made while readers carry on */
+      userstore::UserStore::CompactionResult result;
+      if ( attachedStore_ )
+      {
+        result = attachedStore_->compact();
+      }
+      else
+      {
+        result = userstore::UserStore::compact(storeDirectory(vm));
+      }
+
+      out << "Store compacted, kept " << result.liveUsers_ << " users and dropped " << result.deadRecords_
+          << " deleted records, " << result.bytesBefore_ << " -> " << result.bytesAfter_ << " bytes" << '\n';
+      return SUCCESS;
+    }
+    catch(userstore::StoreError& e)
+    {
+      err << "ERROR: store " << action << " failed: " << e.what() << '\n';
+      return FAILURE;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::serve(const po::variables_map& vm, std::ostream& out, std::ostream& err)
+  {
+    if ( attachedStore_ || batching_ )
+    {
+      err << "ERROR: serve can't be run through a daemon or in a batch" << '\n';
+      return FAILURE;
+    }
+
+    std::string directory = boost::filesystem::absolute(storeDirectory(vm)).string();
+    std::string socketPath = vm.count("socket") ? vm["socket"].as<std::string>() : defaultSocketPath(directory);
+
+    boost::system::error_code error;
+    boost::filesystem::create_directories(directory, error);
+    if ( error )
+    {
+      throw userstore::StoreError("Unable to create store directory (" + directory + "): " + error.message(), directory);
+    }
+
+    /** The sockets come first, they refuse to start if a daemon is already running, while the store would block */
+    AdminServer server(socketPath);
+    std::unique_ptr<HttpServer> http( vm.count("http") ? new HttpServer(vm["http"].as<uint16_t>()) : nullptr );
+    userstore::UserStore store(directory, userstore::UserStore::OpenMode::ReadWrite, commitWindow(vm, false));
+
+    /** Any local user can reach the port, only those who can read the token can change users through it */
+    std::string tokenPath = (boost::filesystem::path(directory) / TOKEN_FILE_NAME).string();
+    std::string token = http ? writeAdminToken(tokenPath) : std::string();
+
+    out << "Serving store " << directory << " on " << socketPath;
+    if ( http )
+    {
+      out << " and http://127.0.0.1:" << http->port() << ADMIN_USER_PATH << ", changes authorised by " << tokenPath;
+    }
+    out << std::endl;
+
+    attachStore(&store);
+    AdminServer::Handler forwarded = [&](const AdminRequest& request)
+    {
+      AdminResponse response = { false, FAILURE, "", "" };
+      setDefaultStore(request.defaultStore_);
+      std::ostringstream commandOut, commandErr;
+      response.status_ = run(request.arguments_, commandOut, commandErr);
+      response.handled_ = response.status_ != NOT_SERVED;
+      response.out_ = commandOut.str();
+      response.err_ = commandErr.str();
+      return response;
+    };
+
+    if ( http )
+    {
+      /** Forwarded commands leave the default store as their client had it, HTTP requests always use this one */
+      http->watch(server.descriptor(), [&]() { server.serveNext(forwarded); });
+      http->run([&](const HttpRequest& request)
+      {
+        setDefaultStore(directory);
+        return adminOperation(request, token);
+      });
+      ::unlink(tokenPath.c_str());
+    }
+    else
+    {
+      server.run(forwarded);
+    }
+    attachStore(nullptr);
+    setDefaultStore(environmentStore());
+
+    out << "Stopped serving " << directory << std::endl;
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int CommandRunner::remote(const std::string& subcommandName,
+                            const po::variables_map& vm,
+                            std::ostream& out,
+                            std::ostream& err)
+  {
+    std::string token;
+    if ( vm.count("token-file") )
+    {
+      std::ifstream tokenFile(vm["token-file"].as<std::string>());
+      if ( ! (tokenFile >> token) )
+      {
+        err << "ERROR: Unable to read a token from " << vm["token-file"].as<std::string>() << '\n';
+        return FAILURE;
+      }
+    }
+    AdminClient client(vm["endpoint"].as<std::string>(),
+                       vm.count("connections") ? vm["connections"].as<unsigned>() : DEFAULT_REMOTE_CONNECTIONS,
+                       vm.count("window") ? vm["window"].as<unsigned>() : DEFAULT_REMOTE_WINDOW,
+                       std::chrono::seconds(vm.count("timeout") ? vm["timeout"].as<unsigned>() : DEFAULT_REMOTE_TIMEOUT),
+                       token);
+
+    if ( subcommandName == "info" ) // by uuid only, the admin ops API has no other lookup
+    {
+      std::string u_str = vm["uuid-String"].as<std::string>();
+      AdminCall call = { "GET", userTarget(u_str) + "&format=json", u_str };
+      AdminReply reply = client.call(call);
+      if ( reply.status_ != 200 )
+      {
+        reportRemoteFailure(err, call, reply);
+        return FAILURE;
+      }
+
+      RemoteUser user;
+      if ( ! AdminClient::parseUser(reply.body_, user) )
+      {
+        err << "ERROR: " << vm["endpoint"].as<std::string>() << " answered with a user that can't be read" << '\n';
+        return FAILURE;
+      }
+      userstore::UserRecord record;
+      record.uuid_ = user.uuid_;
+      record.displayName_ = user.displayName_;
+      record.email_ = user.email_;
+      formatterFor(vm, out)->user(record);
+      return SUCCESS;
+    }
+
+    const bool creating = subcommandName == "create";
+    const char* const method = creating ? "PUT" : "DELETE";
+    if ( ! vm.count("from-file") )
+    {
+      std::string u_str = vm["uuid-String"].as<std::string>();
+      AdminCall call = { method, "", u_str };
+      call.target_ = creating ? userTarget(u_str,
+                                           vm.count("display-name") ? vm["display-name"].as<std::string>() : "",
+                                           vm.count("email") ? vm["email"].as<std::string>() : "") :
+                                   userTarget(u_str);
+      AdminReply reply = client.call(call);
+      if ( reply.status_ != 200 )
+      {
+        reportRemoteFailure(err, call, reply);
+        return FAILURE;
+      }
+      out << "User with uuid " << u_str << (creating ? " created" : " deleted") << '\n';
+      return SUCCESS;
+    }
+
+    /** Lines are read only as the window has room for their calls, so any size of file runs in bounded memory */
+    std::string path = vm["from-file"].as<std::string>();
+    LineReader reader(path);
+    uint64_t succeeded = 0, failed = 0, unknown = 0;
+    client.run([&](AdminCall& call)
+    {
+      boost::string_view line;
+      while ( reader.next(line) )
+      {
+        BulkUserLine user;
+        try
+        {
+          if ( ! parseBulkUserLine(line, user) )
+          {
+            continue;
+          }
+        }
+        catch(BulkInputError& e)
+        {
+          err << path << ":" << reader.lineNumber() << ": " << e.what() << '\n';
+          ++failed;
+          continue;
+        }
+
+        call.method_ = method;
+        call.target_ = creating ? userTarget(user.uuid_, user.displayName_, user.email_) : userTarget(user.uuid_);
+        call.label_.assign(user.uuid_.data(), user.uuid_.size());
+        return true;
+      }
+      return false;
+    },
+    [&](const AdminCall& call, const AdminReply& reply)
+    {
+      if ( reply.status_ == 200 )
+      {
+        ++succeeded;
+      }
+      else
+      {
+        reportRemoteFailure(err, call, reply);
+        ++(reply.outcomeUnknown_ ? unknown : failed);
+      }
+    });
+
+    out << (creating ? "Created " : "Deleted ") << succeeded << " users, " << failed << " failed";
+    if ( unknown )
+    {
+      out << ", " << unknown << " with an unknown outcome";
+    }
+    out << '\n';
+    return failed == 0 && unknown == 0 ? SUCCESS : FAILURE;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  HttpResponse CommandRunner::adminOperation(const HttpRequest& request, const std::string& token)
+  {
+    std::map<std::string, std::string>::const_iterator format = request.query_.find("format");
+    std::string formatName = format == request.query_.end() ? "json" : format->second;
+    if ( formatName != "json" && formatName != "xml" )
+    {
+      return adminError(400, "InvalidArgument", "json");
+    }
+    if ( request.path_ != ADMIN_USER_PATH && request.path_ != ADMIN_USER_PATH + "/" )
+    {
+      return adminError(404, "NoSuchKey", formatName);
+    }
+    if ( (request.method_ == "PUT" || request.method_ == "DELETE")
+         && ! sameCredential(request.authorization_, "Bearer " + token) )
+    {
+      return adminError(403, "AccessDenied", formatName);
+    }
+
+    std::map<std::string, std::string>::const_iterator uid = request.query_.find("uid");
+    std::map<std::string, std::string>::const_iterator displayName = request.query_.find("display-name");
+    std::map<std::string, std::string>::const_iterator email = request.query_.find("email");
+    if ( uid == request.query_.end() || uid->second.empty() )
+    {
+      return adminError(400, "InvalidArgument", formatName);
+    }
+
+    /** Values go in as --name=value so one starting with a dash can't be taken for an option */
+    std::vector<std::string> info = { "info", "--uuid-String=" + uid->second, "--format=" + formatName };
+    std::vector<std::string> arguments;
+    if ( request.method_ == "GET" )
+    {
+      arguments = info;
+    }
+    else if ( request.method_ == "PUT" )
+    {
+      arguments = { "create", "--uuid-String=" + uid->second };
+      if ( displayName != request.query_.end() && ! displayName->second.empty() ) // empty is the same as none
+      {
+        arguments.push_back("--display-name=" + displayName->second);
+      }
+      if ( email != request.query_.end() && ! email->second.empty() )
+      {
+        arguments.push_back("--email=" + email->second);
+      }
+    }
+    else if ( request.method_ == "DELETE" )
+    {
+      arguments = { "delete", "--uuid-String=" + uid->second };
+    }
+    else
+    {
+      return adminError(405, "MethodNotAllowed", formatName);
+    }
+
+    std::ostringstream commandOut, commandErr;
+    int status = run(arguments, commandOut, commandErr);
+    if ( status == SUCCESS && request.method_ == "PUT" ) // RGW answers a create with the user's info
+    {
+      commandOut.str("");
+      status = run(info, commandOut, commandErr);
+    }
+
+    if ( status == SUCCESS )
+    {
+      HttpResponse response;
+      response.status_ = 200;
+      if ( request.method_ != "DELETE" )
+      {
+        response.contentType_ = formatName == "xml" ? "application/xml" : "application/json";
+        response.body_ = commandOut.str();
+      }
+      return response;
+    }
+
+    /** The command has reported why on its error stream, the store says which of the API's errors that was */
+    if ( request.method_ != "PUT" )
+    {
+      return userstore::isMalformedUuid(uid->second) || attachedStore_->contains(uid->second) ?
+               adminError(400, "InvalidArgument", formatName) : adminError(404, "NoSuchUser", formatName);
+    }
+    if ( attachedStore_->contains(uid->second) )
+    {
+      return adminError(409, "UserAlreadyExists", formatName);
+    }
+    if ( email != request.query_.end() && ! email->second.empty() && attachedStore_->getByEmail(email->second) )
+    {
+      return adminError(409, "EmailExists", formatName);
+    }
+    return adminError(400, "InvalidArgument", formatName);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  userstore::UserStore& CommandRunner::storeFor(const po::variables_map& vm,
+                                                userstore::UserStore::OpenMode mode,
+                                                std::unique_ptr<userstore::UserStore>& owned)
+  {
+    if ( attachedStore_ )
+    {
+      return *attachedStore_;
+    }
+
+    bool writable = mode == userstore::UserStore::OpenMode::ReadWrite;
+    if ( ! batching_ )
+    {
+      owned.reset( new userstore::UserStore(storeDirectory(vm), mode, commitWindow(vm, false)) );
+      return *owned;
+    }
+
+    /** Reopened only when a batch moves to another store, or needs to write to one it has only read so far */
+    boost::system::error_code error;
+    if ( ! batchStore_
+         || ! boost::filesystem::equivalent(storeDirectory(vm), batchStore_->directory(), error)
+         || (writable && ! batchStoreWritable_) )
+    {
+      batchStore_.reset(); // release the previous store's lock before taking another
+      batchStore_.reset( new userstore::UserStore(storeDirectory(vm), mode, commitWindow(vm, true)) );
+      batchStoreWritable_ = writable;
+    }
+    return *batchStore_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void CommandRunner::commitCommand(userstore::UserStore& store)
+  {
+    if ( &store != batchStore_.get() )
+    {
+      store.commit();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool CommandRunner::servesStore(const po::variables_map& vm) const
+  {
+    if ( ! attachedStore_ )
+    {
+      return true;
+    }
+
+    /** A relative directory is the client's, which would be looked for in the daemon's working directory */
+    boost::filesystem::path directory = storeDirectory(vm);
+    boost::system::error_code error;
+    return directory.is_absolute() && boost::filesystem::equivalent(directory, attachedStore_->directory(), error);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<Formatter> CommandRunner::formatterFor(const po::variables_map& vm, std::ostream& out)
+  {
+    return Formatter::create(vm.count("format") ? vm["format"].as<std::string>() : defaultFormat_, out, outputBuffer_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
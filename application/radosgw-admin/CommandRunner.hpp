@@ -0,0 +1,143 @@
+#ifndef COMMANDRUNNER_HPP
+#define COMMANDRUNNER_HPP
+
+#include "Formatter.hpp"
+
+#include "oberon/SubcommandCLI.hpp"
+
+#include "userstore/UserStore.hpp"
+
+#include "boost/program_options.hpp"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace basic
+{
+  struct HttpRequest;
+  struct HttpResponse;
+
+//**********************************************************************************************************************
+  /** Runs radosgw-admin command lines against the user store, writing results to the streams it is given
+   *
+   * A runner is built once around the application's SubcommandCLI and can run any number of command lines, which is
+   * what lets the daemon and batch modes avoid paying for process start and option setup per command. Errors in a
+   * command are reported on the error stream and as a failure status, they are never thrown out of run().
+   *
+   * By default every command opens the store it names and closes it when done. A runner attached to a store (see
+   * attachStore) runs commands against that open store instead, and declines commands that name a different one.
+   *
+   * serve --http also answers the user calls of the RGW admin ops API over HTTP, each run as the command line it maps
+   * to (GET /admin/user?uid= as info, PUT as create and DELETE as delete) against the store being served.
+   *
+   * create, delete and info given --endpoint run against an RGW admin ops compatible endpoint rather than a store, see
+   * AdminClient; bulk runs keep a bounded window of calls in flight over a pool of pipelined connections.
+   *
+   * --batch runs one command line per line of stdin. The store is kept open while consecutive lines use it and the log
+   * is committed in batches rather than per command, which is what makes thousands of small commands cheap. --store and
+   * --format given with --batch are the defaults for its lines.
+   */
+  class CommandRunner
+  {
+  public: // types
+    static const int SUCCESS = 0;
+    static const int FAILURE = 1;
+
+    /** Returned by run() when an attached runner is asked to run a command for a store it doesn't hold */
+    static const int NOT_SERVED = -1;
+
+  public: // interface
+    CommandRunner(oberon::SubcommandCLI& application);
+
+    /** Run a command line, argv[0] is the program name as for main()
+     *
+     * @returns the exit status for the command, or NOT_SERVED.
+     */
+    int run(int argc, char** argv, std::ostream& out, std::ostream& err);
+
+    /** Run a command line given as arguments without the program name */
+    int run(const std::vector<std::string>& arguments, std::ostream& out, std::ostream& err);
+
+    /** Run every command line read from stdin, lines are split as a unix shell would and blank or # lines are skipped
+     *
+     * @param options: the batch's own command line, its --store and --format are the defaults for every line.
+     * @returns FAILURE if any command failed, the remaining commands still run.
+     * @throws oberon::CommandLineParsingError: if the batch is given any other subcommand option, or an unknown format.
+     */
+    int runBatch(const boost::program_options::variables_map& options, std::ostream& out, std::ostream& err);
+
+    /** Run every command against this store rather than opening one per command, the store must stay open for as
+     *  long as the runner is used */
+    void attachStore(userstore::UserStore* store) { attachedStore_ = store; }
+
+    /** Store directory used when a command line has no --store, defaults to the environment or the built in default */
+    void setDefaultStore(const std::string& directory) { defaultStore_ = directory; }
+
+    /** @returns the store directory a command line refers to, see setDefaultStore */
+    std::string storeDirectory(const boost::program_options::variables_map& vm) const;
+
+    /** The default store directory for this process: RADOSGW_ADMIN_STORE if set, otherwise the built in default */
+    static std::string environmentStore();
+
+    /** The admin socket for a store when serve isn't given --socket */
+    static std::string defaultSocketPath(const std::string& storeDirectory);
+
+  private: // methods
+    int dispatch(const std::string& subcommandName,
+                 const boost::program_options::variables_map& vm,
+                 std::ostream& out,
+                 std::ostream& err);
+
+    int create(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+    int remove(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+    int info(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+    int list(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+    int stats(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+    int store(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+    int serve(const boost::program_options::variables_map& vm, std::ostream& out, std::ostream& err);
+
+    /** Run create, delete or info against the command's --endpoint */
+    int remote(const std::string& subcommandName,
+               const boost::program_options::variables_map& vm,
+               std::ostream& out,
+               std::ostream& err);
+
+    /** Answer an admin ops API request by running the command it maps to, attached to the served store
+     *
+     * @param token: PUT and DELETE are refused unless they carry it as "Authorization: Bearer <token>".
+     */
+    HttpResponse adminOperation(const HttpRequest& request, const std::string& token);
+
+    /** The store a command runs against: the attached store, the batch store, or a new one kept alive by owned */
+    userstore::UserStore& storeFor(const boost::program_options::variables_map& vm,
+                                   userstore::UserStore::OpenMode mode,
+                                   std::unique_ptr<userstore::UserStore>& owned);
+
+    /** Commit a command's mutations unless it is part of a batch, which commits as its log window fills and at the end */
+    void commitCommand(userstore::UserStore& store);
+
+    /** True if the command line names the store this runner is attached to */
+    bool servesStore(const boost::program_options::variables_map& vm) const;
+
+    /** Formatter for the command's --format, the default format if it has none, building its output in outputBuffer_ */
+    std::unique_ptr<Formatter> formatterFor(const boost::program_options::variables_map& vm, std::ostream& out);
+
+  private: // data
+    oberon::SubcommandCLI& application_;
+    userstore::UserStore* attachedStore_;
+    std::string defaultStore_;
+    std::string defaultFormat_; // plain, other than for the lines of a batch given --format
+    bool batching_;
+    std::unique_ptr<userstore::UserStore> batchStore_;
+    bool batchStoreWritable_;
+    std::string outputBuffer_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // COMMANDRUNNER_HPP
@@ -3,11 +3,18 @@
 
 #include "oberon/Subcommand.hpp"
 #include "oberon/OptionCollection.hpp"
+#include "oberon/Utils.hpp"
+#include "userstore/Uuid.hpp"
+
+#include <string>
 
 namespace basic
 {
   class Create : public oberon::Subcommand
   {
+  public: // types
+    static const unsigned MAX_THREADS = 256;
+
   public: // interface
     Create(oberon::OptionCollection sharedOptions) :
       oberon::Subcommand("create", "create a user from the provided string", sharedOptions)
@@ -15,30 +22,71 @@ namespace basic
       /** **/
     }
 
-    boost::program_options::options_description uniqueOptions(bool includeHidden, bool enableRestrictions) const
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
     {
-      /** Several options for specifying user info while creation.
-       *  See how nasty this would be without subcommand separation?
+      /** Display name and email are shared with info, which looks users up by them.
        */
       boost::program_options::options_description returnOptions;
       returnOptions.add_options()
         ("uuid,u", "Include lower case characters in the selection for random replacement")
-        ("display-name,d", "Include upper case characters in the selection for random replacement")
-        ("email,e", "Include numbers in the selection for random replacement");
+        ("threads,t", getOptionValue<unsigned>(), "Parse and stage --from-file users on this many threads");
 
       return returnOptions;
     }
 
-    boost::program_options::positional_options_description positionalOptions() const
+    boost::program_options::positional_options_description positionalOptions() const override
     {
       boost::program_options::positional_options_description positional;
       positional.add("uuid-String", 1);
       return positional;
     }
 
-    /** This is a new addition yet to be implemented
+    /** The uuid is shared with info, where it is optional, so it can't be marked required on the shared option.
+     *  It is also replaced entirely by --from-file, where the file supplies uuids, names and emails.
      */
-  //  void checkOptionConsistency(boost::program_options::variables_map vm) const;
+    void checkOptionConsistency(const boost::program_options::variables_map& vm) const override
+    {
+      if ( vm.count("from-file") )
+      {
+        if ( vm.count("uuid-String") || vm.count("display-name") || vm.count("email") )
+        {
+          throw oberon::CommandLineParsingError("Subcommand 'create' takes user details from either the command line or "
+                                                "--from-file, not both.",
+                                                name());
+        }
+        if ( vm.count("threads") && (vm["threads"].as<unsigned>() < 1 || vm["threads"].as<unsigned>() > MAX_THREADS) )
+        {
+          throw oberon::CommandLineParsingError("Subcommand 'create' takes --threads from 1 to "
+                                                + std::to_string(MAX_THREADS) + ".",
+                                                name());
+        }
+      }
+      else if ( vm.count("threads") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'create' only uses --threads with --from-file.", name());
+      }
+      else if ( ! vm.count("uuid-String") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'create' used without required positional option: uuidString.",
+                                              name());
+      }
+      if ( vm.count("uuid-String") && userstore::isMalformedUuid(vm["uuid-String"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Malformed uuid '" + vm["uuid-String"].as<std::string>() + "'.", name());
+      }
+      if ( (vm.count("connections") || vm.count("window") || vm.count("timeout") || vm.count("token-file"))
+           && ! vm.count("endpoint") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'create' takes --connections, --window, --timeout and "
+                                              "--token-file only with --endpoint.", name());
+      }
+      if ( vm.count("endpoint") && vm.count("threads") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'create' stages --threads locally, size an --endpoint "
+                                              "run with --window.", name());
+      }
+    }
 
   }; // class
 
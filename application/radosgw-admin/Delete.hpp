@@ -3,6 +3,8 @@
 
 #include "oberon/Subcommand.hpp"
 #include "oberon/OptionCollection.hpp"
+#include "oberon/Utils.hpp"
+#include "userstore/Uuid.hpp"
 
 namespace basic
 {
@@ -15,7 +17,8 @@ namespace basic
       /** **/
     }
 
-    boost::program_options::options_description uniqueOptions(bool includeHidden, bool enableRestrictions) const
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
     {
       boost::program_options::options_description returnOptions;
       returnOptions.add_options()
@@ -24,7 +27,7 @@ namespace basic
       return returnOptions;
     }
 
-    boost::program_options::positional_options_description positionalOptions() const
+    boost::program_options::positional_options_description positionalOptions() const override
     {
       /** Now that we have share positional options it is necessary to specify where they should appear in the command
        *  line for this subcommand. Note here that you as the programmer 'know' the names of the shared options that
@@ -35,6 +38,32 @@ namespace basic
       return positional;
     }
 
+    /** The uuid is shared with info, where it is optional, so it can't be marked required on the shared option.
+     *  It is also replaced entirely by --from-file, where the file supplies the uuids.
+     */
+    void checkOptionConsistency(const boost::program_options::variables_map& vm) const override
+    {
+      if ( vm.count("from-file") && vm.count("uuid-String") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'delete' takes a uuid or --from-file, not both.", name());
+      }
+      if ( ! vm.count("uuid-String") && ! vm.count("from-file") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'delete' used without required positional option: uuidString.",
+                                              name());
+      }
+      if ( vm.count("uuid-String") && userstore::isMalformedUuid(vm["uuid-String"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Malformed uuid '" + vm["uuid-String"].as<std::string>() + "'.", name());
+      }
+      if ( (vm.count("connections") || vm.count("window") || vm.count("timeout") || vm.count("token-file"))
+           && ! vm.count("endpoint") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'delete' takes --connections, --window, --timeout and "
+                                              "--token-file only with --endpoint.", name());
+      }
+    }
+
   }; // class
 
 //**********************************************************************************************************************
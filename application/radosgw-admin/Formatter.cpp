@@ -0,0 +1,544 @@
+#include "Formatter.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  /** Output is handed to the stream a chunk at a time, large enough to make the per chunk cost vanish and small enough
+   *  to stay in cache */
+  const size_t CHUNK_SIZE = 64 * 1024;
+
+  const size_t BYTE_VALUES = 256;
+  const size_t CONTROL_CHARACTERS = ' ';
+
+} // namespace
+
+namespace basic
+{
+//**********************************************************************************************************************
+  /** How a format escapes text: control characters always, and printable characters only if they are among its
+   *  specials, so text can be searched for the next character to escape 16 bytes at a time
+   */
+  struct EscapeTable
+  {
+    /** @param controlFormat: printf format of a control character's numeric escape
+     *  @param specials: printable characters that are escaped, at most MAX_SPECIALS of them, each with its escape
+     */
+    EscapeTable(const char* controlFormat, std::initializer_list<std::pair<char, const char*>> specials) :
+      escapes_(),
+      specialCount_(0)
+    {
+      for (size_t character = 0; character < CONTROL_CHARACTERS; ++character)
+      {
+        std::snprintf(numeric_[character], sizeof(numeric_[character]), controlFormat, static_cast<unsigned>(character));
+        escapes_[character] = numeric_[character];
+      }
+      for (const std::pair<char, const char*>& special : specials)
+      {
+        escapes_[static_cast<unsigned char>(special.first)] = special.second;
+        if ( static_cast<unsigned char>(special.first) >= CONTROL_CHARACTERS )
+        {
+          assert( specialCount_ < MAX_SPECIALS );
+          specials_[specialCount_++] = special.first;
+        }
+      }
+    }
+
+    /** @returns the first character from begin on that has to be escaped, or end */
+    const char* find(const char* begin, const char* end) const
+    {
+#ifdef __SSE2__
+      for (; end - begin >= 16; begin += 16)
+      {
+        __m128i text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+
+        /** Bytes from 0x80 up compare as negative, they are part of UTF-8 sequences and written as they are */
+        __m128i found = _mm_and_si128(_mm_cmplt_epi8(text, _mm_set1_epi8(CONTROL_CHARACTERS)),
+                                      _mm_cmpgt_epi8(text, _mm_set1_epi8(-1)));
+        for (size_t special = 0; special < specialCount_; ++special)
+        {
+          found = _mm_or_si128(found, _mm_cmpeq_epi8(text, _mm_set1_epi8(specials_[special])));
+        }
+
+        if ( int mask = _mm_movemask_epi8(found) )
+        {
+          return begin + __builtin_ctz(mask);
+        }
+      }
+#endif
+      while ( begin != end && ! escapes_[static_cast<unsigned char>(*begin)] )
+      {
+        ++begin;
+      }
+      return begin;
+    }
+
+    static const size_t MAX_SPECIALS = 5;
+
+    const char* escapes_[BYTE_VALUES];
+    char numeric_[CONTROL_CHARACTERS][8];
+    char specials_[MAX_SPECIALS];
+    size_t specialCount_;
+
+  }; // struct
+
+//**********************************************************************************************************************
+
+} // namespace
+
+namespace
+{
+  const basic::EscapeTable JSON_ESCAPES("\\u%04x", { { '"', "\\\"" }, { '\\', "\\\\" }, { '\n', "\\n" }, { '\t', "\\t" } });
+  const basic::EscapeTable XML_ESCAPES("&#x%x;", { { '&', "&amp;" }, { '<', "&lt;" }, { '>', "&gt;" }, { '"', "&quot;" },
+                                                   { '\'', "&apos;" } });
+
+//**********************************************************************************************************************
+  /** The tab separated form bulk input files use, and one uuid per line for list
+   */
+  class PlainFormatter : public basic::Formatter
+  {
+  public: // interface
+    PlainFormatter(std::ostream& out, std::string& buffer) : basic::Formatter(out, buffer) {}
+
+    void user(const userstore::UserRecord& user)
+    {
+      append(user.uuid_);
+      append('\t');
+      append(user.displayName_);
+      append('\t');
+      append(user.email_);
+      append('\n');
+    }
+
+    void openUsers() {}
+    void listedUser(const userstore::UserRecord& user) { this->user(user); }
+    void closeUsers() {}
+
+    void openKeys() {}
+
+    void key(boost::string_view uuid)
+    {
+      append(uuid);
+      append('\n');
+    }
+
+    /** Nothing to add, the caller says where to resume on the error stream */
+    void closeKeys(bool truncated, boost::string_view marker) {}
+
+    /** The counters tab separated, after the uuid if there is one */
+    void usage(boost::string_view uuid, const userstore::UserUsage& usage)
+    {
+      if ( ! uuid.empty() )
+      {
+        append(uuid);
+        append('\t');
+      }
+      appendNumber(usage.objects_);
+      append('\t');
+      appendNumber(usage.bytes_);
+      append('\t');
+      appendNumber(static_cast<int64_t>(usage.ops_));
+      append('\n');
+    }
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Compact JSON, with a line per element of an array so large outputs can still be read by line oriented tools
+   */
+  class JsonFormatter : public basic::Formatter
+  {
+  public: // interface
+    JsonFormatter(std::ostream& out, std::string& buffer) : basic::Formatter(out, buffer), first_(true) {}
+
+    void user(const userstore::UserRecord& user)
+    {
+      userObject(user);
+      append('\n');
+    }
+
+    void openUsers()
+    {
+      append('[');
+      first_ = true;
+    }
+
+    void listedUser(const userstore::UserRecord& user)
+    {
+      separate();
+      userObject(user);
+    }
+
+    void closeUsers()
+    {
+      append("\n]\n");
+    }
+
+    void openKeys()
+    {
+      append("{\"keys\":[");
+      first_ = true;
+    }
+
+    void key(boost::string_view uuid)
+    {
+      separate();
+      string(uuid);
+    }
+
+    void closeKeys(bool truncated, boost::string_view marker)
+    {
+      append(truncated ? "\n],\"truncated\":true" : "\n],\"truncated\":false");
+      if ( truncated )
+      {
+        append(",\"marker\":");
+        string(marker);
+      }
+      append("}\n");
+    }
+
+    void usage(boost::string_view uuid, const userstore::UserUsage& usage)
+    {
+      append('{');
+      if ( ! uuid.empty() )
+      {
+        append("\"user_id\":");
+        string(uuid);
+        append(',');
+      }
+      append("\"stats\":{\"num_objects\":");
+      appendNumber(usage.objects_);
+      append(",\"size\":");
+      appendNumber(usage.bytes_);
+      append(",\"ops\":");
+      appendNumber(static_cast<int64_t>(usage.ops_));
+      append("}}\n");
+    }
+
+  private: // methods
+    void string(boost::string_view value)
+    {
+      append('"');
+      appendEscaped(value, JSON_ESCAPES);
+      append('"');
+    }
+
+    void userObject(const userstore::UserRecord& user)
+    {
+      append("{\"user_id\":\"");
+      appendEscaped(user.uuid_, JSON_ESCAPES);
+      append("\",\"display_name\":\"");
+      appendEscaped(user.displayName_, JSON_ESCAPES);
+      append("\",\"email\":\"");
+      appendEscaped(user.email_, JSON_ESCAPES);
+      append("\"}");
+    }
+
+    void separate()
+    {
+      append(first_ ? "\n" : ",\n");
+      first_ = false;
+    }
+
+  private: // data
+    bool first_; // no element of the open array has been written yet
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** XML with the same element names as the JSON, a line per element of a collection
+   */
+  class XmlFormatter : public basic::Formatter
+  {
+  public: // interface
+    XmlFormatter(std::ostream& out, std::string& buffer) : basic::Formatter(out, buffer) {}
+
+    void user(const userstore::UserRecord& user)
+    {
+      userElement(user);
+      append('\n');
+    }
+
+    void openUsers()
+    {
+      append("<users>\n");
+    }
+
+    void listedUser(const userstore::UserRecord& user)
+    {
+      userElement(user);
+      append('\n');
+    }
+
+    void closeUsers()
+    {
+      append("</users>\n");
+    }
+
+    void openKeys()
+    {
+      append("<list><keys>\n");
+    }
+
+    void key(boost::string_view uuid)
+    {
+      element("<key>", uuid, "</key>\n");
+    }
+
+    void closeKeys(bool truncated, boost::string_view marker)
+    {
+      append(truncated ? "</keys><truncated>true</truncated>" : "</keys><truncated>false</truncated>");
+      if ( truncated )
+      {
+        element("<marker>", marker, "</marker>");
+      }
+      append("</list>\n");
+    }
+
+    void usage(boost::string_view uuid, const userstore::UserUsage& usage)
+    {
+      append("<stats>");
+      if ( ! uuid.empty() )
+      {
+        element("<user_id>", uuid, "</user_id>");
+      }
+      append("<num_objects>");
+      appendNumber(usage.objects_);
+      append("</num_objects><size>");
+      appendNumber(usage.bytes_);
+      append("</size><ops>");
+      appendNumber(static_cast<int64_t>(usage.ops_));
+      append("</ops></stats>\n");
+    }
+
+  private: // methods
+    /** @param open, close: the element's tags, written whole */
+    void element(boost::string_view open, boost::string_view value, boost::string_view close)
+    {
+      append(open);
+      appendEscaped(value, XML_ESCAPES);
+      append(close);
+    }
+
+    void userElement(const userstore::UserRecord& user)
+    {
+      element("<user><user_id>", user.uuid_, "</user_id>");
+      element("<display_name>", user.displayName_, "</display_name>");
+      element("<email>", user.email_, "</email></user>");
+    }
+
+  }; // class
+
+} // namespace
+
+namespace basic {
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<Formatter> Formatter::create(const std::string& format, std::ostream& out, std::string& buffer)
+  {
+    std::unique_ptr<Formatter> formatter;
+    if ( format == "plain" )
+    {
+      formatter.reset( new PlainFormatter(out, buffer) );
+    }
+    else if ( format == "json" )
+    {
+      formatter.reset( new JsonFormatter(out, buffer) );
+    }
+    else if ( format == "xml" )
+    {
+      formatter.reset( new XmlFormatter(out, buffer) );
+    }
+    return formatter;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool Formatter::isFormat(const std::string& format)
+  {
+    return format == "plain" || format == "json" || format == "xml";
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  Formatter::Formatter(std::ostream& out, std::string& buffer) :
+    out_(out),
+    buffer_(buffer),
+    used_(0)
+  {
+    buffer_.resize(CHUNK_SIZE);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  Formatter::~Formatter()
+  {
+    flush();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void Formatter::flush()
+  {
+    writeBuffer();
+    out_.flush();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void Formatter::appendNumber(int64_t value)
+  {
+    char digits[24];
+    char* start = digits + sizeof(digits);
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    do
+    {
+      *--start = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    }
+    while ( magnitude != 0 );
+    if ( value < 0 )
+    {
+      *--start = '-';
+    }
+    append(boost::string_view(start, digits + sizeof(digits) - start));
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void Formatter::appendEscaped(boost::string_view text, const EscapeTable& escapes)
+  {
+    const char* end = text.data() + text.size();
+    for (const char* run = text.data(); ; )
+    {
+      const char* escaped = escapes.find(run, end);
+      append(boost::string_view(run, escaped - run));
+      if ( escaped == end )
+      {
+        return;
+      }
+      append(escapes.escapes_[static_cast<unsigned char>(*escaped)]);
+      run = escaped + 1;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void Formatter::appendSlowly(boost::string_view text)
+  {
+    writeBuffer();
+    if ( text.size() > buffer_.size() )
+    {
+      out_.write(text.data(), text.size());
+      return;
+    }
+    std::memcpy(&buffer_[0], text.data(), text.size());
+    used_ = text.size();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void Formatter::writeBuffer()
+  {
+    out_.write(buffer_.data(), used_);
+    used_ = 0;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  DescriptorBuffer::DescriptorBuffer(int fd, size_t bufferSize) :
+    fd_(fd),
+    buffer_(bufferSize)
+  {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  DescriptorBuffer::~DescriptorBuffer()
+  {
+    writeOut(nullptr, 0);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  DescriptorBuffer::int_type DescriptorBuffer::overflow(int_type character)
+  {
+    if ( ! writeOut(nullptr, 0) )
+    {
+      return traits_type::eof();
+    }
+    if ( ! traits_type::eq_int_type(character, traits_type::eof()) )
+    {
+      *pptr() = traits_type::to_char_type(character);
+      pbump(1);
+    }
+    return traits_type::not_eof(character);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::streamsize DescriptorBuffer::xsputn(const char* data, std::streamsize size)
+  {
+    if ( size <= epptr() - pptr() )
+    {
+      std::memcpy(pptr(), data, size);
+      pbump(static_cast<int>(size));
+      return size;
+    }
+    return writeOut(data, size) ? size : 0;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int DescriptorBuffer::sync()
+  {
+    return writeOut(nullptr, 0) ? 0 : -1;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool DescriptorBuffer::writeOut(const char* data, size_t size)
+  {
+    iovec pieces[2] = { { pbase(), static_cast<size_t>(pptr() - pbase()) }, { const_cast<char*>(data), size } };
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+
+    iovec* next = pieces;
+    int remaining = 2;
+    while ( remaining > 0 )
+    {
+      if ( next->iov_len == 0 )
+      {
+        ++next;
+        --remaining;
+        continue;
+      }
+
+      ssize_t written = ::writev(fd_, next, remaining);
+      if ( written < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        return false;
+      }
+
+      for (size_t done = written; done > 0; )
+      {
+        size_t step = std::min(done, next->iov_len);
+        next->iov_base = static_cast<char*>(next->iov_base) + step;
+        next->iov_len -= step;
+        done -= step;
+        if ( next->iov_len == 0 && done > 0 )
+        {
+          ++next;
+          --remaining;
+        }
+      }
+    }
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
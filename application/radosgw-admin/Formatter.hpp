@@ -0,0 +1,146 @@
+#ifndef FORMATTER_HPP
+#define FORMATTER_HPP
+
+#include "userstore/UserStore.hpp"
+
+#include "boost/utility/string_view.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace basic
+{
+  struct EscapeTable;
+
+//**********************************************************************************************************************
+  /** Writes the results of info, list and stats in one of the --format output formats: plain, json or xml
+   *
+   * plain is the tab separated form bulk input files use (uuid, display name, email), one user per line, and list
+   * prints one uuid per line. json and xml follow radosgw-admin: a user is an object with user_id, display_name and
+   * email, list prints {"keys": [...], "truncated": bool} with a "marker" to resume from when truncated and stats
+   * prints {"user_id": ..., "stats": {"num_objects": ..., "size": ..., "ops": ...}}.
+   *
+   * Output is built in a buffer the caller keeps and reuses, and handed to the stream in large chunks, so a listing
+   * costs a copy per field rather than a stream call per field. Nothing reaches the stream until flush() or a chunk
+   * fills, so callers flush before reporting anything on another stream.
+   */
+  class Formatter
+  {
+  public: // interface
+    /** @param buffer: where output is built, kept by the caller so its space is reused from command to command.
+     *  @returns null if the name isn't one of the formats.
+     */
+    static std::unique_ptr<Formatter> create(const std::string& format, std::ostream& out, std::string& buffer);
+
+    static bool isFormat(const std::string& format);
+
+    /** Flushes anything still buffered */
+    virtual ~Formatter();
+
+    Formatter(const Formatter&) = delete;
+    Formatter& operator=(const Formatter&) = delete;
+
+    /** A user on its own, as info shows a user looked up by uuid or email */
+    virtual void user(const userstore::UserRecord& user) = 0;
+
+    /** Any number of users, as info shows users found by display name or every user */
+    virtual void openUsers() = 0;
+    virtual void listedUser(const userstore::UserRecord& user) = 0;
+    virtual void closeUsers() = 0;
+
+    /** A page of uuids as list shows them, closeKeys gives the marker for the next page if there is one */
+    virtual void openKeys() = 0;
+    virtual void key(boost::string_view uuid) = 0;
+    virtual void closeKeys(bool truncated, boost::string_view marker) = 0;
+
+    /** The usage counters of the user with the uuid, or of every user added up if the uuid is empty */
+    virtual void usage(boost::string_view uuid, const userstore::UserUsage& usage) = 0;
+
+    /** Hand everything buffered to the stream and flush it */
+    void flush();
+
+  protected: // methods
+    Formatter(std::ostream& out, std::string& buffer);
+
+    void append(boost::string_view text)
+    {
+      if ( text.size() > buffer_.size() - used_ )
+      {
+        appendSlowly(text);
+        return;
+      }
+      std::memcpy(&buffer_[used_], text.data(), text.size());
+      used_ += text.size();
+    }
+
+    void append(char character)
+    {
+      if ( used_ == buffer_.size() )
+      {
+        writeBuffer();
+      }
+      buffer_[used_++] = character;
+    }
+
+    void appendNumber(int64_t value);
+
+    /** Append text with each character the format can't hold as it is replaced by its escape */
+    void appendEscaped(boost::string_view text, const EscapeTable& escapes);
+
+  private: // methods
+    /** Append text that doesn't fit in what is left of the buffer */
+    void appendSlowly(boost::string_view text);
+
+    /** Hand the buffer to the stream without flushing it */
+    void writeBuffer();
+
+  private: // data
+    std::ostream& out_;
+    std::string& buffer_; // sized once, only the first used_ bytes hold output
+    size_t used_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Stream buffer writing to a file descriptor, for standard output
+   *
+   * Writes smaller than the buffer are gathered in it, a write that doesn't fit goes out with whatever is already
+   * buffered in a single writev, without being copied. So a Formatter's chunks reach the descriptor at one system call
+   * each however the output is split up.
+   */
+  class DescriptorBuffer : public std::streambuf
+  {
+  public: // interface
+    DescriptorBuffer(int fd, size_t bufferSize=64 * 1024);
+
+    /** Flushes anything still buffered, errors are lost */
+    ~DescriptorBuffer();
+
+    DescriptorBuffer(const DescriptorBuffer&) = delete;
+    DescriptorBuffer& operator=(const DescriptorBuffer&) = delete;
+
+  protected: // std::streambuf
+    int_type overflow(int_type character);
+    std::streamsize xsputn(const char* data, std::streamsize size);
+    int sync();
+
+  private: // methods
+    /** Write the buffered bytes followed by the given ones, @returns false if the descriptor failed */
+    bool writeOut(const char* data, size_t size);
+
+  private: // data
+    int fd_;
+    std::vector<char> buffer_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // FORMATTER_HPP
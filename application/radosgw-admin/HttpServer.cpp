@@ -0,0 +1,561 @@
+#include "HttpServer.hpp"
+
+#include "boost/algorithm/string/case_conv.hpp"
+#include "boost/utility/string_view.hpp"
+
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+  const int LISTEN_BACKLOG = 1024;
+  const int MAX_EVENTS = 64;
+  const size_t RECEIVE_CHUNK = 64 * 1024;
+
+  /** A request whose headers or body exceed these is refused and its connection closed */
+  const size_t MAX_HEADER_BYTES = 16 * 1024;
+  const size_t MAX_BODY_BYTES = 1024 * 1024;
+
+  /** Pipelined requests are left unanswered, and the connection unread, while this much output waits on the client */
+  const size_t MAX_PENDING_OUTPUT = 1024 * 1024;
+
+  const boost::string_view HEADER_END("\r\n\r\n");
+  const boost::string_view LINE_END("\r\n");
+
+  volatile std::sig_atomic_t stopRequested = 0;
+
+  void requestStop(int)
+  {
+    stopRequested = 1;
+  }
+
+  std::string lowerCase(boost::string_view text)
+  {
+    std::string lowered(text.data(), text.size());
+    boost::algorithm::to_lower(lowered);
+    return lowered;
+  }
+
+  boost::string_view trim(boost::string_view text)
+  {
+    while ( ! text.empty() && (text.front() == ' ' || text.front() == '\t') )
+    {
+      text.remove_prefix(1);
+    }
+    while ( ! text.empty() && (text.back() == ' ' || text.back() == '\t') )
+    {
+      text.remove_suffix(1);
+    }
+    return text;
+  }
+
+  int hexDigit(char digit)
+  {
+    if ( digit >= '0' && digit <= '9' ) return digit - '0';
+    if ( digit >= 'a' && digit <= 'f' ) return digit - 'a' + 10;
+    if ( digit >= 'A' && digit <= 'F' ) return digit - 'A' + 10;
+    return -1;
+  }
+
+  /** Decode %XX escapes and + as a space, a malformed escape is kept as it is */
+  std::string percentDecode(boost::string_view text)
+  {
+    std::string decoded;
+    decoded.reserve(text.size());
+    for (size_t position = 0; position < text.size(); ++position)
+    {
+      char character = text[position];
+      if ( character == '%' && position + 2 < text.size()
+           && hexDigit(text[position + 1]) >= 0 && hexDigit(text[position + 2]) >= 0 )
+      {
+        decoded.push_back(static_cast<char>(hexDigit(text[position + 1]) * 16 + hexDigit(text[position + 2])));
+        position += 2;
+      }
+      else
+      {
+        decoded.push_back(character == '+' ? ' ' : character);
+      }
+    }
+    return decoded;
+  }
+
+  void parseQuery(boost::string_view query, std::map<std::string, std::string>& parameters)
+  {
+    while ( ! query.empty() )
+    {
+      size_t end = query.find('&');
+      boost::string_view parameter = query.substr(0, end);
+      query = end == boost::string_view::npos ? boost::string_view() : query.substr(end + 1);
+      if ( parameter.empty() )
+      {
+        continue;
+      }
+
+      size_t equals = parameter.find('=');
+      if ( equals == boost::string_view::npos )
+      {
+        parameters[percentDecode(parameter)] = "";
+      }
+      else
+      {
+        parameters[percentDecode(parameter.substr(0, equals))] = percentDecode(parameter.substr(equals + 1));
+      }
+    }
+  }
+
+  void appendResponse(std::string& out, const basic::HttpResponse& response, bool keepAlive)
+  {
+    out.append("HTTP/1.1 ").append(std::to_string(response.status_)).append(" ")
+       .append(basic::HttpServer::reason(response.status_)).append("\r\n");
+    if ( ! response.contentType_.empty() )
+    {
+      out.append("Content-Type: ").append(response.contentType_).append("\r\n");
+    }
+    out.append("Content-Length: ").append(std::to_string(response.body_.size())).append("\r\n");
+    out.append(keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    out.append(response.body_);
+  }
+
+  basic::HttpResponse errorResponse(int status)
+  {
+    basic::HttpResponse response = { status, "", "" };
+    return response;
+  }
+
+} // namespace
+
+namespace basic {
+
+//----------------------------------------------------------------------------------------------------------------------
+  HttpServer::HttpServer(uint16_t port) :
+    listener_(-1),
+    epoll_(-1),
+    port_(port)
+  {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    int reuse = 1;
+    socklen_t addressSize = sizeof(address);
+    listener_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ( listener_ < 0
+         || ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0
+         || ::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+         || ::listen(listener_, LISTEN_BACKLOG) != 0
+         || ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &addressSize) != 0
+         || (epoll_ = ::epoll_create1(EPOLL_CLOEXEC)) < 0 )
+    {
+      std::string reason = std::strerror(errno);
+      if ( listener_ >= 0 )
+      {
+        ::close(listener_);
+      }
+      throw HttpServerError("Unable to listen on 127.0.0.1:" + std::to_string(port) + ": " + reason);
+    }
+    port_ = ntohs(address.sin_port);
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listener_;
+    ::epoll_ctl(epoll_, EPOLL_CTL_ADD, listener_, &event);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  HttpServer::~HttpServer()
+  {
+    for (const std::pair<const int, Connection>& connection : connections_)
+    {
+      ::close(connection.first);
+    }
+    ::close(epoll_);
+    ::close(listener_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HttpServer::watch(int fd, const std::function<void()>& onReadable)
+  {
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if ( ::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0 )
+    {
+      throw HttpServerError(std::string("Unable to watch descriptor: ") + std::strerror(errno));
+    }
+    watched_[fd] = onReadable;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HttpServer::run(const Handler& handler)
+  {
+    /** No SA_RESTART, so a signal interrupts epoll_wait() and the loop sees the stop request */
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    epoll_event events[MAX_EVENTS];
+    stopRequested = 0;
+    while ( ! stopRequested )
+    {
+      int ready = ::epoll_wait(epoll_, events, MAX_EVENTS, -1);
+      if ( ready < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        throw HttpServerError(std::string("Unable to wait for connections: ") + std::strerror(errno));
+      }
+
+      for (int index = 0; index < ready; ++index)
+      {
+        int fd = events[index].data.fd;
+        if ( fd == listener_ )
+        {
+          acceptConnections();
+          continue;
+        }
+
+        std::map<int, std::function<void()>>::iterator watched = watched_.find(fd);
+        if ( watched != watched_.end() )
+        {
+          watched->second();
+          continue;
+        }
+
+        std::map<int, Connection>::iterator connection = connections_.find(fd);
+        if ( connection == connections_.end() )
+        {
+          continue; // closed while handling an earlier event of this round
+        }
+        if ( events[index].events & EPOLLERR )
+        {
+          closeConnection(fd);
+          continue;
+        }
+        serviceConnection(fd, connection->second, events[index].events & (EPOLLIN | EPOLLHUP), handler);
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  const char* HttpServer::reason(int status)
+  {
+    switch ( status )
+    {
+      case 200: return "OK";
+      case 400: return "Bad Request";
+      case 403: return "Forbidden";
+      case 404: return "Not Found";
+      case 405: return "Method Not Allowed";
+      case 409: return "Conflict";
+      case 413: return "Payload Too Large";
+      case 431: return "Request Header Fields Too Large";
+      case 500: return "Internal Server Error";
+      case 501: return "Not Implemented";
+      case 505: return "HTTP Version Not Supported";
+      default:  return "Unknown";
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HttpServer::acceptConnections()
+  {
+    while ( true )
+    {
+      int fd = ::accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if ( fd < 0 )
+      {
+        if ( errno == EINTR || errno == ECONNABORTED )
+        {
+          continue;
+        }
+        return; // EAGAIN once the backlog is empty, anything else is retried on the next wakeup
+      }
+
+      /** Responses are written whole, there is nothing to gain from Nagle delaying the last segment of each */
+      int noDelay = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+      epoll_event event;
+      event.events = EPOLLIN;
+      event.data.fd = fd;
+      if ( ::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0 )
+      {
+        ::close(fd);
+        continue;
+      }
+      connections_[fd] = Connection();
+      connections_[fd].events_ = EPOLLIN;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HttpServer::serviceConnection(int fd, Connection& connection, bool readable, const Handler& handler)
+  {
+    if ( readable && ! connection.closing_ && ! connection.peerClosed_ && ! receive(fd, connection) )
+    {
+      closeConnection(fd);
+      return;
+    }
+
+    /** Answering stops while too much output is waiting, so keep going for as long as sending drains it */
+    while ( answerRequests(connection, handler) )
+    {
+      if ( ! send(fd, connection) )
+      {
+        closeConnection(fd);
+        return;
+      }
+      if ( connection.sent_ < connection.out_.size() )
+      {
+        break;
+      }
+    }
+    if ( ! send(fd, connection) )
+    {
+      closeConnection(fd);
+      return;
+    }
+
+    bool pending = connection.sent_ < connection.out_.size();
+    if ( ! pending && (connection.closing_ || connection.peerClosed_) )
+    {
+      closeConnection(fd); // a half request left by a client that stopped sending is never going to complete
+      return;
+    }
+
+    uint32_t events = pending ? static_cast<uint32_t>(EPOLLOUT) : 0u;
+    if ( ! connection.closing_ && ! connection.peerClosed_ && connection.out_.size() - connection.sent_ < MAX_PENDING_OUTPUT )
+    {
+      events |= EPOLLIN;
+    }
+    if ( events != connection.events_ )
+    {
+      epoll_event event;
+      event.events = events;
+      event.data.fd = fd;
+      ::epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &event);
+      connection.events_ = events;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool HttpServer::receive(int fd, Connection& connection)
+  {
+    char buffer[RECEIVE_CHUNK];
+    while ( true )
+    {
+      ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+      if ( received > 0 )
+      {
+        connection.in_.append(buffer, received);
+        if ( static_cast<size_t>(received) < sizeof(buffer) )
+        {
+          return true;
+        }
+        continue;
+      }
+      if ( received == 0 )
+      {
+        connection.peerClosed_ = true; // requests already received are still answered
+        return true;
+      }
+      if ( errno == EINTR )
+      {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool HttpServer::answerRequests(Connection& connection, const Handler& handler)
+  {
+    size_t consumed = 0;
+    bool answered = false;
+    while ( ! connection.closing_ && connection.out_.size() - connection.sent_ < MAX_PENDING_OUTPUT )
+    {
+      boost::string_view buffer(connection.in_);
+      buffer.remove_prefix(consumed);
+      size_t headerEnd = buffer.find(HEADER_END);
+      if ( headerEnd == boost::string_view::npos || headerEnd > MAX_HEADER_BYTES )
+      {
+        if ( buffer.size() > MAX_HEADER_BYTES )
+        {
+          appendResponse(connection.out_, errorResponse(431), false);
+          connection.closing_ = true;
+          answered = true;
+        }
+        break;
+      }
+
+      /** Request line, METHOD SP target SP version */
+      boost::string_view headers = buffer.substr(0, headerEnd + LINE_END.size());
+      size_t lineEnd = headers.find(LINE_END);
+      boost::string_view requestLine = headers.substr(0, lineEnd);
+      headers.remove_prefix(lineEnd + LINE_END.size());
+      size_t methodEnd = requestLine.find(' ');
+      size_t targetEnd = methodEnd == boost::string_view::npos ? methodEnd : requestLine.find(' ', methodEnd + 1);
+      if ( targetEnd == boost::string_view::npos )
+      {
+        appendResponse(connection.out_, errorResponse(400), false);
+        connection.closing_ = true;
+        answered = true;
+        break;
+      }
+      boost::string_view version = requestLine.substr(targetEnd + 1);
+      if ( version != "HTTP/1.1" && version != "HTTP/1.0" )
+      {
+        appendResponse(connection.out_, errorResponse(505), false);
+        connection.closing_ = true;
+        answered = true;
+        break;
+      }
+
+      bool keepAlive = version == "HTTP/1.1";
+      size_t contentLength = 0;
+      boost::string_view authorization;
+      int refusal = 0;
+      while ( ! headers.empty() )
+      {
+        lineEnd = headers.find(LINE_END);
+        boost::string_view header = headers.substr(0, lineEnd);
+        headers.remove_prefix(lineEnd + LINE_END.size());
+
+        size_t colon = header.find(':');
+        if ( colon == boost::string_view::npos )
+        {
+          continue;
+        }
+        std::string name = lowerCase(trim(header.substr(0, colon)));
+        boost::string_view value = trim(header.substr(colon + 1));
+        if ( name == "content-length" )
+        {
+          contentLength = 0;
+          for (char digit : value)
+          {
+            if ( digit < '0' || digit > '9' || contentLength > MAX_BODY_BYTES )
+            {
+              refusal = digit < '0' || digit > '9' ? 400 : 413;
+              break;
+            }
+            contentLength = contentLength * 10 + (digit - '0');
+          }
+          if ( contentLength > MAX_BODY_BYTES )
+          {
+            refusal = 413;
+          }
+        }
+        else if ( name == "connection" )
+        {
+          std::string tokens = lowerCase(value);
+          if ( tokens.find("close") != std::string::npos )
+          {
+            keepAlive = false;
+          }
+          else if ( tokens.find("keep-alive") != std::string::npos )
+          {
+            keepAlive = true;
+          }
+        }
+        else if ( name == "transfer-encoding" )
+        {
+          refusal = 501;
+        }
+        else if ( name == "authorization" )
+        {
+          authorization = value;
+        }
+      }
+      if ( refusal )
+      {
+        appendResponse(connection.out_, errorResponse(refusal), false);
+        connection.closing_ = true;
+        answered = true;
+        break;
+      }
+
+      size_t requestSize = headerEnd + HEADER_END.size() + contentLength;
+      if ( buffer.size() < requestSize )
+      {
+        break; // the body is still on its way
+      }
+
+      HttpRequest request;
+      request.method_ = std::string(requestLine.data(), methodEnd);
+      boost::string_view target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+      size_t queryStart = target.find('?');
+      request.path_ = percentDecode(target.substr(0, queryStart));
+      if ( queryStart != boost::string_view::npos )
+      {
+        parseQuery(target.substr(queryStart + 1), request.query_);
+      }
+      request.authorization_ = std::string(authorization);
+      request.body_ = std::string(buffer.data() + headerEnd + HEADER_END.size(), contentLength);
+
+      HttpResponse response;
+      try
+      {
+        response = handler(request);
+      }
+      catch (std::exception&)
+      {
+        response = errorResponse(500);
+      }
+      appendResponse(connection.out_, response, keepAlive);
+      consumed += requestSize;
+      answered = true;
+      connection.closing_ = ! keepAlive;
+    }
+
+    connection.in_.erase(0, consumed);
+    return answered;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool HttpServer::send(int fd, Connection& connection)
+  {
+    while ( connection.sent_ < connection.out_.size() )
+    {
+      ssize_t sent = ::send(fd, connection.out_.data() + connection.sent_, connection.out_.size() - connection.sent_,
+                            MSG_NOSIGNAL);
+      if ( sent < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      }
+      connection.sent_ += sent;
+    }
+
+    connection.out_.clear();
+    connection.sent_ = 0;
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HttpServer::closeConnection(int fd)
+  {
+    ::epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,127 @@
+#ifndef HTTPSERVER_HPP
+#define HTTPSERVER_HPP
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace basic
+{
+//**********************************************************************************************************************
+  /** Exception type raised when the HTTP server can't be set up
+   */
+  class HttpServerError : public std::runtime_error
+  {
+  public: // interface
+    HttpServerError(const std::string& whatMessage) : std::runtime_error(whatMessage) {}
+
+    virtual ~HttpServerError() throw() {} // required by runtime_error inheritance
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** A parsed request, the query string is split and percent decoded, a parameter given twice keeps its last value
+   */
+  struct HttpRequest
+  {
+    std::string method_;
+    std::string path_;
+    std::map<std::string, std::string> query_;
+    std::string authorization_; // the Authorization header, empty if there is none
+    std::string body_;
+
+  }; // struct
+
+  struct HttpResponse
+  {
+    int status_;
+    std::string contentType_; // no Content-Type header if empty
+    std::string body_;
+
+  }; // struct
+
+//**********************************************************************************************************************
+  /** HTTP/1.1 server on the loopback interface, every connection driven from a single epoll loop
+   *
+   * Connections are kept alive unless the client asks otherwise (or speaks HTTP/1.0 without asking for it), and
+   * requests pipelined on a connection are answered in order as soon as each is complete, so a client that sends many
+   * requests before reading gets every response without waiting a round trip for each. The handler runs on the loop
+   * thread, one request at a time, which is what lets it use the store without locking. Chunked request bodies aren't
+   * supported; the admin API sends its parameters in the query string.
+   */
+  class HttpServer
+  {
+  public: // types
+    typedef std::function<HttpResponse(const HttpRequest&)> Handler;
+
+  public: // interface
+    /** Bind and listen on 127.0.0.1
+     *
+     * @param port: zero picks any free port, see port().
+     * @throws HttpServerError: if the port is in use or the socket can't be created.
+     */
+    HttpServer(uint16_t port);
+
+    /** Closes the listening socket and every open connection */
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    uint16_t port() const { return port_; }
+
+    /** Have the loop call onReadable whenever the descriptor is readable, for serving other sockets alongside */
+    void watch(int fd, const std::function<void()>& onReadable);
+
+    /** Serve requests until SIGINT or SIGTERM is received */
+    void run(const Handler& handler);
+
+    /** Reason phrase for a status code */
+    static const char* reason(int status);
+
+  private: // types
+    struct Connection
+    {
+      std::string in_;          // received and not yet parsed
+      std::string out_;         // responses not yet sent
+      size_t sent_ = 0;         // of out_
+      bool closing_ = false;    // close once out_ is sent, nothing more is read or answered
+      bool peerClosed_ = false; // the client has shut down its side, what it sent is still answered
+      uint32_t events_ = 0;     // registered with epoll
+
+    }; // struct
+
+  private: // methods
+    void acceptConnections();
+
+    /** Read what has arrived, answer every complete request and send what can be sent */
+    void serviceConnection(int fd, Connection& connection, bool readable, const Handler& handler);
+
+    /** Read everything available, @returns false if the connection failed */
+    bool receive(int fd, Connection& connection);
+
+    /** Answer the complete requests received so far, in order, @returns true if any was answered */
+    bool answerRequests(Connection& connection, const Handler& handler);
+
+    /** Send as much output as the socket takes, @returns false if the connection failed */
+    bool send(int fd, Connection& connection);
+
+    void closeConnection(int fd);
+
+  private: // data
+    int listener_;
+    int epoll_;
+    uint16_t port_;
+    std::map<int, Connection> connections_;
+    std::map<int, std::function<void()>> watched_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // HTTPSERVER_HPP
@@ -1,8 +1,12 @@
 #ifndef INFO_HPP
 #define INFO_HPP
 
+#include "Formatter.hpp"
+
 #include "oberon/Subcommand.hpp"
 #include "oberon/OptionCollection.hpp"
+#include "oberon/Utils.hpp"
+#include "userstore/Uuid.hpp"
 
 namespace basic
 {
@@ -10,12 +14,14 @@ namespace basic
   {
   public: // interface
     Info(oberon::OptionCollection sharedOptions) :
-      oberon::Subcommand("info", "list user with uuid from the provided string", sharedOptions)
+      oberon::Subcommand("info", "show the user with the provided uuid, email or display name, or every user if none is "
+                                 "given", sharedOptions)
     {
       /** **/
     }
 
-    boost::program_options::options_description uniqueOptions(bool includeHidden, bool enableRestrictions) const
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
     {
       boost::program_options::options_description returnOptions;
       returnOptions.add_options()
@@ -24,7 +30,7 @@ namespace basic
       return returnOptions;
     }
 
-    boost::program_options::positional_options_description positionalOptions() const
+    boost::program_options::positional_options_description positionalOptions() const override
     {
       boost::program_options::positional_options_description positional;
       //positional.add("targetString", 1);
@@ -32,9 +38,32 @@ namespace basic
       return positional;
     }
 
-    /** This is a new addition yet to be implemented
-     */
-  //  void checkOptionConsistency(boost::program_options::variables_map vm) const;
+    void checkOptionConsistency(const boost::program_options::variables_map& vm) const override
+    {
+      if ( vm.count("uuid-String") + vm.count("email") + vm.count("display-name") > 1 )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'info' looks users up by one of uuid, --email or "
+                                              "--display-name.",
+                                              name());
+      }
+      if ( vm.count("uuid-String") && userstore::isMalformedUuid(vm["uuid-String"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Malformed uuid '" + vm["uuid-String"].as<std::string>() + "'.", name());
+      }
+      if ( vm.count("format") && ! Formatter::isFormat(vm["format"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Unknown format '" + vm["format"].as<std::string>() + "', use plain, json "
+                                              "or xml.", name());
+      }
+      if ( vm.count("endpoint") && ! vm.count("uuid-String") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'info' looks users up on an --endpoint by uuid only.", name());
+      }
+      if ( vm.count("timeout") && ! vm.count("endpoint") )
+      {
+        throw oberon::CommandLineParsingError("Subcommand 'info' takes --timeout only with --endpoint.", name());
+      }
+    }
 
   }; // class
 
@@ -0,0 +1,52 @@
+#ifndef LIST_HPP
+#define LIST_HPP
+
+#include "Formatter.hpp"
+
+#include "oberon/Subcommand.hpp"
+#include "oberon/OptionCollection.hpp"
+#include "oberon/Utils.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace basic
+{
+  class List : public oberon::Subcommand
+  {
+  public: // interface
+    List(oberon::OptionCollection sharedOptions) :
+      oberon::Subcommand("list", "list user uuids in creation order, a page at a time with --max-entries and --marker",
+                         sharedOptions)
+    {
+      /** **/
+    }
+
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
+    {
+      boost::program_options::options_description returnOptions;
+      returnOptions.add_options()
+        ("max-entries", getOptionValue<uint64_t>(), "List at most this many users")
+        ("marker", getOptionValue<std::string>(), "Resume the listing after the user with this uuid, the last one "
+                                                  "listed by the previous page");
+
+      return returnOptions;
+    }
+
+    void checkOptionConsistency(const boost::program_options::variables_map& vm) const override
+    {
+      if ( vm.count("format") && ! Formatter::isFormat(vm["format"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Unknown format '" + vm["format"].as<std::string>() + "', use plain, json "
+                                              "or xml.", name());
+      }
+    }
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // LIST_HPP
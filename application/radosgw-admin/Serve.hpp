@@ -0,0 +1,41 @@
+#ifndef SERVE_HPP
+#define SERVE_HPP
+
+#include "oberon/Subcommand.hpp"
+#include "oberon/OptionCollection.hpp"
+
+namespace basic
+{
+  class Serve : public oberon::Subcommand
+  {
+  public: // interface
+    Serve(oberon::OptionCollection sharedOptions) :
+      oberon::Subcommand("serve", "keep the user store open and run commands sent by other invocations over a unix "
+                                  "socket, and with --http the RGW admin ops user API, until interrupted", sharedOptions)
+    {
+      /** **/
+    }
+
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
+    {
+      boost::program_options::options_description returnOptions;
+      returnOptions.add_options()
+        ("socket", getOptionValue<std::string>(), "Path of the unix socket to listen on, defaults to admin.sock in the "
+                                                  "store directory")
+        ("http", getOptionValue<uint16_t>(), "Also serve GET, PUT and DELETE /admin/user on this port of 127.0.0.1, "
+                                             "keep-alive and pipelined. Any local user can connect, so PUT and "
+                                             "DELETE are refused unless sent with Authorization: Bearer and the "
+                                             "token the daemon writes to admin.token in the store directory, "
+                                             "readable by its owner alone. GET needs no token and shows any user");
+
+      return returnOptions;
+    }
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // SERVE_HPP
@@ -0,0 +1,70 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "Formatter.hpp"
+
+#include "oberon/Subcommand.hpp"
+#include "oberon/OptionCollection.hpp"
+#include "oberon/Utils.hpp"
+#include "userstore/Uuid.hpp"
+
+#include <cstdint>
+
+namespace basic
+{
+  class Stats : public oberon::Subcommand
+  {
+  public: // interface
+    Stats(oberon::OptionCollection sharedOptions) :
+      oberon::Subcommand("stats", "show the usage counters (objects, bytes, ops) of the user with the provided uuid, or "
+                                  "of every user added up if none is given, or record usage with --add-objects and "
+                                  "--add-bytes", sharedOptions)
+    {
+      /** **/
+    }
+
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
+    {
+      boost::program_options::options_description returnOptions;
+      returnOptions.add_options()
+        ("add-objects", getOptionValue<int64_t>(), "Record a change of this many objects for the user, one op, "
+                                                  "negative values as --add-objects=-N")
+        ("add-bytes", getOptionValue<int64_t>(), "Record a change of this many bytes for the user, one op")
+        ("sync", "Write usage changes still held in memory to the store before showing the counters");
+
+      return returnOptions;
+    }
+
+    boost::program_options::positional_options_description positionalOptions() const override
+    {
+      boost::program_options::positional_options_description positional;
+      positional.add("uuid-String", 1);
+      return positional;
+    }
+
+    void checkOptionConsistency(const boost::program_options::variables_map& vm) const override
+    {
+      if ( (vm.count("add-objects") || vm.count("add-bytes")) && ! vm.count("uuid-String") )
+      {
+        throw oberon::CommandLineParsingError("Usage is recorded for a user, --add-objects and --add-bytes need a "
+                                              "uuid.", name());
+      }
+      if ( vm.count("uuid-String") && userstore::isMalformedUuid(vm["uuid-String"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Malformed uuid '" + vm["uuid-String"].as<std::string>() + "'.", name());
+      }
+      if ( vm.count("format") && ! Formatter::isFormat(vm["format"].as<std::string>()) )
+      {
+        throw oberon::CommandLineParsingError("Unknown format '" + vm["format"].as<std::string>() + "', use plain, json "
+                                              "or xml.", name());
+      }
+    }
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // STATS_HPP
@@ -0,0 +1,60 @@
+#ifndef STORE_HPP
+#define STORE_HPP
+
+#include "oberon/Subcommand.hpp"
+#include "oberon/OptionCollection.hpp"
+#include "oberon/Utils.hpp"
+
+#include <string>
+
+namespace basic
+{
+  class Store : public oberon::Subcommand
+  {
+  public: // interface
+    Store(oberon::OptionCollection sharedOptions) :
+      oberon::Subcommand("store", "maintain the user store itself: init --shards N makes a store split into N shards, "
+                                  "compact drops deleted users' records while readers carry on", sharedOptions)
+    {
+      /** **/
+    }
+
+    boost::program_options::options_description uniqueOptions(bool includeHidden,
+                                                              bool enableRestrictions) const override
+    {
+      boost::program_options::options_description returnOptions;
+      returnOptions.add_options()
+        ("action", getOptionValue<std::string>(enableRestrictions), "What to do to the store: init or compact")
+        ("shards", getOptionValue<unsigned>(), "Number of shards for init, writers to users in different shards "
+                                              "don't wait for each other");
+
+      return returnOptions;
+    }
+
+    boost::program_options::positional_options_description positionalOptions() const override
+    {
+      boost::program_options::positional_options_description positional;
+      positional.add("action", 1);
+      return positional;
+    }
+
+    void checkOptionConsistency(const boost::program_options::variables_map& vm) const override
+    {
+      std::string action = vm.count("action") ? vm["action"].as<std::string>() : "";
+      if ( action != "init" && action != "compact" )
+      {
+        throw oberon::CommandLineParsingError("Unknown store action '" + action + "'.", name());
+      }
+      if ( (action == "init") != (vm.count("shards") > 0) )
+      {
+        throw oberon::CommandLineParsingError("Option --shards goes with, and only with, store init.", name());
+      }
+    }
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // STORE_HPP
@@ -1,6 +1,13 @@
 #include "Delete.hpp"
 #include "Create.hpp"
 #include "Info.hpp"
+#include "List.hpp"
+#include "Serve.hpp"
+#include "Stats.hpp"
+#include "Store.hpp"
+#include "AdminSocket.hpp"
+#include "CommandRunner.hpp"
+#include "Formatter.hpp"
 
 #include "oberon/Subcommand.hpp"
 #include "oberon/SubcommandCollection.hpp"
@@ -9,109 +16,186 @@
 
 #include "boost/program_options.hpp"
 #include "boost/algorithm/string.hpp"
+#include "boost/filesystem.hpp"
 
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
 
 namespace
 {
   namespace po = boost::program_options;
 
-  const int SUCCESS = 0;
-  const int FAILURE = 1;
-
   const std::string APPLICATION_USAGE = "Application that is alternative to radosgw-admin";
 
-} // namespace
+  const char* const SOCKET_ENVIRONMENT_VARIABLE = "RADOSGW_ADMIN_SOCKET";
 
+  std::string absolutePath(const std::string& path)
+  {
+    return path.empty() || path == "-" ? path : boost::filesystem::absolute(path).string();
+  }
 
-int main(int argc, char** argv)
-{
-  oberon::OptionCollection sharedOptions;
-  sharedOptions.addArgOption<std::string>("uuid-String", "String for the uuid of the user", true);
-
-  oberon::SubcommandCollection subcommands;
-  subcommands.add( "delete",    [=]() { return std::unique_ptr<basic::Delete>( new basic::Delete(sharedOptions) ); } );
-  subcommands.add( "create", [=]() { return std::unique_ptr<basic::Create>( new basic::Create(sharedOptions) ); } );
-  subcommands.add( "info", [=]() { return std::unique_ptr<basic::Info>( new basic::Info(sharedOptions) ); } );
-  subcommands.finaliseRegistrations();
-
-  /** Application level options are being added now as well, just an ultra basic version option
+  /** Make the path given to the option by the argument at the position absolute, stepping over it if it is the next one
+   *
+   * @returns the path, empty if the argument doesn't give the option a path.
    */
-  po::options_description mainDesc;
-  mainDesc.add_options()
-      ("version", "Display the version information for the application");
-
-  oberon::SubcommandCLI subcommandApp = oberon::SubcommandCLI("radosgw-admin",
-                                                              APPLICATION_USAGE,
-                                                              subcommands,
-                                                              mainDesc); // pass the app level options
- 
-  std::vector<std::string> v;
-  try
+  std::string makeAbsolute(std::vector<std::string>& arguments, size_t& argument, const std::string& option)
   {
-    oberon::SubcommandCLI::ParseOutput parseOutput = subcommandApp.parseCommandLine(argc, argv);
-    po::variables_map parsedVars = parseOutput.vm();
-
-    if ( boost::optional<std::string> subcommandNameOptional = parseOutput.subcommandUsed() )
+    std::string& value = arguments[argument];
+    if ( value == option && argument + 1 < arguments.size() )
     {
-      std::string subcommandName = subcommandNameOptional.get();
+      std::string& path = arguments[++argument];
+      path = absolutePath(path);
+      return path;
+    }
+    if ( value.compare(0, option.size() + 1, option + "=") == 0 )
+    {
+      std::string path = absolutePath(value.substr(option.size() + 1));
+      value = option + "=" + path;
+      return path;
+    }
+    return std::string();
+  }
 
-      if ( subcommandName == "create" ) // processing for the user create subcommand
+  /** Hand the command line to a daemon serving the same store if there is one, before any option setup is paid for
+   *
+   * The store is found with a plain scan for --store rather than a parse, if that guesses wrong the daemon sees the
+   * parsed options and declines. The daemon doesn't share the client's working directory, so the paths given to
+   * --store and --from-file are made absolute before the command line is sent, and the daemon declines any still
+   * relative. serve itself, anything reading stdin, including batches, and anything sent to an --endpoint always run
+   * here.
+   */
+  boost::optional<int> forwardIfServed(int argc, char** argv)
+  {
+    for (int argument = 1; argument < argc; ++argument)
+    {
+      if ( std::strcmp(argv[argument], "serve") == 0
+           || std::strcmp(argv[argument], "-") == 0
+           || std::strcmp(argv[argument], "--batch") == 0
+           || std::strncmp(argv[argument], "--endpoint", 10) == 0 )
       {
-        std::string u_str = parsedVars["uuid-String"].as<std::string>();
-
-	v.push_back(u_str);
-
-	std::cout << "User with uuid " << u_str << " created" << std::endl;
+        return boost::none;
       }
-      else if ( subcommandName == "delete" ) // processing for the user delete subcommand
-      {
-        std::string u_str = parsedVars["uuid-String"].as<std::string>();
-	
-	auto itr = std::find(v.begin(), v.end(), u_str);
-	if (itr != v.end()) 
-		v.erase(itr);
+    }
 
-	std::cout << "User with uuid " << u_str << " deleted" << std::endl;
-      }
-      else if ( subcommandName == "info" ) // processing for the user info subcommand
-      {
-	for (auto i = v.begin(); i != v.end(); ++i)
-    	std::cout << *i << ' ';
-      }	
-      else if ( subcommandName == "help" )
+    basic::AdminRequest request;
+    request.defaultStore_ = absolutePath(basic::CommandRunner::environmentStore());
+    request.arguments_.assign(argv + 1, argv + argc);
+
+    std::string store = request.defaultStore_;
+    for (size_t argument = 0; argument < request.arguments_.size(); ++argument)
+    {
+      std::string path = makeAbsolute(request.arguments_, argument, "--store");
+      if ( ! path.empty() )
       {
-        subcommandApp.displayHelp(parsedVars.count("topic") ?
-                                     parsedVars["topic"].as< std::vector<std::string> >() :
-                                        std::vector<std::string>(),
-                                  std::cout);
+        store = path;
       }
       else
       {
-        assert(false && "Unrecognised subcommand used and it somehow got through parsing");
+        makeAbsolute(request.arguments_, argument, "--from-file");
       }
     }
-    else
+
+    const char* socketFromEnvironment = std::getenv(SOCKET_ENVIRONMENT_VARIABLE);
+    std::string socketPath = socketFromEnvironment ? socketFromEnvironment : basic::CommandRunner::defaultSocketPath(store);
+    if ( ::access(socketPath.c_str(), F_OK) != 0 )
     {
-      if ( parsedVars.count("version") ) // act on the version option
-      {
-        std::cout << "Application Version: 0.1.0 - demo" << std::endl;
-      }
-      else
-      {
-        subcommandApp.displayHelp(boost::none, std::cout);
-      }
+      return boost::none; // no daemon, skip even trying to connect
     }
+    return basic::forwardToDaemon(socketPath, request);
+  }
 
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+  /** Commands write with '\n' rather than endl, so a batch's output goes out in full buffers rather than per line */
+  std::ios_base::sync_with_stdio(false);
+
+  try
+  {
+    if ( boost::optional<int> status = forwardIfServed(argc, argv) )
+    {
+      return status.get();
+    }
   }
-  catch(oberon::CommandLineParsingError& e)
+  catch(basic::AdminSocketError& e)
   {
-    subcommandApp.displayParsingError(e, std::cout, std::cerr);
-    return FAILURE;
-
+    /** Not safe to fall back to running locally, the daemon may have run the command before failing */
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return basic::CommandRunner::FAILURE;
   }
 
-  return SUCCESS;
+  oberon::OptionCollection sharedOptions;
+  sharedOptions.addArgOption<std::string>("uuid-String", "String for the uuid of the user");
+  sharedOptions.addArgOption<std::string>("store", "Directory holding the persistent user store");
+  sharedOptions.addArgOption<uint32_t>("commit-records", "Commit the store log every this many mutations, 0 for no limit");
+  sharedOptions.addArgOption<uint64_t>("commit-us", "Commit the store log once a mutation has waited this many microseconds");
+  sharedOptions.addArgOption<std::string>("display-name", "Display name of the user", false, 'd');
+  sharedOptions.addArgOption<std::string>("email", "Email address of the user, unique among users", false, 'e');
+  sharedOptions.addArgOption<std::string>("from-file", "Read users from a file, one per line as uuid[<tab>display name"
+                                                       "[<tab>email]], - reads stdin");
+  sharedOptions.addArgOption<std::string>("format", "Output format: plain (the default), json or xml");
+  sharedOptions.addArgOption<std::string>("endpoint", "Run against this RGW admin ops endpoint, http://host[:port], "
+                                                      "rather than a store");
+  sharedOptions.addArgOption<unsigned>("connections", "Persistent connections to keep to the --endpoint (default 4)");
+  sharedOptions.addArgOption<unsigned>("window", "Calls to keep in flight to the --endpoint, pipelined over the "
+                                                 "connections (default 64)");
+  sharedOptions.addArgOption<unsigned>("timeout", "Seconds to wait for the --endpoint to accept a connection and to "
+                                                  "answer each call (default 30)");
+  sharedOptions.addArgOption<std::string>("token-file", "File holding the token to authorise changes made through the "
+                                                        "--endpoint with, such as the admin.token of a serve --http");
+
+  /** create reports with a fixed message, so it doesn't get --format */
+  oberon::OptionCollection createOptions = sharedOptions.getSubsetOfOptions({ "uuid-String", "store", "commit-records",
+                                                                             "commit-us", "display-name", "email",
+                                                                             "from-file", "endpoint", "connections",
+                                                                             "window", "timeout", "token-file" });
+  /** info only reads, so it doesn't get the options that control mutations */
+  oberon::OptionCollection readOptions = sharedOptions.getSubsetOfOptions({ "uuid-String", "store", "display-name",
+                                                                           "email", "format", "endpoint",
+                                                                           "timeout" });
+  oberon::OptionCollection deleteOptions = sharedOptions.getSubsetOfOptions({ "uuid-String", "store", "commit-records",
+                                                                             "commit-us", "from-file", "endpoint",
+                                                                             "connections", "window", "timeout",
+                                                                             "token-file" });
+  oberon::OptionCollection listOptions = sharedOptions.getSubsetOfOptions({ "store", "format" });
+  oberon::OptionCollection statsOptions = sharedOptions.getSubsetOfOptions({ "uuid-String", "store", "format" });
+  oberon::OptionCollection serveOptions = sharedOptions.getSubsetOfOptions({ "store", "commit-records", "commit-us" });
+  oberon::OptionCollection storeOptions = sharedOptions.getSubsetOfOptions({ "store" });
+
+  /** The subcommands are fixed, so they are built once into a table rather than registered as creators */
+  oberon::SubcommandCollection subcommands;
+  subcommands.add( oberon::makeSubcommandTable(basic::Delete(deleteOptions),
+                                               basic::Create(createOptions),
+                                               basic::Info(readOptions),
+                                               basic::List(listOptions),
+                                               basic::Stats(statsOptions),
+                                               basic::Serve(serveOptions),
+                                               basic::Store(storeOptions)) );
+  subcommands.finaliseRegistrations();
+
+  /** Application level options are being added now as well, just an ultra basic version option
+   */
+  po::options_description mainDesc;
+  mainDesc.add_options()
+      ("version", "Display the version information for the application")
+      ("batch", "Run command lines read from stdin, one per line, in this process");
+
+  oberon::SubcommandCLI subcommandApp = oberon::SubcommandCLI("radosgw-admin",
+                                                              APPLICATION_USAGE,
+                                                              subcommands,
+                                                              mainDesc); // pass the app level options
+ 
+  /** Output goes to the descriptor in whole buffers, large writes straight from the formatter without a copy */
+  basic::DescriptorBuffer standardOutput(STDOUT_FILENO);
+  std::ostream out(&standardOutput);
+
+  basic::CommandRunner runner(subcommandApp);
+  return runner.run(argc, argv, out, std::cerr);
 
 } // main
 
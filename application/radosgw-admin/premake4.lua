@@ -9,7 +9,7 @@ project "radosgw-admin"
   libdirs { "../../boost/stage/lib" }
   includedirs { "../../boost", "../../" }
 
-  links { "oberon" }
+  links { "userstore", "oberon" }
 
   targetdir( "../../builds/bin")
 
@@ -0,0 +1,948 @@
+#include "userstore/IoQueue.hpp"
+#include "userstore/UserStore.hpp"
+#include "userstore/Utils.hpp"
+#include "userstore/WorkStealingPool.hpp"
+
+#include "boost/filesystem.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+  /** Every operator new in the process, counted by the replacements below for the memory benchmark */
+  std::atomic<uint64_t> allocations(0);
+
+} // namespace
+
+//----------------------------------------------------------------------------------------------------------------------
+/** Both are kept out of line, where GCC would see through them to malloc() and free() and take every delete for a
+ *  mismatch */
+void* operator new(size_t size) __attribute__((noinline));
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if ( void* memory = std::malloc(size ? size : 1) )
+  {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+void operator delete(void* memory) noexcept __attribute__((noinline));
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+namespace
+{
+  const int SUCCESS = 0;
+  const int FAILURE = 1;
+
+  typedef std::chrono::steady_clock Clock;
+  typedef std::function<int(const std::vector<std::string>&)> Benchmark;
+
+  const uint64_t DEFAULT_MAX_USERS = 10 * 1000 * 1000;
+  const uint64_t TIMED_OPERATIONS = 100 * 1000;
+  const uint64_t DEFAULT_MUTATIONS = 20 * 1000;
+  const uint64_t DEFAULT_IMPORT_USERS = 2 * 1000 * 1000;
+  const uint64_t IMPORT_BLOCK_USERS = 8192;
+  const unsigned MAX_IMPORT_THREADS = 64;
+  const uint64_t DEFAULT_MEMORY_USERS = 10 * 1000 * 1000;
+  const uint64_t DEFAULT_CONTENDED_CREATES = 200;
+  const unsigned DEFAULT_WRITER_PROCESSES = 8;
+  const uint64_t DEFAULT_USAGE_USERS = 1000 * 1000;
+  const uint64_t DEFAULT_IO_FILE_MB = 256;
+  const size_t IO_BLOCK_SIZE = 4096;
+  const unsigned IO_BATCH_SIZES[] = { 1, 32 };
+  const uint64_t IO_READS = 32 * 1024;
+  const uint64_t IO_APPENDS = 2000;
+  const uint64_t DEFAULT_HTTP_USERS = 20 * 1000;
+  const unsigned DEFAULT_HTTP_CONNECTIONS = 4;
+  const unsigned DEFAULT_HTTP_DEPTH = 16;
+
+  /** Canonical 36 character form, so record sizes match what the application stores */
+  std::string makeUuid(uint64_t value)
+  {
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "%08x-%04x-%04x-%04x-%012llx",
+                  static_cast<unsigned>(value >> 32), static_cast<unsigned>((value >> 16) & 0xFFFF),
+                  static_cast<unsigned>(value & 0xFFFF), 0x8000u,
+                  static_cast<unsigned long long>(value & 0xFFFFFFFFFFFFULL));
+    return buffer;
+  }
+
+  double nanosecondsPer(Clock::duration elapsed, uint64_t operations)
+  {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+  }
+
+  /** Scratch store directory under the system temp directory, removed on destruction */
+  class ScratchDirectory
+  {
+  public: // interface
+    ScratchDirectory() :
+      path_( (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("userstore-bench-%%%%%%%%")).string() )
+    {
+      /** **/
+    }
+
+    ~ScratchDirectory()
+    {
+      boost::system::error_code ignored;
+      boost::filesystem::remove_all(path_, ignored);
+    }
+
+    const std::string& path() const { return path_; }
+
+  private: // data
+    std::string path_;
+
+  }; // class
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Latency of uuid lookups and deletes as the store grows, these should stay flat with the hash index
+   *
+   * args: [max-users], sizes run in decades from 1000 up to and including max-users.
+   */
+  int lookupBenchmark(const std::vector<std::string>& args)
+  {
+    uint64_t maxUsers = args.empty() ? DEFAULT_MAX_USERS : std::stoull(args[0]);
+
+    std::printf("%12s %14s %14s %14s %14s\n", "users", "insert ns/op", "hit ns/op", "miss ns/op", "delete ns/op");
+    for (uint64_t users = 1000; users <= maxUsers; users *= 10)
+    {
+      /** Commits are left to the final sync so the timings are of the index and not of fsync */
+      ScratchDirectory directory;
+      userstore::UserStore store(directory.path(),
+                                 userstore::UserStore::OpenMode::ReadWrite,
+                                 userstore::WriteAheadLog::CommitWindow(0, 0));
+
+      Clock::time_point start = Clock::now();
+      for (uint64_t user = 0; user < users; ++user)
+      {
+        store.insert(makeUuid(user));
+      }
+      Clock::duration insertTime = Clock::now() - start;
+
+      /** Uuids are generated up front so formatting them isn't part of the timings */
+      std::mt19937_64 random(users);
+      std::vector<std::string> hits, misses;
+      for (uint64_t operation = 0; operation < TIMED_OPERATIONS; ++operation)
+      {
+        hits.push_back(makeUuid(random() % users));
+        misses.push_back(makeUuid(users + random() % users));
+      }
+
+      uint64_t found = 0;
+      start = Clock::now();
+      for (const std::string& uuid : hits)
+      {
+        found += store.contains(uuid);
+      }
+      Clock::duration hitTime = Clock::now() - start;
+
+      start = Clock::now();
+      for (const std::string& uuid : misses)
+      {
+        found += store.contains(uuid);
+      }
+      Clock::duration missTime = Clock::now() - start;
+
+      uint64_t deletes = std::min<uint64_t>(users, TIMED_OPERATIONS);
+      start = Clock::now();
+      for (uint64_t user = 0; user < deletes; ++user)
+      {
+        store.remove(makeUuid(user));
+      }
+      Clock::duration deleteTime = Clock::now() - start;
+
+      if ( found != TIMED_OPERATIONS )
+      {
+        std::cerr << "ERROR: expected " << TIMED_OPERATIONS << " lookups to succeed, " << found << " did" << std::endl;
+        return FAILURE;
+      }
+
+      std::printf("%12llu %14.1f %14.1f %14.1f %14.1f\n", static_cast<unsigned long long>(users),
+                  nanosecondsPer(insertTime, users), nanosecondsPer(hitTime, TIMED_OPERATIONS),
+                  nanosecondsPer(missTime, TIMED_OPERATIONS), nanosecondsPer(deleteTime, deletes));
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Mutation throughput through the write ahead log for a range of commit windows
+   *
+   * args: [mutations], each window runs that many creates followed by as many deletes on a fresh store. The final
+   * sync() is included so every run ends with everything durable.
+   */
+  int commitBenchmark(const std::vector<std::string>& args)
+  {
+    uint64_t mutations = args.empty() ? DEFAULT_MUTATIONS : std::stoull(args[0]);
+
+    const std::vector<userstore::WriteAheadLog::CommitWindow> windows =
+    {
+      {1, 0}, {8, 0}, {64, 0}, {512, 0}, {4096, 0}, {0, 100}, {0, 1000}, {0, 10000}
+    };
+
+    std::printf("%10s %10s %16s\n", "records", "us", "mutations/s");
+    for (const userstore::WriteAheadLog::CommitWindow& window : windows)
+    {
+      ScratchDirectory directory;
+      userstore::UserStore store(directory.path(), userstore::UserStore::OpenMode::ReadWrite, window);
+
+      Clock::time_point start = Clock::now();
+      for (uint64_t user = 0; user < mutations; ++user)
+      {
+        store.insert(makeUuid(user));
+      }
+      for (uint64_t user = 0; user < mutations; ++user)
+      {
+        store.remove(makeUuid(user));
+      }
+      store.sync();
+      Clock::duration elapsed = Clock::now() - start;
+
+      std::printf("%10u %10llu %16.0f\n", window.records_, static_cast<unsigned long long>(window.microseconds_),
+                  2 * mutations / std::chrono::duration<double>(elapsed).count());
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Split a block of bulk input lines (uuid<tab>display name<tab>email) and hand each user's fields to the consumer */
+  template <typename T_Consumer>
+  void forEachImportLine(const std::string& lines, const T_Consumer& consume)
+  {
+    boost::string_view remaining(lines);
+    while ( ! remaining.empty() )
+    {
+      size_t newline = remaining.find('\n');
+      boost::string_view line = remaining.substr(0, newline);
+      remaining.remove_prefix(newline == boost::string_view::npos ? remaining.size() : newline + 1);
+
+      size_t nameStart = line.find('\t') + 1;
+      size_t emailStart = line.find('\t', nameStart) + 1;
+      consume(line.substr(0, nameStart - 1), line.substr(nameStart, emailStart - nameStart - 1), line.substr(emailStart));
+    }
+  }
+
+  /** Bulk import throughput as the staging (parse, validate, hash, encode, checksum) is spread over more threads
+   *
+   * args: [users], each thread count imports that many users into a fresh store committing every 4096 users, merging
+   * staged blocks in input order on the main thread as radosgw-admin create --from-file --threads does. The single
+   * threaded row without a pool is plain insert() calls, for comparison.
+   */
+  int importBenchmark(const std::vector<std::string>& args)
+  {
+    uint64_t users = args.empty() ? DEFAULT_IMPORT_USERS : std::stoull(args[0]);
+
+    std::vector<std::string> blocks((users + IMPORT_BLOCK_USERS - 1) / IMPORT_BLOCK_USERS);
+    for (uint64_t user = 0; user < users; ++user)
+    {
+      std::string& block = blocks[user / IMPORT_BLOCK_USERS];
+      block += makeUuid(user);
+      block += "\tUser Number " + std::to_string(user) + "\tuser" + std::to_string(user) + "@example.com\n";
+    }
+
+    std::printf("%8s %14s %10s\n", "threads", "users/s", "speedup");
+    double baseline = 0;
+    for (unsigned threads = 0; threads <= MAX_IMPORT_THREADS; threads = threads ? threads * 2 : 1)
+    {
+      ScratchDirectory directory;
+      userstore::UserStore store(directory.path(),
+                                 userstore::UserStore::OpenMode::ReadWrite,
+                                 userstore::WriteAheadLog::CommitWindow(4096, 0));
+
+      Clock::time_point start = Clock::now();
+      if ( ! threads )
+      {
+        for (const std::string& block : blocks)
+        {
+          forEachImportLine(block, [&](boost::string_view uuid, boost::string_view displayName, boost::string_view email)
+          {
+            store.insert(uuid, displayName, email);
+          });
+        }
+      }
+      else
+      {
+        std::vector<userstore::StagedUsers> staged(blocks.size());
+        std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[blocks.size()]);
+        std::mutex mutex;
+        std::condition_variable blockStaged;
+
+        userstore::WorkStealingPool pool(threads);
+        for (size_t block = 0; block < blocks.size(); ++block)
+        {
+          ready[block] = false;
+          pool.submit([&, block]()
+          {
+            forEachImportLine(blocks[block],
+                              [&](boost::string_view uuid, boost::string_view displayName, boost::string_view email)
+                              {
+                                staged[block].add(uuid, displayName, email);
+                              });
+            std::lock_guard<std::mutex> lock(mutex);
+            ready[block] = true;
+            blockStaged.notify_all();
+          });
+        }
+
+        for (size_t block = 0; block < blocks.size(); ++block)
+        {
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            blockStaged.wait(lock, [&]() { return ready[block].load(); });
+          }
+          store.insert(staged[block]);
+          staged[block] = userstore::StagedUsers(); // merged blocks needn't hold memory
+        }
+      }
+      store.sync();
+      Clock::duration elapsed = Clock::now() - start;
+
+      if ( store.size() != users )
+      {
+        std::cerr << "ERROR: expected " << users << " users to be imported, " << store.size() << " were" << std::endl;
+        return FAILURE;
+      }
+
+      double rate = users / std::chrono::duration<double>(elapsed).count();
+      baseline = threads ? baseline : rate;
+      std::printf("%8s %14.0f %10.2f\n", threads ? std::to_string(threads).c_str() : "insert", rate, rate / baseline);
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Heap allocations and peak resident memory of a bulk load, which should take a bounded number of allocations
+   *  however many users there are
+   *
+   * args: [max-users], sizes run in decades from 1000 up to and including max-users (default 10M). Each size is loaded
+   * into a fresh store as radosgw-admin create --from-file does it, staging blocks of users into one reused buffer and
+   * committing every 4096 users. Input lines are formatted into a reused buffer too, so they add no allocations. Peak
+   * RSS is for the process so far, it includes the pages of the store files that are mapped.
+   */
+  int memoryBenchmark(const std::vector<std::string>& args)
+  {
+    uint64_t maxUsers = args.empty() ? DEFAULT_MEMORY_USERS : std::stoull(args[0]);
+
+    std::printf("%12s %14s %14s %14s\n", "users", "allocations", "per 1k users", "peak RSS MB");
+    for (uint64_t users = 1000; users <= maxUsers; users *= 10)
+    {
+      ScratchDirectory directory;
+      uint64_t allocationsBefore = allocations.load();
+      {
+        userstore::UserStore store(directory.path(),
+                                   userstore::UserStore::OpenMode::ReadWrite,
+                                   userstore::WriteAheadLog::CommitWindow(4096, 0));
+        userstore::StagedUsers staged;
+        std::string block;
+        char line[128];
+        for (uint64_t first = 0; first < users; first += IMPORT_BLOCK_USERS)
+        {
+          block.clear();
+          for (uint64_t user = first; user < std::min(users, first + IMPORT_BLOCK_USERS); ++user)
+          {
+            int length = std::snprintf(line, sizeof(line), "%08x-%04x-%04x-8000-%012llx\tTeam %llu\tuser%llu@example.com\n",
+                                       static_cast<unsigned>(user >> 32), static_cast<unsigned>((user >> 16) & 0xFFFF),
+                                       static_cast<unsigned>(user & 0xFFFF),
+                                       static_cast<unsigned long long>(user & 0xFFFFFFFFFFFFULL),
+                                       static_cast<unsigned long long>(user % 1000),
+                                       static_cast<unsigned long long>(user));
+            block.append(line, length);
+          }
+
+          staged.clear();
+          forEachImportLine(block, [&](boost::string_view uuid, boost::string_view displayName, boost::string_view email)
+          {
+            staged.add(uuid, displayName, email);
+          });
+          store.insert(staged);
+        }
+        store.sync();
+
+        if ( store.size() != users )
+        {
+          std::cerr << "ERROR: expected " << users << " users to be loaded, " << store.size() << " were" << std::endl;
+          return FAILURE;
+        }
+      }
+      uint64_t made = allocations.load() - allocationsBefore;
+
+      rusage usage;
+      ::getrusage(RUSAGE_SELF, &usage);
+      std::printf("%12llu %14llu %14.3f %14.1f\n", static_cast<unsigned long long>(users),
+                  static_cast<unsigned long long>(made), 1000.0 * made / users, usage.ru_maxrss / 1024.0);
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Creates done as a radosgw-admin create invocation does them, opening the store, inserting one user with its own
+   *  commit and closing it, by one writer process per run
+   *
+   * @param emails: give each user an email of its own, so every create claims one as well.
+   * @returns the exit status of the process.
+   */
+  int runContendedWriter(const std::string& directory, uint64_t firstUser, uint64_t creates, bool emails)
+  {
+    try
+    {
+      for (uint64_t user = firstUser; user < firstUser + creates; ++user)
+      {
+        userstore::UserStore store(directory, userstore::UserStore::OpenMode::ReadWrite);
+        std::string email = emails ? "user" + std::to_string(user) + "@example.com" : std::string();
+        if ( store.insert(makeUuid(user), boost::string_view(), email) != userstore::UserStore::InsertResult::Inserted )
+        {
+          return FAILURE;
+        }
+      }
+    }
+    catch(userstore::StoreError& e)
+    {
+      std::cerr << "ERROR: " << e.what() << std::endl;
+      return FAILURE;
+    }
+    return SUCCESS;
+  }
+
+  /** Throughput of writer processes creating users in one store as the number of shards grows
+   *
+   * args: [max-processes] [creates], for each shard count the process count doubles from 1 to max-processes (default
+   * 8), each process doing that many creates (default 200), first without emails and then with one per user. With one
+   * shard every create waits for the store lock, with more shards writers only wait for those working in the same shard
+   * or, with emails, claiming an email in the same claim shard.
+   */
+  int contentionBenchmark(const std::vector<std::string>& args)
+  {
+    unsigned maxProcesses = args.empty() ? DEFAULT_WRITER_PROCESSES : std::stoul(args[0]);
+    uint64_t creates = args.size() < 2 ? DEFAULT_CONTENDED_CREATES : std::stoull(args[1]);
+
+    std::printf("%8s %8s %10s %14s\n", "emails", "shards", "processes", "creates/s");
+    for (bool emails : { false, true })
+    {
+      for (unsigned shards : { 1u, 4u, 16u })
+      {
+        for (unsigned processes = 1; processes <= maxProcesses; processes *= 2)
+        {
+          ScratchDirectory directory;
+          userstore::UserStore::create(directory.path(), shards);
+
+          Clock::time_point start = Clock::now();
+          std::vector<pid_t> writers;
+          for (unsigned process = 0; process < processes; ++process)
+          {
+            pid_t pid = ::fork();
+            if ( pid == 0 )
+            {
+              std::_Exit(runContendedWriter(directory.path(), process * creates, creates, emails));
+            }
+            if ( pid < 0 )
+            {
+              std::cerr << "ERROR: unable to start a writer process" << std::endl;
+              return FAILURE;
+            }
+            writers.push_back(pid);
+          }
+
+          bool failed = false;
+          for (pid_t writer : writers)
+          {
+            int status = 0;
+            failed = ::waitpid(writer, &status, 0) < 0 || ! WIFEXITED(status) || WEXITSTATUS(status) != SUCCESS || failed;
+          }
+          Clock::duration elapsed = Clock::now() - start;
+
+          if ( failed )
+          {
+            std::cerr << "ERROR: a writer process failed" << std::endl;
+            return FAILURE;
+          }
+
+          std::printf("%8s %8u %10u %14.0f\n", emails ? "yes" : "no", shards, processes,
+                      processes * creates / std::chrono::duration<double>(elapsed).count());
+        }
+      }
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Cost of recording usage and of querying a user's counters and the totals as the store grows, which should all
+   *  stay flat as nothing is rescanned
+   *
+   * args: [max-users], sizes run in decades from 1000 up to and including max-users. Recording is timed with the
+   * changes gathered in memory and the sync that writes them to the usage table timed separately.
+   */
+  int usageBenchmark(const std::vector<std::string>& args)
+  {
+    uint64_t maxUsers = args.empty() ? DEFAULT_USAGE_USERS : std::stoull(args[0]);
+
+    std::printf("%12s %14s %12s %14s %14s\n", "users", "record ns/op", "sync ms", "query ns/op", "totals ns/op");
+    for (uint64_t users = 1000; users <= maxUsers; users *= 10)
+    {
+      ScratchDirectory directory;
+      userstore::UserStore store(directory.path(),
+                                 userstore::UserStore::OpenMode::ReadWrite,
+                                 userstore::WriteAheadLog::CommitWindow(0, 0));
+      for (uint64_t user = 0; user < users; ++user)
+      {
+        store.insert(makeUuid(user));
+      }
+
+      std::mt19937_64 random(users);
+      std::vector<std::string> uuids;
+      for (uint64_t operation = 0; operation < TIMED_OPERATIONS; ++operation)
+      {
+        uuids.push_back(makeUuid(random() % users));
+      }
+
+      userstore::UserUsage delta;
+      delta.objects_ = 1;
+      delta.bytes_ = 4096;
+      delta.ops_ = 1;
+      Clock::time_point start = Clock::now();
+      for (const std::string& uuid : uuids)
+      {
+        store.addUsage(uuid, delta);
+      }
+      Clock::duration recordTime = Clock::now() - start;
+
+      start = Clock::now();
+      store.sync();
+      Clock::duration syncTime = Clock::now() - start;
+
+      uint64_t ops = 0;
+      start = Clock::now();
+      for (const std::string& uuid : uuids)
+      {
+        ops += store.usage(uuid)->ops_;
+      }
+      Clock::duration queryTime = Clock::now() - start;
+
+      start = Clock::now();
+      for (uint64_t operation = 0; operation < TIMED_OPERATIONS; ++operation)
+      {
+        ops += store.totalUsage().ops_;
+      }
+      Clock::duration totalsTime = Clock::now() - start;
+
+      if ( store.totalUsage().ops_ != TIMED_OPERATIONS || ops < 2 * TIMED_OPERATIONS )
+      {
+        std::cerr << "ERROR: expected " << TIMED_OPERATIONS << " ops recorded, the totals hold "
+                  << store.totalUsage().ops_ << std::endl;
+        return FAILURE;
+      }
+
+      std::printf("%12llu %14.1f %12.1f %14.1f %14.1f\n", static_cast<unsigned long long>(users),
+                  nanosecondsPer(recordTime, TIMED_OPERATIONS),
+                  std::chrono::duration<double, std::milli>(syncTime).count(),
+                  nanosecondsPer(queryTime, TIMED_OPERATIONS), nanosecondsPer(totalsTime, TIMED_OPERATIONS));
+    }
+
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** One row of the io benchmark, latencies are of whole batches in microseconds */
+  void printIoResult(const char* backend, const char* test, uint64_t operations, Clock::duration elapsed,
+                     std::vector<double>& latencies)
+  {
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%12s %16s %12.0f %10.1f %10.1f\n", backend, test,
+                operations / std::chrono::duration<double>(elapsed).count(),
+                latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100]);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** Random 4KB reads one at a time and in batches, and 4KB log appends each followed by an fdatasync, through both
+   *  IoQueue backends
+   *
+   * args: [file-MB] [directory], the file is opened O_DIRECT where the filesystem allows so reads reach the device,
+   * otherwise they are served from the page cache and mostly measure the system call overhead. The directory defaults
+   * to the system temp directory, which may well be memory backed.
+   */
+  int ioBenchmark(const std::vector<std::string>& args)
+  {
+    uint64_t fileSize = (args.empty() ? DEFAULT_IO_FILE_MB : std::stoull(args[0])) << 20;
+    std::string parent = args.size() > 1 ? args[1] : boost::filesystem::temp_directory_path().string();
+    std::string path = (boost::filesystem::path(parent) / boost::filesystem::unique_path("userstore-io-%%%%%%%%")).string();
+    std::string logPath = path + ".log";
+
+    const unsigned maxBatch = IO_BATCH_SIZES[sizeof(IO_BATCH_SIZES) / sizeof(IO_BATCH_SIZES[0]) - 1];
+    void* memory = nullptr;
+    if ( ::posix_memalign(&memory, IO_BLOCK_SIZE, maxBatch * IO_BLOCK_SIZE) != 0 )
+    {
+      throw std::bad_alloc();
+    }
+    std::unique_ptr<char, void(*)(void*)> buffer(static_cast<char*>(memory), std::free);
+    std::memset(buffer.get(), 'x', maxBatch * IO_BLOCK_SIZE);
+
+    struct Cleanup
+    {
+      ~Cleanup() { std::remove(path_.c_str()); std::remove(logPath_.c_str()); }
+      const std::string& path_;
+      const std::string& logPath_;
+    } cleanup = { path, logPath };
+
+    {
+      int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if ( fd < 0 )
+      {
+        throw userstore::systemError("Unable to create file", path);
+      }
+      std::unique_ptr<userstore::IoQueue> filler = userstore::IoQueue::create(userstore::IoQueue::Backend::Synchronous);
+      for (uint64_t offset = 0; offset < fileSize; offset += maxBatch * IO_BLOCK_SIZE)
+      {
+        filler->write(fd, buffer.get(), maxBatch * IO_BLOCK_SIZE, offset, path);
+      }
+      filler->sync(fd, path);
+      filler->submit();
+      ::close(fd);
+    }
+
+    bool direct = true;
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+    int logFd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if ( fd < 0 )
+    {
+      direct = false;
+      fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if ( fd < 0 || logFd < 0 )
+    {
+      throw userstore::systemError("Unable to open file", fd < 0 ? path : logPath);
+    }
+
+    std::printf("%llu MB file, %s reads\n", static_cast<unsigned long long>(fileSize >> 20),
+                direct ? "direct" : "buffered (no O_DIRECT here)");
+    std::printf("%12s %16s %12s %10s %10s\n", "backend", "test", "ops/s", "p50 us", "p99 us");
+    for (userstore::IoQueue::Backend backend : { userstore::IoQueue::Backend::Synchronous,
+                                                 userstore::IoQueue::Backend::Uring })
+    {
+      std::unique_ptr<userstore::IoQueue> queue = userstore::IoQueue::create(backend, maxBatch);
+      const char* name = queue->backend() == userstore::IoQueue::Backend::Uring ? "io_uring" : "synchronous";
+      if ( queue->backend() != backend )
+      {
+        std::printf("%12s %16s\n", "io_uring", "unavailable");
+        continue;
+      }
+      queue->registerFile(fd);
+      queue->registerFile(logFd);
+      queue->registerBuffer(buffer.get(), maxBatch * IO_BLOCK_SIZE);
+
+      std::mt19937_64 random(fileSize);
+      for (unsigned batch : IO_BATCH_SIZES)
+      {
+        std::vector<double> latencies;
+        Clock::time_point start = Clock::now();
+        for (uint64_t done = 0; done < IO_READS; done += batch)
+        {
+          Clock::time_point batchStart = Clock::now();
+          for (unsigned index = 0; index < batch; ++index)
+          {
+            uint64_t offset = (random() % (fileSize / IO_BLOCK_SIZE)) * IO_BLOCK_SIZE;
+            queue->read(fd, buffer.get() + index * IO_BLOCK_SIZE, IO_BLOCK_SIZE, offset, path);
+          }
+          queue->submit();
+          latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - batchStart).count());
+        }
+        printIoResult(name, ("read 4K x" + std::to_string(batch)).c_str(), IO_READS, Clock::now() - start, latencies);
+      }
+
+      std::vector<double> latencies;
+      Clock::time_point start = Clock::now();
+      for (uint64_t append = 0; append < IO_APPENDS; ++append)
+      {
+        Clock::time_point appendStart = Clock::now();
+        queue->write(logFd, buffer.get(), IO_BLOCK_SIZE, append * IO_BLOCK_SIZE, logPath);
+        queue->sync(logFd, logPath);
+        queue->submit();
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - appendStart).count());
+      }
+      printIoResult(name, "append+sync 4K", IO_APPENDS, Clock::now() - start, latencies);
+
+      queue->unregisterFile(fd);
+      queue->unregisterFile(logFd);
+    }
+
+    ::close(fd);
+    ::close(logFd);
+    return SUCCESS;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** A keep-alive connection to the admin API with the send times of the requests it has in flight, oldest first
+   */
+  struct HttpConnection
+  {
+    int fd_;
+    std::string out_;
+    size_t sent_;
+    std::string in_;
+    std::deque<Clock::time_point> inFlight_;
+
+  }; // struct
+
+  int connectLoopback(uint16_t port)
+  {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int noDelay = 1;
+    if ( fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 )
+    {
+      throw userstore::systemError("Unable to connect", "127.0.0.1:" + std::to_string(port));
+    }
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+  }
+
+  /** Take every complete response off the front of the connection's input
+   *
+   * @returns the number taken, adding their latencies and counting those that weren't 200 OK.
+   */
+  uint64_t takeResponses(HttpConnection& connection, std::vector<double>& latencies, uint64_t& failures)
+  {
+    uint64_t taken = 0;
+    size_t consumed = 0;
+    while ( true )
+    {
+      size_t headerEnd = connection.in_.find("\r\n\r\n", consumed);
+      if ( headerEnd == std::string::npos )
+      {
+        break;
+      }
+      size_t lengthAt = connection.in_.find("Content-Length: ", consumed);
+      size_t length = lengthAt < headerEnd ? std::strtoull(connection.in_.c_str() + lengthAt + 16, nullptr, 10) : 0;
+      if ( connection.in_.size() < headerEnd + 4 + length )
+      {
+        break;
+      }
+
+      if ( connection.in_.compare(consumed, 12, "HTTP/1.1 200") != 0 )
+      {
+        ++failures;
+      }
+      latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - connection.inFlight_.front()).count());
+      connection.inFlight_.pop_front();
+      consumed = headerEnd + 4 + length;
+      ++taken;
+    }
+    connection.in_.erase(0, consumed);
+    return taken;
+  }
+
+  /** Send every request through the connections, keeping up to depth in flight on each, and print a row
+   *
+   * @returns false if any request failed.
+   */
+  bool runHttpPhase(std::vector<HttpConnection>& connections, unsigned depth, const char* method, uint64_t firstUser,
+                    uint64_t users, const std::string& extra, const std::string& token)
+  {
+    std::vector<double> latencies;
+    latencies.reserve(users);
+    uint64_t next = 0, completed = 0, failures = 0;
+    std::vector<pollfd> polled(connections.size());
+
+    Clock::time_point start = Clock::now();
+    while ( completed < users )
+    {
+      for (size_t index = 0; index < connections.size(); ++index)
+      {
+        HttpConnection& connection = connections[index];
+        while ( connection.inFlight_.size() < depth && next < users )
+        {
+          connection.out_.append(method).append(" /admin/user?uid=").append(makeUuid(firstUser + next++))
+                         .append(extra).append(" HTTP/1.1\r\nHost: 127.0.0.1\r\nAuthorization: Bearer ")
+                         .append(token).append("\r\n\r\n");
+          connection.inFlight_.push_back(Clock::now());
+        }
+        while ( connection.sent_ < connection.out_.size() )
+        {
+          ssize_t sent = ::send(connection.fd_, connection.out_.data() + connection.sent_,
+                                connection.out_.size() - connection.sent_, MSG_NOSIGNAL);
+          if ( sent <= 0 )
+          {
+            break;
+          }
+          connection.sent_ += sent;
+        }
+        if ( connection.sent_ == connection.out_.size() )
+        {
+          connection.out_.clear();
+          connection.sent_ = 0;
+        }
+
+        polled[index].fd = connection.fd_;
+        polled[index].events = POLLIN | (connection.out_.empty() ? 0 : POLLOUT);
+        polled[index].revents = 0;
+      }
+
+      if ( ::poll(polled.data(), polled.size(), -1) < 0 && errno != EINTR )
+      {
+        throw userstore::systemError("Unable to poll connections", "127.0.0.1");
+      }
+      for (size_t index = 0; index < connections.size(); ++index)
+      {
+        if ( polled[index].revents & (POLLIN | POLLHUP | POLLERR) )
+        {
+          char buffer[64 * 1024];
+          ssize_t received = ::recv(connections[index].fd_, buffer, sizeof(buffer), 0);
+          if ( received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR) )
+          {
+            throw userstore::StoreError("Server closed a connection", "127.0.0.1");
+          }
+          if ( received > 0 )
+          {
+            connections[index].in_.append(buffer, received);
+            completed += takeResponses(connections[index], latencies, failures);
+          }
+        }
+      }
+    }
+    Clock::duration elapsed = Clock::now() - start;
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%8s %6u %12.0f %10.1f %10.1f %10.1f %10.1f %9llu\n", method, depth,
+                users / std::chrono::duration<double>(elapsed).count(), latencies[latencies.size() / 2],
+                latencies[latencies.size() * 9 / 10], latencies[latencies.size() * 99 / 100],
+                latencies[latencies.size() * 999 / 1000], static_cast<unsigned long long>(failures));
+    return failures == 0;
+  }
+
+  /** Load test of a running serve --http: creates, reads and deletes users through the admin API over keep-alive
+   *  connections, one request at a time and then pipelined
+   *
+   * args: port token-file [users] [connections] [depth], the token file being the admin.token the daemon wrote, the
+   * users are created with uuids no other benchmark uses and are all deleted again. Latency is from queueing a request to its whole response arriving.
+   */
+  int httpBenchmark(const std::vector<std::string>& args)
+  {
+    std::string token;
+    std::ifstream tokenFile(args.size() > 1 ? args[1] : std::string());
+    if ( args.size() < 2 || ! (tokenFile >> token) )
+    {
+      std::cerr << "USAGE: userstore-bench http <port> <token-file> [users] [connections] [depth]" << std::endl;
+      return FAILURE;
+    }
+    uint16_t port = static_cast<uint16_t>(std::stoul(args[0]));
+    uint64_t users = args.size() > 2 ? std::stoull(args[2]) : DEFAULT_HTTP_USERS;
+    unsigned connectionCount = args.size() > 3 ? std::stoul(args[3]) : DEFAULT_HTTP_CONNECTIONS;
+    unsigned depth = args.size() > 4 ? std::stoul(args[4]) : DEFAULT_HTTP_DEPTH;
+
+    std::vector<HttpConnection> connections(connectionCount);
+    for (HttpConnection& connection : connections)
+    {
+      connection.fd_ = connectLoopback(port);
+      connection.sent_ = 0;
+    }
+
+    /** Far above the uuids the other benchmarks make, so a store they filled can be used as it is */
+    const uint64_t firstUser = uint64_t(0xbe) << 40;
+
+    std::printf("%u connections, %llu users\n", connectionCount, static_cast<unsigned long long>(users));
+    std::printf("%8s %6s %12s %10s %10s %10s %10s %9s\n", "method", "depth", "requests/s", "p50 us", "p90 us",
+                "p99 us", "p99.9 us", "failures");
+    bool succeeded = true;
+    for (unsigned pipeline : { 1u, depth })
+    {
+      succeeded &= runHttpPhase(connections, pipeline, "PUT", firstUser, users, "&display-name=load", token);
+      succeeded &= runHttpPhase(connections, pipeline, "GET", firstUser, users, "", token);
+      succeeded &= runHttpPhase(connections, pipeline, "DELETE", firstUser, users, "", token);
+    }
+
+    for (HttpConnection& connection : connections)
+    {
+      ::close(connection.fd_);
+    }
+    return succeeded ? SUCCESS : FAILURE;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  const std::map<std::string, Benchmark> BENCHMARKS =
+  {
+    { "lookup", lookupBenchmark },
+    { "commit", commitBenchmark },
+    { "import", importBenchmark },
+    { "memory", memoryBenchmark },
+    { "contention", contentionBenchmark },
+    { "usage", usageBenchmark },
+    { "io", ioBenchmark },
+    { "http", httpBenchmark },
+  };
+
+  void usage(std::ostream& out)
+  {
+    out << "USAGE: userstore-bench <benchmark> [args...]" << std::endl
+        << "Available benchmarks:" << std::endl;
+    for (auto benchmark : BENCHMARKS)
+    {
+      out << "\t" << benchmark.first << std::endl;
+    }
+  }
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+  if ( argc < 2 || ! BENCHMARKS.count(argv[1]) )
+  {
+    usage(std::cerr);
+    return FAILURE;
+  }
+
+  try
+  {
+    return BENCHMARKS.at(argv[1])( std::vector<std::string>(argv + 2, argv + argc) );
+  }
+  catch(userstore::StoreError& e)
+  {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return FAILURE;
+  }
+
+} // main
+
+//----------------------------------------------------------------------------------------------------------------------
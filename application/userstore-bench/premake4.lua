@@ -0,0 +1,32 @@
+
+-----------------------------------------------------------------------------------------------------------------------
+project "userstore-bench"
+  language "C++"
+  kind "ConsoleApp"
+
+  files { "*.cpp", "*.hpp" }
+
+  libdirs { "../../boost/stage/lib" }
+  includedirs { "../../boost", "../../" }
+
+  links { "userstore" }
+
+  targetdir( "../../builds/bin")
+
+  configuration { "gmake" }
+    linkoptions { "-static -pthread" }
+    buildoptions { "-std=c++11" }
+
+    links       { "boost_filesystem",
+                  "boost_system" }
+
+  configuration "Debug"
+       defines { "DEBUG" }
+       flags { "Symbols" }
+
+  configuration "Release"
+      defines { "NDEBUG" }
+      flags { "Optimize" }
+
+
+-----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,513 @@
+#include "ArgvParser.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace
+{
+  namespace po = boost::program_options;
+
+  /** command_line_parser's default style names options in errors with the long prefix, as --name */
+  const int CANONICAL_PREFIX = po::command_line_style::allow_long;
+
+  const boost::string_view LONG_PREFIX("--");
+  const boost::string_view TERMINATOR("--");
+
+  /** command_line_parser marks positionals after the terminator this way, they never become an option's values */
+  const int AFTER_TERMINATOR = INT_MAX;
+
+  bool isLongOption(boost::string_view token)
+  {
+    return token.size() >= 3 && token.starts_with(LONG_PREFIX);
+  }
+
+  bool isShortOption(boost::string_view token)
+  {
+    return token.size() >= 2 && token[0] == '-' && token[1] != '-';
+  }
+
+  /** Options that could take more values from the positionals after them, multitoken and implicit valued ones */
+  bool takesVariableTokens(const po::option_description* description)
+  {
+    return description && description->semantic()->min_tokens() < description->semantic()->max_tokens();
+  }
+
+  /** The distinct options among the matches, in the order they were declared, as boost reports alternatives */
+  template <typename T_Name>
+  std::vector<const T_Name*> distinctOptions(const T_Name* first, const T_Name* last)
+  {
+    std::vector<const T_Name*> matches;
+    for (const T_Name* name = first; name != last; ++name)
+    {
+      if ( std::none_of(matches.begin(), matches.end(), [name](const T_Name* m) { return m->option_ == name->option_; }) )
+      {
+        matches.push_back(name);
+      }
+    }
+    std::sort(matches.begin(), matches.end(), [](const T_Name* a, const T_Name* b) { return a->declared_ < b->declared_; });
+    return matches;
+  }
+
+  template <typename T_Name>
+  po::ambiguous_option ambiguity(const std::vector<const T_Name*>& matches, const std::string& spelling)
+  {
+    std::vector<std::string> alternatives;
+    for (const T_Name* match : matches)
+    {
+      alternatives.push_back(match->option_->key(spelling));
+    }
+    return po::ambiguous_option(alternatives);
+  }
+
+} // namespace
+
+namespace oberon {
+
+//----------------------------------------------------------------------------------------------------------------------
+  ArgvParser::ArgvParser(const po::options_description& options,
+                         const po::positional_options_description& positionalOptions) :
+    options_(options),
+    positional_(positionalOptions)
+  {
+    const std::vector<boost::shared_ptr<po::option_description> >& all = options_.options();
+    for (size_t declared = 0; declared < all.size(); ++declared)
+    {
+      const po::option_description* option = all[declared].get();
+      std::pair<const std::string*, std::size_t> longNames = option->long_names();
+      for (size_t name = 0; name < longNames.second; ++name)
+      {
+        if ( ! longNames.first[name].empty() )
+        {
+          longNames_.push_back( LongName{ longNames.first[name], option, declared } );
+        }
+      }
+
+      /** There is no accessor for the short name, its display form is it with a dash when there is one */
+      std::string shortName = option->canonical_display_name(po::command_line_style::allow_dash_for_short);
+      if ( shortName.size() == 2 && shortName[0] == '-' && shortName[1] != '-' )
+      {
+        shortNames_.push_back( ShortName{ shortName[1], option, declared } );
+      }
+    }
+
+    std::stable_sort(longNames_.begin(), longNames_.end(), [](const LongName& a, const LongName& b)
+                                                          { return a.name_ < b.name_; });
+    std::stable_sort(shortNames_.begin(), shortNames_.end(), [](const ShortName& a, const ShortName& b)
+                                                            { return a.name_ < b.name_; });
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  ArgvParser::Tokens ArgvParser::tokenise(int argc, char** argv)
+  {
+    Tokens tokens;
+    tokens.reserve(argc > 1 ? argc - 1 : 0);
+    for (int argument = 1; argument < argc; ++argument)
+    {
+      tokens.push_back(argv[argument]);
+    }
+    return tokens;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  po::parsed_options ArgvParser::parse(const Tokens& tokens) const
+  {
+    po::parsed_options parsed(&options_, CANONICAL_PREFIX);
+    std::vector<po::option>& result = parsed.options;
+    result.reserve(tokens.size());
+    bool variableTokens = false;
+
+    size_t next = 0;
+    const size_t end = tokens.size();
+    while ( next < end )
+    {
+      boost::string_view token = tokens[next];
+      if ( isLongOption(token) )
+      {
+        po::option option;
+        boost::string_view name = token.substr(LONG_PREFIX.size());
+        size_t equals = name.find('=');
+        if ( equals != boost::string_view::npos )
+        {
+          boost::string_view adjacent = name.substr(equals + 1);
+          name = name.substr(0, equals);
+          if ( adjacent.empty() )
+          {
+            throw po::invalid_command_line_syntax(po::invalid_command_line_syntax::empty_adjacent_parameter,
+                                                  name.to_string(), name.to_string(), CANONICAL_PREFIX);
+          }
+          option.value.push_back(adjacent.to_string());
+        }
+        option.string_key = name.to_string();
+        option.original_tokens.push_back(token.to_string());
+        ++next;
+        if ( name.empty() ) // --=value, command_line_parser takes the value for a positional
+        {
+          result.push_back(std::move(option));
+          continue;
+        }
+
+        const po::option_description* description = nullptr;
+        try
+        {
+          description = findLong(name);
+        }
+        catch(po::error_with_option_name& e)
+        {
+          e.add_context(option.string_key, option.original_tokens.front(), CANONICAL_PREFIX);
+          throw;
+        }
+        finishOption(option, description, tokens, next, end);
+        variableTokens |= takesVariableTokens(description);
+        result.push_back(std::move(option));
+      }
+      else if ( isShortOption(token) )
+      {
+        /** Switches can be grouped, -ab is -a -b, up to the first option that takes a value which takes the rest */
+        char name = token[1];
+        boost::string_view adjacent = token.substr(2);
+        while ( true )
+        {
+          const po::option_description* description = nullptr;
+          try
+          {
+            description = findShort(name);
+          }
+          catch(po::error_with_option_name& e)
+          {
+            e.set_original_token(token.to_string());
+            throw;
+          }
+
+          po::option option;
+          option.string_key = std::string(1, '-') + name;
+          if ( description && description->semantic()->max_tokens() == 0 && ! adjacent.empty() )
+          {
+            size_t none = next;
+            finishOption(option, description, tokens, none, none);
+            result.push_back(std::move(option));
+            name = adjacent[0];
+            adjacent.remove_prefix(1);
+            continue;
+          }
+
+          option.original_tokens.push_back(token.to_string());
+          if ( ! adjacent.empty() )
+          {
+            option.value.push_back(adjacent.to_string());
+          }
+          ++next;
+          finishOption(option, description, tokens, next, end);
+          variableTokens |= takesVariableTokens(description);
+          result.push_back(std::move(option));
+          break;
+        }
+      }
+      else if ( token == TERMINATOR )
+      {
+        for (++next; next < end; ++next)
+        {
+          po::option option;
+          option.value.push_back(tokens[next].to_string());
+          option.original_tokens.push_back(option.value.front());
+          option.position_key = AFTER_TERMINATOR;
+          result.push_back(std::move(option));
+        }
+      }
+      else
+      {
+        po::option option;
+        option.value.push_back(token.to_string());
+        option.original_tokens.push_back(option.value.front());
+        result.push_back(std::move(option));
+        ++next;
+      }
+    }
+
+    /** An option that can take more values takes the positionals that follow it, up to its maximum */
+    if ( variableTokens )
+    {
+      std::vector<po::option> merged;
+      merged.reserve(result.size());
+      for (size_t index = 0; index < result.size(); ++index)
+      {
+        merged.push_back(std::move(result[index]));
+        po::option& option = merged.back();
+        if ( option.string_key.empty() )
+        {
+          continue;
+        }
+
+        const po::option_description* description = option.string_key.size() == 2 && option.string_key[0] == '-' ?
+                                                       findShort(option.string_key[1]) : findLong(option.string_key);
+        unsigned maxTokens = description->semantic()->max_tokens();
+        if ( ! takesVariableTokens(description) || option.value.size() >= maxTokens )
+        {
+          continue;
+        }
+
+        size_t following = index + 1;
+        for (size_t room = maxTokens - option.value.size(); room && following < result.size(); --room, ++following)
+        {
+          po::option& positional = result[following];
+          if ( ! positional.string_key.empty() || positional.position_key == AFTER_TERMINATOR )
+          {
+            break;
+          }
+          option.value.push_back(std::move(positional.value.front()));
+          option.original_tokens.push_back(std::move(positional.original_tokens.front()));
+        }
+        index = following - 1;
+      }
+      result.swap(merged);
+    }
+
+    unsigned position = 0;
+    for (po::option& option : result)
+    {
+      if ( option.string_key.empty() )
+      {
+        if ( position >= positional_.max_total_count() )
+        {
+          throw po::too_many_positional_options_error();
+        }
+        option.position_key = static_cast<int>(position);
+        option.string_key = positional_.name_for_position(position);
+        ++position;
+      }
+    }
+
+    return parsed;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t ArgvParser::firstPositional(const Tokens& tokens) const
+  {
+    size_t next = skipOptions(tokens, 0, false);
+    return next < tokens.size() && tokens[next] == TERMINATOR ? next + 1 : next;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t ArgvParser::terminator(const Tokens& tokens) const
+  {
+    size_t next = skipOptions(tokens, 0, true);
+    while ( next < tokens.size() && tokens[next] != TERMINATOR )
+    {
+      next = skipOptions(tokens, next + 1, true);
+    }
+    return next;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t ArgvParser::skipOptions(const Tokens& tokens, size_t next, bool lenient) const
+  {
+    const size_t end = tokens.size();
+    while ( next < end )
+    {
+      boost::string_view token = tokens[next];
+      if ( isLongOption(token) )
+      {
+        boost::string_view name = token.substr(LONG_PREFIX.size());
+        size_t equals = name.find('=');
+        if ( equals == 0 ) // --=value is a positional
+        {
+          return next;
+        }
+
+        const po::option_description* description = nullptr;
+        try
+        {
+          description = findLong(name.substr(0, equals));
+          if ( ! description )
+          {
+            throw po::unknown_option();
+          }
+        }
+        catch(po::error_with_option_name& e)
+        {
+          if ( lenient )
+          {
+            ++next;
+            continue;
+          }
+          e.add_context(name.substr(0, equals).to_string(), token.to_string(), CANONICAL_PREFIX);
+          throw;
+        }
+        ++next;
+        next = skipValues(description, equals == boost::string_view::npos ? 0 : 1, tokens, next);
+      }
+      else if ( isShortOption(token) )
+      {
+        for (size_t character = 1; ; ++character)
+        {
+          const po::option_description* description = nullptr;
+          try
+          {
+            description = findShort(token[character]);
+            if ( ! description )
+            {
+              throw po::unknown_option();
+            }
+          }
+          catch(po::error_with_option_name& e)
+          {
+            if ( lenient )
+            {
+              ++next;
+              break;
+            }
+            e.add_context(std::string(1, '-') + token[character], token.to_string(), CANONICAL_PREFIX);
+            throw;
+          }
+
+          bool lastCharacter = character + 1 == token.size();
+          if ( description->semantic()->max_tokens() == 0 && ! lastCharacter ) // grouped with more switches
+          {
+            continue;
+          }
+          ++next;
+          next = skipValues(description, lastCharacter ? 0 : 1, tokens, next);
+          break;
+        }
+      }
+      else
+      {
+        return next;
+      }
+    }
+    return end;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t ArgvParser::skipValues(const po::option_description* description,
+                                size_t adjacentValues,
+                                const Tokens& tokens,
+                                size_t next) const
+  {
+    const size_t end = tokens.size();
+    unsigned minTokens = description->semantic()->min_tokens();
+    unsigned maxTokens = description->semantic()->max_tokens();
+    if ( adjacentValues < minTokens )
+    {
+      size_t needed = std::min<size_t>(minTokens - adjacentValues, end - next);
+      next += needed;
+      adjacentValues += needed;
+    }
+
+    /** What it can take beyond that are the positionals straight after it */
+    for (; takesVariableTokens(description) && adjacentValues < maxTokens && next < end; ++next, ++adjacentValues)
+    {
+      boost::string_view token = tokens[next];
+      if ( isLongOption(token) || isShortOption(token) || token == TERMINATOR )
+      {
+        break;
+      }
+    }
+    return next;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  const po::option_description* ArgvParser::findLong(boost::string_view name) const
+  {
+    /** Names are matched against short names too, so ---x is -x */
+    if ( name.size() == 2 && name[0] == '-' )
+    {
+      if ( const po::option_description* option = findShort(name[1]) )
+      {
+        return option;
+      }
+    }
+
+    auto byName = [](const LongName& entry, boost::string_view n) { return entry.name_ < n; };
+    const LongName* first = std::lower_bound(longNames_.data(), longNames_.data() + longNames_.size(), name, byName);
+    const LongName* last = first;
+    const LongName* exact = first;
+    while ( last != longNames_.data() + longNames_.size() && last->name_.starts_with(name) )
+    {
+      if ( last->name_.size() == name.size() )
+      {
+        exact = last + 1;
+      }
+      ++last;
+    }
+
+    /** An exact match wins over names it is a prefix of, so --all isn't ambiguous with --all-users */
+    if ( exact != first )
+    {
+      last = exact;
+    }
+    std::vector<const LongName*> matches = distinctOptions(first, last);
+    if ( matches.size() > 1 )
+    {
+      throw ambiguity(matches, name.to_string());
+    }
+    return matches.empty() ? nullptr : matches.front()->option_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  const po::option_description* ArgvParser::findShort(char name) const
+  {
+    auto range = std::equal_range(shortNames_.data(), shortNames_.data() + shortNames_.size(), ShortName{ name, nullptr, 0 },
+                                  [](const ShortName& a, const ShortName& b) { return a.name_ < b.name_; });
+    std::vector<const ShortName*> matches = distinctOptions(range.first, range.second);
+    if ( matches.size() > 1 )
+    {
+      throw ambiguity(matches, std::string(1, '-') + name);
+    }
+    return matches.empty() ? nullptr : matches.front()->option_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void ArgvParser::finishOption(po::option& option,
+                                const po::option_description* description,
+                                const Tokens& tokens,
+                                size_t& next,
+                                size_t end) const
+  {
+    std::string originalToken = option.original_tokens.empty() ? option.string_key : option.original_tokens.front();
+    try
+    {
+      if ( ! description )
+      {
+        throw po::unknown_option();
+      }
+      option.string_key = description->key(option.string_key);
+
+      /** A value given as --name=value or -nvalue counts towards the values the option needs */
+      unsigned minTokens = description->semantic()->min_tokens();
+      unsigned maxTokens = description->semantic()->max_tokens();
+      if ( option.value.size() + (end - next) < minTokens )
+      {
+        throw po::invalid_command_line_syntax(po::invalid_command_line_syntax::missing_parameter);
+      }
+      if ( ! option.value.empty() && maxTokens == 0 )
+      {
+        throw po::invalid_command_line_syntax(po::invalid_command_line_syntax::extra_parameter);
+      }
+
+      /** Anything can be a value, --name included, except the exact spelling of a short option */
+      size_t wanted = option.value.size() <= minTokens ? minTokens - option.value.size() : 0;
+      for (; wanted && next < end; --wanted, ++next)
+      {
+        boost::string_view token = tokens[next];
+        if ( token.size() == 2 && isShortOption(token) )
+        {
+          originalToken = token.to_string();
+          if ( findShort(token[1]) )
+          {
+            throw po::invalid_command_line_syntax(po::invalid_command_line_syntax::missing_parameter);
+          }
+        }
+        option.value.push_back(token.to_string());
+        option.original_tokens.push_back(option.value.back());
+      }
+    }
+    catch(po::error_with_option_name& e)
+    {
+      e.add_context(option.string_key, originalToken, CANONICAL_PREFIX);
+      throw;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,122 @@
+#ifndef OBERON_ARGVPARSER_HPP
+#define OBERON_ARGVPARSER_HPP
+
+#include "boost/program_options.hpp"
+#include "boost/utility/string_view.hpp"
+
+#include <string>
+#include <vector>
+
+namespace oberon
+{
+//**********************************************************************************************************************
+  /** Single pass command line parser over views of the original arguments, the alternative to
+   *  boost::program_options::command_line_parser that SubcommandCLI uses when built with OBERON_NATIVE_PARSER
+   *
+   * The options are indexed once, by long name in a sorted table and by short name, so each token is resolved with a
+   * binary search rather than a scan of every option, and tokens are only copied into the parsed_options handed to
+   * boost::program_options::store, which keeps typing, defaults, required options and notifiers exactly as they are.
+   *
+   * The grammar is command_line_parser's default style: --name, --name=value, --name value, unambiguous prefixes of
+   * long names, -n, -nvalue, -n value, grouped switches (-ab), a lone - as a positional and -- ending the options. It
+   * throws the same boost::program_options errors for the same command lines. Long names with a '*' wildcard aren't
+   * supported.
+   */
+  class ArgvParser
+  {
+  public: // types
+    typedef std::vector<boost::string_view> Tokens;
+
+  public: // interface
+    /** The options and positional description are copied, the parser can outlive them */
+    ArgvParser(const boost::program_options::options_description& options,
+               const boost::program_options::positional_options_description& positionalOptions);
+
+    ArgvParser(const ArgvParser&) = delete;
+    ArgvParser& operator=(const ArgvParser&) = delete;
+
+    /** Views of the arguments after the program name, they refer to argv and are only valid as long as it is */
+    static Tokens tokenise(int argc, char** argv);
+
+    /** Parse the tokens as command_line_parser(tokens).options(options).positional(positional).run() would
+     *
+     * @throws boost::program_options::error: the same error command_line_parser would throw.
+     */
+    boost::program_options::parsed_options parse(const Tokens& tokens) const;
+
+    /** Index of the first positional token, what a subcommand line's subcommand is, tokens.size() if there is none
+     *
+     * Only the options before it are resolved.
+     * @throws boost::program_options::unknown_option: if one of those isn't an option.
+     * @throws boost::program_options::ambiguous_option: if one of those is a prefix of several long names.
+     */
+    size_t firstPositional(const Tokens& tokens) const;
+
+    /** Index of the -- that ends the options, tokens.size() if there is none
+     *
+     * Options that can't be resolved are passed over as taking no values, parse() is what reports them.
+     */
+    size_t terminator(const Tokens& tokens) const;
+
+    const boost::program_options::options_description& options() const { return options_; }
+    const boost::program_options::positional_options_description& positionalOptions() const { return positional_; }
+
+  private: // types
+    struct LongName
+    {
+      boost::string_view name_; // views the option's own name
+      const boost::program_options::option_description* option_;
+      size_t declared_; // position in the options, which orders alternatives as boost does
+
+    }; // struct
+
+    struct ShortName
+    {
+      char name_;
+      const boost::program_options::option_description* option_;
+      size_t declared_;
+
+    }; // struct
+
+  private: // methods
+    /** The option with this long name or, failing that, the one long name it is a prefix of; null if there is none
+     *
+     * @throws boost::program_options::ambiguous_option: if several options have the name, or have it as a prefix.
+     */
+    const boost::program_options::option_description* findLong(boost::string_view name) const;
+
+    /** @throws boost::program_options::ambiguous_option: if several options have the short name. */
+    const boost::program_options::option_description* findShort(char name) const;
+
+    /** Index of the first token from next on that isn't an option or an option's value
+     *
+     * @param lenient: pass over options that can't be resolved as taking no values, rather than throw.
+     */
+    size_t skipOptions(const Tokens& tokens, size_t next, bool lenient) const;
+
+    /** Index of the first token after the values an option takes, given how many it had in its own token */
+    size_t skipValues(const boost::program_options::option_description* description,
+                      size_t adjacentValues,
+                      const Tokens& tokens,
+                      size_t next) const;
+
+    /** Check the option and take the values it needs from the tokens after it, as command_line_parser does */
+    void finishOption(boost::program_options::option& option,
+                      const boost::program_options::option_description* description,
+                      const Tokens& tokens,
+                      size_t& next,
+                      size_t end) const;
+
+  private: // data
+    boost::program_options::options_description options_;
+    boost::program_options::positional_options_description positional_;
+    std::vector<LongName> longNames_;   // sorted by name
+    std::vector<ShortName> shortNames_; // sorted by name
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // OBERON_ARGVPARSER_HPP
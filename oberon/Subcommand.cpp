@@ -74,7 +74,26 @@ namespace oberon {
       po::store(po::command_line_parser(commandLine).options( allOptionsLocal ).positional( positionalLocal ).run(), vm);
     };
     executeAndTranslateExceptions<void>( wrapParseAndStore, allOptionsLocal, positionalLocal, this->name() );
-    executeAndTranslateExceptions<void>( std::bind(&po::notify, vm), allOptionsLocal, positionalLocal, this->name());
+    executeAndTranslateExceptions<void>( std::bind(&po::notify, std::ref(vm)), allOptionsLocal, positionalLocal,
+                                        this->name());
+
+    checkOptionConsistency(vm);
+
+    return vm;
+
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  po::variables_map Subcommand::parseCommandLine(const ArgvParser& parser, const ArgvParser::Tokens& commandLine) const
+  {
+    po::variables_map vm;
+    auto parseAndStore = [&]()
+    {
+      po::store(parser.parse(commandLine), vm);
+    };
+    executeAndTranslateExceptions<void>( parseAndStore, parser.options(), parser.positionalOptions(), this->name() );
+    executeAndTranslateExceptions<void>( std::bind(&po::notify, std::ref(vm)), parser.options(),
+                                         parser.positionalOptions(), this->name());
 
     checkOptionConsistency(vm);
 
@@ -106,7 +125,7 @@ namespace oberon {
   }
 
 //----------------------------------------------------------------------------------------------------------------------
-  void Subcommand::checkOptionConsistency(po::variables_map vm) const
+  void Subcommand::checkOptionConsistency(const po::variables_map& vm) const
   {
     // as specified in the header, this
     return;
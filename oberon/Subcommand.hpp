@@ -1,6 +1,7 @@
 #ifndef OBERON_SUBCOMMAND_HPP
 #define OBERON_SUBCOMMAND_HPP
 
+#include "ArgvParser.hpp"
 #include "OptionCollection.hpp"
 
 #include "boost/program_options.hpp"
@@ -46,7 +47,7 @@ namespace oberon
      */
     boost::program_options::options_description allOptions(bool includeDescText=true) const;
 
-    std::string name() const { return name_; }
+    const std::string& name() const { return name_; }
 
   public: // virtual interface
 
@@ -80,6 +81,13 @@ namespace oberon
      */
     virtual boost::program_options::variables_map parseCommandLine(const std::vector<std::string>& commandLine) const;
 
+    /** Parse the options with a parser built from allOptions() and positionalOptions(), see ArgvParser
+     *
+     * @throws CommandLineParsingError: if there was an error parsing the command line
+     */
+    virtual boost::program_options::variables_map parseCommandLine(const ArgvParser& parser,
+                                                                   const ArgvParser::Tokens& commandLine) const;
+
 
     /** Print the standard formatted usage description for this subcommand.
      */
@@ -98,7 +106,7 @@ namespace oberon
      *
      * @throws CommandLineParsingError: if the options are found to be inconsistent.
      */
-    virtual void checkOptionConsistency(boost::program_options::variables_map vm) const;
+    virtual void checkOptionConsistency(const boost::program_options::variables_map& vm) const;
 
 
   protected: // statics
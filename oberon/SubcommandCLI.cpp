@@ -38,18 +38,19 @@ namespace oberon {
 
     visiblePositionalOptions_.add("subcommand", 1);
 
+    parseOptions_.add(applicationSubcommands_.allUniqueOptions()).add(globalAppOptions_).add(subcommandOptions_);
   }
 
 //----------------------------------------------------------------------------------------------------------------------
   SubcommandCLI::ParseOutput SubcommandCLI::parseCommandLine(int argc, char** argv)
   {
-    po::options_description all;
-    all.add(applicationSubcommands_.allUniqueOptions()).add(globalAppOptions_).add(subcommandOptions_);
-
+#ifdef OBERON_NATIVE_PARSER
+    return parseTokens(ArgvParser::tokenise(argc, argv));
+#else
     auto parsingCode = [&]() -> ParseOutput
     {
       po::parsed_options parsed = po::command_line_parser(argc, argv)
-                                  .options(all)
+                                  .options(parseOptions_)
                                   .positional(subcommandPositionalOptions_)
                                   .run();
       po::variables_map vm;
@@ -60,13 +61,16 @@ namespace oberon {
 
       if ( ! vm.count("subcommand") )
       {
-        return ParseOutput(vm);
+        return ParseOutput(std::move(vm));
       }
 
-      std::vector<std::string> subcommandOptions = prepareCommandLine(parsed.options,
-                                                                      vm.count("additional-positional")
-                                                                        ? vm["additional-positional"].as<std::vector<std::string> >()
-                                                                          : std::vector<std::string>());
+      /** The positionals are moved out, the map is only needed for the subcommand's name from here on */
+      std::vector<std::string> positionals;
+      if ( vm.count("additional-positional") )
+      {
+        positionals = std::move(vm.at("additional-positional").as<std::vector<std::string> >());
+      }
+      std::vector<std::string> subcommandOptions = prepareCommandLine(parsed.options, std::move(positionals));
 
       std::string selectedSubcommand = vm["subcommand"].as<std::string>();
 
@@ -76,11 +80,12 @@ namespace oberon {
       }
 
       return ParseOutput( SubcommandParse{ applicationSubcommands_.getSubcommand(selectedSubcommand),
-                                           subcommandOptions} );
+                                           std::move(subcommandOptions), nullptr, ArgvParser::Tokens() } );
 
     }; // lambda
 
-    return executeAndTranslateExceptions<ParseOutput>(parsingCode, all, subcommandPositionalOptions_);
+    return executeAndTranslateExceptions<ParseOutput>(parsingCode, parseOptions_, subcommandPositionalOptions_);
+#endif
 
   }
 
@@ -153,14 +158,10 @@ namespace oberon {
 
 //----------------------------------------------------------------------------------------------------------------------
   std::vector<std::string> SubcommandCLI::prepareCommandLine(const std::vector<boost::program_options::option>& options,
-                                                             const std::vector<std::string>& posOptions)
+                                                             std::vector<std::string> posOptions)
   {
-    std::vector<std::string> preparedCmdLine;
-    if ( posOptions.size() > 0 )
-    {
-      preparedCmdLine = posOptions;
-    }
-    for (auto option : options)
+    std::vector<std::string> preparedCmdLine = std::move(posOptions);
+    for (const auto& option : options)
     {
       if ( option.position_key == -1 )
       {
@@ -174,6 +175,60 @@ namespace oberon {
 
   }
 
+//----------------------------------------------------------------------------------------------------------------------
+  SubcommandCLI::ParseOutput SubcommandCLI::parseTokens(ArgvParser::Tokens tokens)
+  {
+    if ( ! applicationParser_ )
+    {
+      applicationParser_ = std::make_shared<const ArgvParser>(parseOptions_, subcommandPositionalOptions_);
+    }
+
+    auto parsingCode = [&]() -> ParseOutput
+    {
+      size_t subcommandToken = applicationParser_->firstPositional(tokens);
+      if ( subcommandToken == tokens.size() )
+      {
+        po::variables_map vm;
+        po::store(applicationParser_->parse(tokens), vm);
+        po::notify(vm);
+        return ParseOutput(std::move(vm));
+      }
+
+      std::string selectedSubcommand = tokens[subcommandToken].to_string();
+      if ( ! applicationSubcommands_.exists(selectedSubcommand) )
+      {
+        throw CommandLineParsingError("Subcommand used: " + selectedSubcommand + ", is not valid for this application");
+      }
+
+      SubcommandCollection::SubcommandHandle subcommand = applicationSubcommands_.getSubcommand(selectedSubcommand);
+      std::shared_ptr<const ArgvParser>& parser = subcommandParsers_[selectedSubcommand];
+      if ( ! parser )
+      {
+        parser = std::make_shared<const ArgvParser>(subcommand->allOptions(), subcommand->positionalOptions());
+      }
+
+      /** program_options' global pass consumes the terminator and hands the subcommand what followed it as plain
+       *  tokens, which its own parse reads as options again, so the terminator is dropped here too and both builds
+       *  take a line the same way. The one line they still differ on repeats the terminator: program_options hands
+       *  the subcommand its positionals ahead of its options, so a second -- turns the options into positionals
+       *  there, here they stay options. */
+      size_t terminator = applicationParser_->terminator(tokens);
+      if ( terminator > subcommandToken && terminator < tokens.size() )
+      {
+        tokens.erase(tokens.begin() + terminator);
+      }
+      tokens.erase(tokens.begin() + subcommandToken);
+      if ( terminator < subcommandToken )
+      {
+        tokens.erase(tokens.begin() + terminator);
+      }
+      return ParseOutput( SubcommandParse{ subcommand, std::vector<std::string>(), parser, std::move(tokens) } );
+
+    }; // lambda
+
+    return executeAndTranslateExceptions<ParseOutput>(parsingCode, parseOptions_, subcommandPositionalOptions_);
+  }
+
 //----------------------------------------------------------------------------------------------------------------------
 
 } // namespace
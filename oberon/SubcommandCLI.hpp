@@ -1,12 +1,14 @@
 #ifndef OBERON_SUBCOMMANDCLI_HPP
 #define OBERON_SUBCOMMANDCLI_HPP
 
+#include "ArgvParser.hpp"
 #include "SubcommandCollection.hpp"
 #include "Utils.hpp"
 
 #include "boost/program_options.hpp"
 #include "boost/optional.hpp"
 
+#include <map>
 #include <string>
 #include <vector>
 #include <memory>
@@ -25,25 +27,44 @@ namespace oberon
   {
   public: // types
     //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+    /** The subcommand and its part of the command line, as strings for boost::program_options or, with
+     *  OBERON_NATIVE_PARSER, as views of argv with the parser to resolve them
+     */
     struct SubcommandParse
     {
       boost::shared_ptr<Subcommand> subcommand_;
       std::vector<std::string> processedCommandLine_;
+      std::shared_ptr<const ArgvParser> parser_;
+      ArgvParser::Tokens tokens_;
 
-      boost::program_options::variables_map doSubcommandParse() { return subcommand_->parseCommandLine(processedCommandLine_); }
+      boost::program_options::variables_map doSubcommandParse() const
+      {
+        return parser_ ? subcommand_->parseCommandLine(*parser_, tokens_) :
+                           subcommand_->parseCommandLine(processedCommandLine_);
+      }
 
     }; // struct
     //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
     /** Parse result, with either a subcommand used or not, allowing a client to extract relevant information
+     *
+     * The subcommand's part of the command line is parsed on the first call to vm() and the result kept, so a client
+     * can ask for it as often as it likes.
      */
     class ParseOutput
     {
     public: // interface
-      ParseOutput(const boost::program_options::variables_map& vm) : vm_(vm) {}
-      ParseOutput(const SubcommandParse& parse) : subcommandParse_(parse) {}
-
-      /** @throws CommandLineParsingError: if there were errors while parsing the command line */
-      boost::program_options::variables_map vm()    { return subcommandParse_ ? subcommandParse_->doSubcommandParse() : vm_.get(); }
+      ParseOutput(boost::program_options::variables_map vm) : vm_(std::move(vm)) {}
+      ParseOutput(SubcommandParse parse) : subcommandParse_(std::move(parse)) {}
+
+      /** @throws CommandLineParsingError: if there were errors while parsing the command line, on every call. */
+      const boost::program_options::variables_map& vm()
+      {
+        if ( ! vm_ )
+        {
+          vm_ = subcommandParse_->doSubcommandParse();
+        }
+        return vm_.get();
+      }
 
       /** @note: the subcommand name returned here is guaranteed to exist in the system */
       boost::optional<std::string> subcommandUsed() { return subcommandParse_ ?
@@ -52,7 +73,7 @@ namespace oberon
 
     private: // data
       boost::optional<SubcommandParse> subcommandParse_;
-      boost::optional<boost::program_options::variables_map> vm_;
+      boost::optional<boost::program_options::variables_map> vm_; // the subcommand's once it has been parsed
 
     }; // class
     //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -79,6 +100,9 @@ namespace oberon
      * themselves. The client should have access to all the relevant information to do this as they provide the main
      * options in the constructor if applicable.
      *
+     * Built with OBERON_NATIVE_PARSER the command line is parsed by ArgvParser instead of boost::program_options, in a
+     * single pass over views of argv, so argv has to outlive the ParseOutput.
+     *
      * @returns: the result of parsing the supplied command line arguments, see ParseOutput for details.
      * @throws CommandLineParsingError: if the subcommand specified in the command line does not exist in the system.
      * @throws CommandLineParsingError: if command line is non conformant
@@ -110,7 +134,12 @@ namespace oberon
 
   private: // methods
     std::vector<std::string> prepareCommandLine(const std::vector<boost::program_options::option>& options,
-                                                const std::vector<std::string>& posOptions);
+                                                std::vector<std::string> posOptions);
+
+    /** parseCommandLine() with ArgvParser: the subcommand is found with the application's parser and the rest of the
+     *  tokens are left for the subcommand's, which is built on first use and kept
+     */
+    ParseOutput parseTokens(ArgvParser::Tokens tokens);
 
   private: // data
     SubcommandCollection applicationSubcommands_;
@@ -118,6 +147,9 @@ namespace oberon
     boost::program_options::options_description subcommandOptions_;
     boost::program_options::positional_options_description subcommandPositionalOptions_;
     boost::program_options::positional_options_description visiblePositionalOptions_;
+    boost::program_options::options_description parseOptions_; // every option a command line may use, built once
+    std::shared_ptr<const ArgvParser> applicationParser_;
+    std::map<std::string, std::shared_ptr<const ArgvParser> > subcommandParsers_;
 
     std::string applicationDescription_;
     std::string applicationName_;
@@ -2,7 +2,9 @@
 
 #include "GenericHelpSubcommand.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <unordered_set>
 
 namespace
 {
@@ -29,15 +31,17 @@ namespace oberon {
   {
     assert( ! registrationsFinalised_ && "Attempt to close registrations twice!");
     assert( ! subcommandFactory_.hasRegistration(HELP_SUBCOMMAND_KEY) && "Attempt to finalise with help already added!");
-    std::vector<std::string> subcommandNames = subcommandFactory_.registeredIndexes();
+    std::vector<std::string> subcommandNames = allSubcommandKeys();
     auto helpCreator = [subcommandNames]()
     {
       return SubcommandPtr( new GenericHelpSubcommand(subcommandNames) );
     }; // lambda
 
     subcommandFactory_.registerCreator(HELP_SUBCOMMAND_KEY, helpCreator);
+    optionRegistry_.reset();
 
     registrationsFinalised_ = true;
+    allUniqueOptions();
   }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -48,63 +52,122 @@ namespace oberon {
     {
       throw std::runtime_error("Attempt to register subcommand: " + key + ", after registrations were closed");
     }
+    if ( tableSubcommand(key) )
+    {
+      throw std::runtime_error("Attempt to register subcommand: " + key + ", which a subcommand table already has");
+    }
 
     subcommandFactory_.registerCreator(key, creatorMethod);
+    optionRegistry_.reset();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void SubcommandCollection::add(const boost::shared_ptr<SubcommandTableBase>& table)
+  {
+    for (const SubcommandTableBase::Entry& entry : *table)
+    {
+      std::string key = entry.name_.to_string();
+      if ( registrationsFinalised_ )
+      {
+        throw std::runtime_error("Attempt to register subcommand: " + key + ", after registrations were closed");
+      }
+      if ( exists(key) )
+      {
+        throw std::runtime_error("Attempt to register subcommand: " + key + ", which is already registered");
+      }
+    }
+
+    tables_.push_back(table);
+    optionRegistry_.reset();
   }
 
 //----------------------------------------------------------------------------------------------------------------------
-  std::vector<SubcommandCollection::SubcommandPtr> SubcommandCollection::allSubcommands()
+  std::vector<SubcommandCollection::SubcommandHandle> SubcommandCollection::allSubcommands()
   {
-    std::vector<SubcommandPtr> subcommands;
-    for (auto index : subcommandFactory_.registeredIndexes())
+    std::vector<SubcommandHandle> subcommands;
+    for (auto index : allSubcommandKeys())
     {
-      subcommands.push_back( subcommandFactory_.get(index) );
+      subcommands.push_back( getSubcommand(index) );
     }
     return subcommands;
   }
 
 //----------------------------------------------------------------------------------------------------------------------
-  SubcommandCollection::SubcommandPtr SubcommandCollection::getSubcommand(const std::string& subcommandName)
+  SubcommandCollection::SubcommandHandle SubcommandCollection::getSubcommand(const std::string& subcommandName)
   {
-    return subcommandFactory_.get(subcommandName);
+    if ( SubcommandHandle subcommand = tableSubcommand(subcommandName) )
+    {
+      return subcommand;
+    }
+    return SubcommandHandle( subcommandFactory_.get(subcommandName) );
   }
 
 //----------------------------------------------------------------------------------------------------------------------
   bool SubcommandCollection::exists(const std::string& subcommandName)
   {
-    return subcommandFactory_.hasRegistration(subcommandName);
+    return tableSubcommand(subcommandName) || subcommandFactory_.hasRegistration(subcommandName);
   }
 
 //----------------------------------------------------------------------------------------------------------------------
   std::vector<std::string> SubcommandCollection::allSubcommandKeys()
   {
-    return subcommandFactory_.registeredIndexes();
+    std::vector<std::string> keys = subcommandFactory_.registeredIndexes();
+    for (const boost::shared_ptr<SubcommandTableBase>& table : tables_)
+    {
+      for (const SubcommandTableBase::Entry& entry : *table)
+      {
+        keys.push_back(entry.name_.to_string());
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
   }
 
 //----------------------------------------------------------------------------------------------------------------------
-  po::options_description SubcommandCollection::allUniqueOptions()
+  const po::options_description& SubcommandCollection::allUniqueOptions()
   {
-    po::options_description allUniqueOptions;
-    for (SubcommandPtr& subcommand : allSubcommands() )
+    if ( optionRegistry_ )
+    {
+      return *optionRegistry_;
+    }
+
+    std::shared_ptr<po::options_description> registry = std::make_shared<po::options_description>();
+    std::unordered_set<std::string> names;
+    for (SubcommandHandle& subcommand : allSubcommands() )
     {
-      allUniqueOptions.add(subcommand->uniqueOptions(INCLUDE_HIDDEN, DO_NOT_RESTRICT));
+      po::options_description uniqueOptions = subcommand->uniqueOptions(INCLUDE_HIDDEN, DO_NOT_RESTRICT);
+      registry->add(uniqueOptions);
+      for ( const boost::shared_ptr<po::option_description>& option : uniqueOptions.options() )
+      {
+        names.insert(option->long_name());
+      }
 
-      /** Have to make a local here as program_options returns const&'s and the temporary explodes in a range based for */
-      std::vector<boost::shared_ptr<po::option_description> > subcommandSharedOptions = subcommand->sharedOptions(DO_NOT_RESTRICT).options();
-      for ( boost::shared_ptr<po::option_description> option : subcommandSharedOptions )
+      /** A shared option is added the first time its name is seen, every subcommand after that has the same one */
+      po::options_description sharedOptions = subcommand->sharedOptions(DO_NOT_RESTRICT);
+      for ( const boost::shared_ptr<po::option_description>& option : sharedOptions.options() )
       {
-        std::vector<boost::shared_ptr<po::option_description> > allRawOptions = allUniqueOptions.options();
-        auto result = std::find_if(allRawOptions.begin(),
-                                   allRawOptions.end(),
-                                   [&option](boost::shared_ptr<po::option_description> o) {return o->long_name() == option->long_name();});
-        if ( result == allRawOptions.end() )
+        if ( names.insert(option->long_name()).second )
         {
-          allUniqueOptions.add(option);
+          registry->add(option);
         }
       }
     }
 
-    return allUniqueOptions;
+    optionRegistry_ = registry;
+    return *optionRegistry_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  SubcommandCollection::SubcommandHandle SubcommandCollection::tableSubcommand(const std::string& subcommandName) const
+  {
+    for (const boost::shared_ptr<SubcommandTableBase>& table : tables_)
+    {
+      if ( Subcommand* subcommand = table->find(subcommandName) )
+      {
+        return SubcommandHandle(table, subcommand); // aliases the table, nothing is allocated
+      }
+    }
+    return SubcommandHandle();
   }
 
 //----------------------------------------------------------------------------------------------------------------------
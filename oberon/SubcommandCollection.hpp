@@ -4,6 +4,7 @@
 #include "OptionCollection.hpp"
 #include "Subcommand.hpp"
 #include "GenericFactory.hpp"
+#include "SubcommandTable.hpp"
 
 #include "boost/program_options.hpp"
 
@@ -15,6 +16,9 @@ namespace oberon
 {
 //**********************************************************************************************************************
   /** A factory for subcommands with a number of convenience methods for extraction and integrated support for help display.
+   *
+   * Subcommands come from tables of subcommands built once, see SubcommandTable, and from creator methods registered
+   * one at a time for those only known at run time. A name can only be registered once across both.
    */
   class SubcommandCollection
   {
@@ -22,6 +26,9 @@ namespace oberon
     typedef std::unique_ptr<Subcommand> SubcommandPtr;
     typedef std::function<SubcommandPtr()> SubcommandCreator;
 
+    /** A subcommand to use, one of a table's shares that table's ownership, one from a creator is its own */
+    typedef boost::shared_ptr<Subcommand> SubcommandHandle;
+
   public: // interface
     SubcommandCollection();
 
@@ -29,26 +36,44 @@ namespace oberon
      *
      * This should be called when all regular registrations have been completed, it's primary purpose is to add a
      * help subcommand that can provide information on the other registered subcommands and once this has been done
-     * it doesn't make sense to allow further registrations.
+     * it doesn't make sense to allow further registrations. The option registry is built here, once, rather than by
+     * constructing every subcommand on each parse.
      */
     void finaliseRegistrations();
 
     /** @throws std::runtime_error: if requested subcommand is already registered or registrations are closed */
     void add(const std::string& key, SubcommandCreator creatorMethod);
 
+    /** Register every subcommand in the table, which are looked up ahead of the creator methods
+     *
+     * @throws std::runtime_error: if a subcommand in the table is already registered or registrations are closed
+     */
+    void add(const boost::shared_ptr<SubcommandTableBase>& table);
+
     /** @throws std::runtime_error: if requested subcommand is not registered */
-    SubcommandPtr getSubcommand(const std::string& subcommandName);
+    SubcommandHandle getSubcommand(const std::string& subcommandName);
 
-    std::vector<SubcommandPtr> allSubcommands();
+    std::vector<SubcommandHandle> allSubcommands();
 
     bool exists(const std::string& subcommandName);
     std::vector<std::string> allSubcommandKeys();
 
-    boost::program_options::options_description allUniqueOptions();
+    /** Every option of every subcommand, shared options once, from the registry built when registrations are finalised
+     *
+     * Before that it is built on demand and kept until the next registration.
+     */
+    const boost::program_options::options_description& allUniqueOptions();
+
+  private: // methods
+    /** The table subcommand with this name, shared with its table, or null if no table has one */
+    SubcommandHandle tableSubcommand(const std::string& subcommandName) const;
 
   private: // data
     GenericFactory<SubcommandPtr, std::string> subcommandFactory_;
+    std::vector<boost::shared_ptr<SubcommandTableBase> > tables_;
     bool registrationsFinalised_;
+    /** Every option, immutable once built, so copies of the collection share it */
+    std::shared_ptr<const boost::program_options::options_description> optionRegistry_;
 
   }; // class
 
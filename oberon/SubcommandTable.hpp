@@ -0,0 +1,149 @@
+#ifndef OBERON_SUBCOMMANDTABLE_HPP
+#define OBERON_SUBCOMMANDTABLE_HPP
+
+#include "Subcommand.hpp"
+
+#include "boost/make_shared.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/utility/string_view.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace oberon
+{
+//**********************************************************************************************************************
+  /** Lookup side of a SubcommandTable, what a SubcommandCollection holds without knowing the table's types
+   */
+  class SubcommandTableBase
+  {
+  public: // types
+    struct Entry
+    {
+      boost::string_view name_; // the subcommand's own name, so the entry never outlives it
+      Subcommand* subcommand_;
+
+    }; // struct
+
+  public: // interface
+    virtual ~SubcommandTableBase() {}
+
+    SubcommandTableBase(const SubcommandTableBase&) = delete;
+    SubcommandTableBase& operator=(const SubcommandTableBase&) = delete;
+
+    /** @returns: the subcommand selected by this name, null if the table has none. */
+    Subcommand* find(boost::string_view name) const
+    {
+      const Entry* entry = std::lower_bound(begin_, end_, name, [](const Entry& e, boost::string_view n)
+                                                                { return e.name_ < n; });
+      return entry != end_ && entry->name_ == name ? entry->subcommand_ : nullptr;
+    }
+
+    /** Entries in name order */
+    const Entry* begin() const { return begin_; }
+    const Entry* end() const   { return end_; }
+
+  protected: // methods
+    SubcommandTableBase() : begin_(nullptr), end_(nullptr) {}
+
+    /** Sort the entries by name once they are filled in
+     *
+     * @throws std::runtime_error: if two subcommands have the same name.
+     */
+    void index(Entry* begin, Entry* end)
+    {
+      std::sort(begin, end, [](const Entry& a, const Entry& b) { return a.name_ < b.name_; });
+      const Entry* duplicate = std::adjacent_find(begin, end, [](const Entry& a, const Entry& b)
+                                                              { return a.name_ == b.name_; });
+      if ( duplicate != end )
+      {
+        throw std::runtime_error("Subcommand: " + duplicate->name_.to_string() + ", is in the table twice");
+      }
+      begin_ = begin;
+      end_ = end;
+    }
+
+  private: // data
+    const Entry* begin_;
+    const Entry* end_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** True if every type is a Subcommand */
+  template <typename... T_Types>
+  struct AreSubcommands : std::true_type {};
+
+  template <typename T_First, typename... T_Rest>
+  struct AreSubcommands<T_First, T_Rest...> :
+    std::integral_constant<bool, std::is_base_of<Subcommand, T_First>::value && AreSubcommands<T_Rest...>::value> {};
+
+//**********************************************************************************************************************
+  /** A fixed set of subcommands, each constructed once and held by value, dispatched through a sorted name index
+   *
+   * The alternative to registering a creator per subcommand with SubcommandCollection::add(): the set is known at
+   * compile time, so the table is one object holding every subcommand and a std::array of entries, with no creator
+   * to call and no subcommand constructed again to list options or show help. Lookups are a binary search of the
+   * entries and allocate nothing, the handles they return share the table's ownership. Building the table does
+   * allocate: makeSubcommandTable() puts it on the heap, and each subcommand copied in brings its own copies of its
+   * name, usage and OptionCollection, once per process. Creators registered with add() remain available for
+   * subcommands only known at run time.
+   */
+  template <typename... T_Subcommands>
+  class SubcommandTable : public SubcommandTableBase
+  {
+    static_assert(sizeof...(T_Subcommands) > 0, "A subcommand table needs a subcommand");
+    static_assert(AreSubcommands<T_Subcommands...>::value, "A subcommand table only holds Subcommands");
+
+  public: // interface
+    /** @throws std::runtime_error: if two subcommands have the same name. */
+    SubcommandTable(const T_Subcommands&... subcommands) :
+      subcommands_(subcommands...)
+    {
+      fill<0>();
+      index(entries_.data(), entries_.data() + entries_.size());
+    }
+
+  private: // methods
+    template <size_t I_Index>
+    typename std::enable_if<I_Index < sizeof...(T_Subcommands)>::type fill()
+    {
+      Subcommand& subcommand = std::get<I_Index>(subcommands_);
+      entries_[I_Index].name_ = subcommand.name();
+      entries_[I_Index].subcommand_ = &subcommand;
+      fill<I_Index + 1>();
+    }
+
+    template <size_t I_Index>
+    typename std::enable_if<I_Index == sizeof...(T_Subcommands)>::type fill() {}
+
+  private: // data
+    std::tuple<T_Subcommands...> subcommands_;
+    std::array<Entry, sizeof...(T_Subcommands)> entries_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Build a table from its subcommands, for SubcommandCollection::add(), with the types deduced
+   *
+   * The table and its shared count are one heap allocation, made once.
+   *
+   * @throws std::runtime_error: if two subcommands have the same name.
+   */
+  template <typename... T_Subcommands>
+  boost::shared_ptr<SubcommandTable<T_Subcommands...> > makeSubcommandTable(const T_Subcommands&... subcommands)
+  {
+    return boost::make_shared<SubcommandTable<T_Subcommands...> >(subcommands...);
+  }
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // OBERON_SUBCOMMANDTABLE_HPP
@@ -1,6 +1,15 @@
+newoption {
+    trigger     = "native-parser",
+    description = "Parse command lines with oberon's ArgvParser rather than boost::program_options"
+}
+
 solution "Solution"
     location("builds")
     configurations { "Debug", "Release" }
+
+    if _OPTIONS["native-parser"] then
+        defines { "OBERON_NATIVE_PARSER" }
+    end
     
 -----------------------------------------------------------------------------------------------------------------------
 project "oberon"
@@ -34,7 +43,39 @@ project "oberon"
                  
     -- boost auto-linking takes care of our links specification on windows
 
+-----------------------------------------------------------------------------------------------------------------------
+project "userstore"
+    language "C++"
+    kind "StaticLib"
+
+    files { "userstore/*.cpp", "userstore/*.hpp" }
+
+    libdirs { "boost/stage/lib" }
+
+    includedirs { "boost", "." }
+
+    targetdir( "builds/userstore")
+
+    configuration "Debug"
+        defines { "DEBUG" }
+        flags { "Symbols" }
+
+    configuration "Release"
+        defines { "NDEBUG" }
+        flags { "Optimize" }
+
+    configuration "gmake"
+         buildoptions { "-std=c++11" }
+
+         links { "boost_filesystem",
+                 "boost_system" }
+
 -----------------------------------------------------------------------------------------------------------------------
 
 include "application/radosgw-admin"
 
+include "application/userstore-bench"
+
+include "application/admin-mock"
+
+include "application/oberon-bench"
@@ -0,0 +1,193 @@
+#include "CuckooFilter.hpp"
+
+#include "Utils.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+  const char FILTER_MAGIC[8] = { 'R', 'G', 'W', 'U', 'F', 'L', 'T', '1' };
+  const uint32_t FILTER_VERSION = 1;
+
+  const uint64_t MINIMUM_BUCKETS = 256;
+
+  /** Inserts fail once entries pass 9/10 of the slots, well before the kicks start to run long */
+  const uint64_t MAX_LOAD_NUMERATOR = 9;
+  const uint64_t MAX_LOAD_DENOMINATOR = 10;
+
+  const unsigned MAX_KICKS = 500;
+
+  const uint64_t FINGERPRINT_MULTIPLIER = 0x5BD1E9955BD1E995ULL;
+
+  uint64_t bucketsFor(uint64_t entries, size_t bucketSlots)
+  {
+    uint64_t buckets = MINIMUM_BUCKETS;
+    while ( buckets * bucketSlots * MAX_LOAD_NUMERATOR < entries * 2 * MAX_LOAD_DENOMINATOR )
+    {
+      buckets *= 2;
+    }
+    return buckets;
+  }
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  CuckooFilter::CuckooFilter(const std::string& path, bool writable) :
+    path_(path)
+  {
+    file_.reset( new MappedFile(path_, writable) );
+    if ( writable && file_->size() == 0 )
+    {
+      file_->resize(sizeof(Header) + MINIMUM_BUCKETS * sizeof(Bucket));
+      initialise(*file_, MINIMUM_BUCKETS);
+    }
+    validate();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool CuckooFilter::mayContain(uint64_t hash) const
+  {
+    const Fingerprint print = fingerprint(hash);
+    const uint64_t first = hash & (header()->bucketCount_ - 1);
+    const Bucket& one = buckets()[first];
+    const Bucket& other = buckets()[alternateBucket(first, print)];
+
+    bool found = false;
+    for (size_t slot = 0; slot < BUCKET_SLOTS; ++slot)
+    {
+      found |= one.slots_[slot] == print;
+      found |= other.slots_[slot] == print;
+    }
+    return found;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool CuckooFilter::insert(uint64_t hash)
+  {
+    if ( (size() + 1) * MAX_LOAD_DENOMINATOR > header()->bucketCount_ * BUCKET_SLOTS * MAX_LOAD_NUMERATOR )
+    {
+      return false;
+    }
+
+    Fingerprint print = fingerprint(hash);
+    uint64_t bucket = hash & (header()->bucketCount_ - 1);
+    for (unsigned kick = 0; kick <= MAX_KICKS; ++kick)
+    {
+      for (uint64_t candidate : { bucket, alternateBucket(bucket, print) })
+      {
+        for (Fingerprint& slot : buckets()[candidate].slots_)
+        {
+          if ( slot == EMPTY_SLOT )
+          {
+            slot = print;
+            ++header()->count_;
+            return true;
+          }
+        }
+      }
+
+      /** Both buckets are full, evict an entry from one of them to its other bucket and place this one instead */
+      uint64_t victim = header()->kicks_++;
+      bucket = victim & BUCKET_SLOTS ? alternateBucket(bucket, print) : bucket;
+      std::swap(print, buckets()[bucket].slots_[victim % BUCKET_SLOTS]);
+      bucket = alternateBucket(bucket, print);
+    }
+    return false;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void CuckooFilter::erase(uint64_t hash)
+  {
+    const Fingerprint print = fingerprint(hash);
+    const uint64_t first = hash & (header()->bucketCount_ - 1);
+    for (uint64_t candidate : { first, alternateBucket(first, print) })
+    {
+      for (Fingerprint& slot : buckets()[candidate].slots_)
+      {
+        if ( slot == print )
+        {
+          slot = EMPTY_SLOT;
+          --header()->count_;
+          return;
+        }
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void CuckooFilter::reset(uint64_t expectedEntries)
+  {
+    uint64_t indexedEnd = header()->indexedEnd_;
+
+    std::string sidePath = path_ + ".tmp";
+    std::remove(sidePath.c_str());
+    {
+      uint64_t bucketCount = bucketsFor(expectedEntries, BUCKET_SLOTS);
+      MappedFile side(sidePath, true, sizeof(Header) + bucketCount * sizeof(Bucket));
+      initialise(side, bucketCount);
+      reinterpret_cast<Header*>(side.data())->indexedEnd_ = indexedEnd;
+    }
+
+    if ( std::rename(sidePath.c_str(), path_.c_str()) != 0 )
+    {
+      throw systemError("Unable to replace filter file", path_);
+    }
+    file_.reset( new MappedFile(path_, true) );
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** The fingerprint and bucket choice are persisted in the filter file, changing them needs a FILTER_VERSION bump.
+   *  The fingerprint comes from the top bits, the first bucket from the bottom ones, so the two don't correlate.
+   */
+  CuckooFilter::Fingerprint CuckooFilter::fingerprint(uint64_t hash)
+  {
+    Fingerprint print = static_cast<Fingerprint>(hash >> 48);
+    return print == EMPTY_SLOT ? 1 : print;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t CuckooFilter::alternateBucket(uint64_t bucket, Fingerprint print) const
+  {
+    /** An xor, so applying it to either bucket gives the other */
+    return (bucket ^ ((print * FINGERPRINT_MULTIPLIER) >> 32)) & (header()->bucketCount_ - 1);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void CuckooFilter::validate() const
+  {
+    const size_t fileSize = file_->size();
+    if ( fileSize < sizeof(Header) )
+    {
+      throw StoreError("Filter file is truncated: " + path_, path_);
+    }
+    if ( std::memcmp(header()->magic_, FILTER_MAGIC, sizeof(FILTER_MAGIC)) != 0 || header()->version_ != FILTER_VERSION )
+    {
+      throw StoreError("Not a supported user filter: " + path_, path_);
+    }
+
+    uint64_t bucketCount = header()->bucketCount_;
+    if ( bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0
+         || sizeof(Header) + bucketCount * sizeof(Bucket) > fileSize )
+    {
+      throw StoreError("Filter file is corrupt: " + path_, path_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void CuckooFilter::initialise(MappedFile& file, uint64_t bucketCount)
+  {
+    std::memset(file.data(), 0, sizeof(Header)); // the buckets of a freshly sized file are already zero
+
+    Header* header = reinterpret_cast<Header*>(file.data());
+    std::memcpy(header->magic_, FILTER_MAGIC, sizeof(FILTER_MAGIC));
+    header->version_ = FILTER_VERSION;
+    header->bucketCount_ = bucketCount;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,110 @@
+#ifndef USERSTORE_CUCKOOFILTER_HPP
+#define USERSTORE_CUCKOOFILTER_HPP
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Approximate set of key hashes kept in its own mapped file, answers "definitely absent" or "maybe present"
+   *
+   * A cuckoo filter: each entry is a 16 bit fingerprint of the hash stored in one of two buckets of four, the second
+   * bucket derived from the first and the fingerprint alone, so entries can be moved between them and removed again,
+   * which a Bloom filter can't do. A lookup reads two buckets and fewer than 1 in 8000 absent keys are reported as maybe
+   * present, at 2 bytes a slot, an eighth of what a HashIndex slot takes.
+   *
+   * Like HashIndex the filter is derived data, it records the data file size it was last consistent with and the owner
+   * is expected to rebuild it with reset() and insert() whenever that doesn't match. It can't grow on its own as the
+   * fingerprints don't hold enough of the hashes to place them in a bigger table, so an insert that doesn't fit fails
+   * and the owner rebuilds it bigger from the full hashes.
+   */
+  class CuckooFilter
+  {
+  public: // interface
+    /** Open the filter file, a writable open creates an empty filter if the file doesn't exist
+     *
+     * @throws StoreError: if the file can't be opened or is not a valid filter.
+     */
+    CuckooFilter(const std::string& path, bool writable);
+
+    CuckooFilter(const CuckooFilter&) = delete;
+    CuckooFilter& operator=(const CuckooFilter&) = delete;
+
+    /** @returns false only if no entry was inserted with the hash */
+    bool mayContain(uint64_t hash) const;
+
+    /** Add an entry, the same hash can be added more than once
+     *
+     * @returns false if the filter is too full to take it, the filter then no longer holds every entry and has to be
+     *          reset() with a larger size and refilled.
+     */
+    bool insert(uint64_t hash);
+
+    /** Remove one entry added with the hash, removing a hash that was never inserted can remove a different entry */
+    void erase(uint64_t hash);
+
+    /** Discard every entry and size the table for the expected number of entries */
+    void reset(uint64_t expectedEntries);
+
+    uint64_t indexedEnd() const              { return header()->indexedEnd_; }
+    void     setIndexedEnd(uint64_t dataEnd) { header()->indexedEnd_ = dataEnd; }
+
+    uint64_t size() const { return header()->count_; }
+
+    void sync() { file_->sync(); }
+
+  private: // types
+    struct Header
+    {
+      char     magic_[8];
+      uint32_t version_;
+      uint32_t flags_;
+      uint64_t bucketCount_; // always a power of two
+      uint64_t count_;
+      uint64_t indexedEnd_;  // data file size the entries are consistent with
+      uint64_t kicks_;       // entries moved to make room, picks which entry is moved next
+      uint8_t  reserved_[16];
+
+    }; // struct
+
+    typedef uint16_t Fingerprint;
+
+    static const size_t BUCKET_SLOTS = 4;
+    static const Fingerprint EMPTY_SLOT = 0;
+
+    struct Bucket
+    {
+      Fingerprint slots_[BUCKET_SLOTS];
+
+    }; // struct
+
+  private: // methods
+    Header*       header()       { return reinterpret_cast<Header*>(file_->data()); }
+    const Header* header() const { return reinterpret_cast<const Header*>(file_->data()); }
+
+    Bucket*       buckets()       { return reinterpret_cast<Bucket*>(file_->data() + sizeof(Header)); }
+    const Bucket* buckets() const { return reinterpret_cast<const Bucket*>(file_->data() + sizeof(Header)); }
+
+    static Fingerprint fingerprint(uint64_t hash);
+    uint64_t alternateBucket(uint64_t bucket, Fingerprint print) const;
+
+    void validate() const;
+
+    /** Write an empty header, the file must be freshly created so the buckets are zero */
+    static void initialise(MappedFile& file, uint64_t bucketCount);
+
+  private: // data
+    std::string path_;
+    std::unique_ptr<MappedFile> file_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_CUCKOOFILTER_HPP
@@ -0,0 +1,210 @@
+#include "HashIndex.hpp"
+
+#include "Utils.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+  const char INDEX_MAGIC[8] = { 'R', 'G', 'W', 'U', 'I', 'D', 'X', '1' };
+  const uint32_t INDEX_VERSION = 1;
+
+  const uint64_t MINIMUM_CAPACITY = 1024;
+
+  /** Grow once live entries plus tombstones pass 7/10 of the slots */
+  const uint64_t MAX_LOAD_NUMERATOR = 7;
+  const uint64_t MAX_LOAD_DENOMINATOR = 10;
+
+  const uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+  /** Murmur3 finaliser, spreads every input bit over the whole word */
+  uint64_t mix(uint64_t value)
+  {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+  }
+
+  uint64_t capacityFor(uint64_t entries)
+  {
+    uint64_t capacity = MINIMUM_CAPACITY;
+    while ( capacity * MAX_LOAD_NUMERATOR < entries * 2 * MAX_LOAD_DENOMINATOR )
+    {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  HashIndex::HashIndex(const std::string& path, bool writable) :
+    path_(path)
+  {
+    file_.reset( new MappedFile(path_, writable) );
+    if ( writable && file_->size() == 0 )
+    {
+      file_->resize(sizeof(Header) + MINIMUM_CAPACITY * sizeof(Slot));
+      initialise(*file_, MINIMUM_CAPACITY);
+    }
+    validate();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  /** The hash is persisted in the index file, changing it needs an INDEX_VERSION bump.
+   */
+  uint64_t HashIndex::hash(boost::string_view key)
+  {
+    uint64_t state = key.size() * HASH_MULTIPLIER;
+    const char* cursor = key.data();
+    size_t remaining = key.size();
+
+    for ( /* */ ; remaining >= sizeof(uint64_t); cursor += sizeof(uint64_t), remaining -= sizeof(uint64_t))
+    {
+      uint64_t word;
+      std::memcpy(&word, cursor, sizeof(word));
+      state = (state ^ mix(word)) * HASH_MULTIPLIER;
+    }
+    if ( remaining > 0 )
+    {
+      uint64_t word = 0;
+      std::memcpy(&word, cursor, remaining);
+      state = (state ^ mix(word)) * HASH_MULTIPLIER;
+    }
+
+    return mix(state);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HashIndex::insert(uint64_t hash, uint64_t offset)
+  {
+    if ( (header()->usedCount_ + 1) * MAX_LOAD_DENOMINATOR > capacity() * MAX_LOAD_NUMERATOR )
+    {
+      rehash(capacityFor(size() + 1));
+    }
+
+    Slot* table = slots();
+    const uint64_t mask = capacity() - 1;
+    for (uint64_t position = hash & mask; ; position = (position + 1) & mask)
+    {
+      Slot& slot = table[position];
+      if ( slot.offset_ == EMPTY_SLOT || slot.offset_ == TOMBSTONE_SLOT )
+      {
+        if ( slot.offset_ == EMPTY_SLOT )
+        {
+          ++header()->usedCount_; // reusing a tombstone doesn't consume a new slot
+        }
+        slot.hash_ = hash;
+        slot.offset_ = offset;
+        ++header()->liveCount_;
+        return;
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HashIndex::reset(uint64_t expectedEntries)
+  {
+    uint64_t indexedEnd = header()->indexedEnd_;
+
+    std::string sidePath = path_ + ".tmp";
+    std::remove(sidePath.c_str());
+    {
+      uint64_t newCapacity = capacityFor(expectedEntries);
+      MappedFile side(sidePath, true, sizeof(Header) + newCapacity * sizeof(Slot));
+      initialise(side, newCapacity);
+      reinterpret_cast<Header*>(side.data())->indexedEnd_ = indexedEnd;
+    }
+
+    if ( std::rename(sidePath.c_str(), path_.c_str()) != 0 )
+    {
+      throw systemError("Unable to replace index file", path_);
+    }
+    file_.reset( new MappedFile(path_, true) );
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HashIndex::rehash(uint64_t newCapacity)
+  {
+    std::string sidePath = path_ + ".tmp";
+    std::remove(sidePath.c_str());
+    {
+      MappedFile side(sidePath, true, sizeof(Header) + newCapacity * sizeof(Slot));
+      initialise(side, newCapacity);
+
+      Header* sideHeader = reinterpret_cast<Header*>(side.data());
+      Slot* sideSlots = reinterpret_cast<Slot*>(side.data() + sizeof(Header));
+
+      const Slot* table = slots();
+      for (uint64_t position = 0; position < capacity(); ++position)
+      {
+        if ( table[position].offset_ != EMPTY_SLOT && table[position].offset_ != TOMBSTONE_SLOT )
+        {
+          place(sideSlots, newCapacity, table[position].hash_, table[position].offset_);
+        }
+      }
+      sideHeader->usedCount_ = size();
+      sideHeader->liveCount_ = size();
+      sideHeader->indexedEnd_ = indexedEnd();
+    }
+
+    if ( std::rename(sidePath.c_str(), path_.c_str()) != 0 )
+    {
+      throw systemError("Unable to replace index file", path_);
+    }
+    file_.reset( new MappedFile(path_, true) );
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HashIndex::validate() const
+  {
+    const size_t fileSize = file_->size();
+    if ( fileSize < sizeof(Header) )
+    {
+      throw StoreError("Index file is truncated: " + path_, path_);
+    }
+    if ( std::memcmp(header()->magic_, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header()->version_ != INDEX_VERSION )
+    {
+      throw StoreError("Not a supported user index: " + path_, path_);
+    }
+
+    uint64_t slotCount = header()->capacity_;
+    if ( slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || sizeof(Header) + slotCount * sizeof(Slot) > fileSize )
+    {
+      throw StoreError("Index file is corrupt: " + path_, path_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HashIndex::initialise(MappedFile& file, uint64_t capacity)
+  {
+    std::memset(file.data(), 0, sizeof(Header)); // the slots of a freshly sized file are already zero
+
+    Header* header = reinterpret_cast<Header*>(file.data());
+    std::memcpy(header->magic_, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header->version_ = INDEX_VERSION;
+    header->capacity_ = capacity;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void HashIndex::place(Slot* slots, uint64_t capacity, uint64_t hash, uint64_t offset)
+  {
+    const uint64_t mask = capacity - 1;
+    uint64_t position = hash & mask;
+    while ( slots[position].offset_ != EMPTY_SLOT )
+    {
+      position = (position + 1) & mask;
+    }
+    slots[position].hash_ = hash;
+    slots[position].offset_ = offset;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
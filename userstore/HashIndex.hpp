@@ -0,0 +1,208 @@
+#ifndef USERSTORE_HASHINDEX_HPP
+#define USERSTORE_HASHINDEX_HPP
+
+#include "MappedFile.hpp"
+
+#include "boost/utility/string_view.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Open addressing (linear probing) hash table from key hash to record offset, kept in its own mapped file
+   *
+   * The index only stores the full 64 bit hash and the offset of the record in the data file, so it is independent of
+   * the record layout. Callers supply a matcher that compares the key stored at a candidate offset, which is only
+   * consulted when the hashes are equal. Deleted entries leave a tombstone so probe chains stay intact; tombstones are
+   * dropped whenever the table grows.
+   *
+   * The index is derived data, it records the data file size it was last consistent with (see indexedEnd) and the
+   * owner is expected to rebuild it with reset() and insert() whenever that doesn't match.
+   */
+  class HashIndex
+  {
+  public: // interface
+    /** Open the index file, a writable open creates an empty index if the file doesn't exist
+     *
+     * @throws StoreError: if the file can't be opened or is not a valid index.
+     */
+    HashIndex(const std::string& path, bool writable);
+
+    HashIndex(const HashIndex&) = delete;
+    HashIndex& operator=(const HashIndex&) = delete;
+
+    static uint64_t hash(boost::string_view key);
+
+    /** @returns the offset of the first entry with the hash that the matcher accepts, or 0 if there is none
+     *
+     * @param matches: callable taking a record offset and returning true if the record holds the wanted key.
+     */
+    template <typename T_Matcher>
+    uint64_t find(uint64_t hash, const T_Matcher& matches) const;
+
+    /** Call the visitor with the offset of every entry with the hash, for keys that may have many entries
+     *
+     * @param visitor: callable taking a record offset, returning false to stop.
+     * @returns false if the visitor stopped the walk.
+     */
+    template <typename T_Visitor>
+    bool forEach(uint64_t hash, const T_Visitor& visitor) const;
+
+    /** Call the visitor with the hash of every entry, in table order
+     *
+     * @param visitor: callable taking a hash.
+     */
+    template <typename T_Visitor>
+    void forEachHash(const T_Visitor& visitor) const;
+
+    /** Add an entry, growing the table if it is getting full. Duplicates are not detected here. */
+    void insert(uint64_t hash, uint64_t offset);
+
+    /** Replace the first matching entry with a tombstone
+     *
+     * @returns false if there was no matching entry.
+     */
+    template <typename T_Matcher>
+    bool erase(uint64_t hash, const T_Matcher& matches);
+
+    /** Discard every entry and size the table for the expected number of entries */
+    void reset(uint64_t expectedEntries);
+
+    uint64_t indexedEnd() const              { return header()->indexedEnd_; }
+    void     setIndexedEnd(uint64_t dataEnd) { header()->indexedEnd_ = dataEnd; }
+
+    uint64_t size() const     { return header()->liveCount_; }
+    uint64_t capacity() const { return header()->capacity_; }
+
+    void sync() { file_->sync(); }
+
+  private: // types
+    struct Header
+    {
+      char     magic_[8];
+      uint32_t version_;
+      uint32_t flags_;
+      uint64_t capacity_;    // number of slots, always a power of two
+      uint64_t usedCount_;   // live entries plus tombstones
+      uint64_t liveCount_;
+      uint64_t indexedEnd_;  // data file size the entries are consistent with
+      uint8_t  reserved_[16];
+
+    }; // struct
+
+    struct Slot
+    {
+      uint64_t hash_;
+      uint64_t offset_;
+
+    }; // struct
+
+    static const uint64_t EMPTY_SLOT = 0;
+    static const uint64_t TOMBSTONE_SLOT = 1;
+
+  private: // methods
+    Header*       header()       { return reinterpret_cast<Header*>(file_->data()); }
+    const Header* header() const { return reinterpret_cast<const Header*>(file_->data()); }
+
+    Slot*       slots()       { return reinterpret_cast<Slot*>(file_->data() + sizeof(Header)); }
+    const Slot* slots() const { return reinterpret_cast<const Slot*>(file_->data() + sizeof(Header)); }
+
+    /** Rebuild the table with a new capacity in a side file and rename it into place */
+    void rehash(uint64_t newCapacity);
+
+    void validate() const;
+
+    /** Write an empty header, the file must be freshly created so the slots are zero */
+    static void initialise(MappedFile& file, uint64_t capacity);
+    static void place(Slot* slots, uint64_t capacity, uint64_t hash, uint64_t offset);
+
+  private: // data
+    std::string path_;
+    std::unique_ptr<MappedFile> file_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+namespace userstore {
+
+  template <typename T_Matcher>
+  uint64_t HashIndex::find(uint64_t hash, const T_Matcher& matches) const
+  {
+    const Slot* table = slots();
+    const uint64_t mask = capacity() - 1;
+    for (uint64_t position = hash & mask; ; position = (position + 1) & mask)
+    {
+      const Slot& slot = table[position];
+      if ( slot.offset_ == EMPTY_SLOT )
+      {
+        return 0;
+      }
+      if ( slot.offset_ != TOMBSTONE_SLOT && slot.hash_ == hash && matches(slot.offset_) )
+      {
+        return slot.offset_;
+      }
+    }
+  }
+
+  template <typename T_Visitor>
+  bool HashIndex::forEach(uint64_t hash, const T_Visitor& visitor) const
+  {
+    const Slot* table = slots();
+    const uint64_t mask = capacity() - 1;
+    for (uint64_t position = hash & mask; ; position = (position + 1) & mask)
+    {
+      const Slot& slot = table[position];
+      if ( slot.offset_ == EMPTY_SLOT )
+      {
+        return true;
+      }
+      if ( slot.offset_ != TOMBSTONE_SLOT && slot.hash_ == hash && ! visitor(slot.offset_) )
+      {
+        return false;
+      }
+    }
+  }
+
+  template <typename T_Visitor>
+  void HashIndex::forEachHash(const T_Visitor& visitor) const
+  {
+    const Slot* table = slots();
+    for (uint64_t position = 0; position < capacity(); ++position)
+    {
+      if ( table[position].offset_ != EMPTY_SLOT && table[position].offset_ != TOMBSTONE_SLOT )
+      {
+        visitor(table[position].hash_);
+      }
+    }
+  }
+
+  template <typename T_Matcher>
+  bool HashIndex::erase(uint64_t hash, const T_Matcher& matches)
+  {
+    Slot* table = slots();
+    const uint64_t mask = capacity() - 1;
+    for (uint64_t position = hash & mask; ; position = (position + 1) & mask)
+    {
+      Slot& slot = table[position];
+      if ( slot.offset_ == EMPTY_SLOT )
+      {
+        return false;
+      }
+      if ( slot.offset_ != TOMBSTONE_SLOT && slot.hash_ == hash && matches(slot.offset_) )
+      {
+        slot.offset_ = TOMBSTONE_SLOT;
+        --header()->liveCount_;
+        return true;
+      }
+    }
+  }
+
+} // namespace
+
+#endif // USERSTORE_HASHINDEX_HPP
@@ -0,0 +1,485 @@
+#include "IoQueue.hpp"
+
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USERSTORE_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef USERSTORE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace
+{
+  using userstore::IoQueue;
+
+//**********************************************************************************************************************
+  /** One system call per operation, in the order they were queued
+   */
+  class SynchronousQueue : public IoQueue
+  {
+  public: // interface
+    Backend backend() const { return Backend::Synchronous; }
+
+    void registerFile(int fd) {}
+    void unregisterFile(int fd) {}
+    void registerBuffer(char* data, size_t size) {}
+
+    void submit()
+    {
+      std::vector<Operation> operations;
+      operations.swap(queued_);
+
+      const Operation* failed = nullptr;
+      int failure = 0;
+      for (const Operation& operation : operations)
+      {
+        int error = runSynchronously(operation);
+        if ( error && ! failed )
+        {
+          failed = &operation;
+          failure = error;
+        }
+      }
+      if ( failed )
+      {
+        fail(*failed, failure);
+      }
+    }
+
+  }; // class
+
+#ifdef USERSTORE_HAVE_IO_URING
+//**********************************************************************************************************************
+  /** io_uring driven through its system calls directly, liburing isn't needed for the few operations used here
+   */
+  class UringQueue : public IoQueue
+  {
+  public: // interface
+    /** @returns null if the kernel refuses a ring or lacks any of the operations used */
+    static std::unique_ptr<IoQueue> open(unsigned depth)
+    {
+      io_uring_params parameters;
+      std::memset(&parameters, 0, sizeof(parameters));
+      int ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &parameters));
+      if ( ringFd < 0 )
+      {
+        return nullptr;
+      }
+
+      std::unique_ptr<UringQueue> queue( new UringQueue(ringFd, parameters) );
+      if ( ! queue->mapRings() || ! queue->supportsOperations() )
+      {
+        return nullptr;
+      }
+      return queue;
+    }
+
+    ~UringQueue()
+    {
+      if ( sqes_ != MAP_FAILED )
+      {
+        ::munmap(sqes_, parameters_.sq_entries * sizeof(io_uring_sqe));
+      }
+      if ( cqRing_ != MAP_FAILED && cqRing_ != sqRing_ )
+      {
+        ::munmap(cqRing_, cqRingSize_);
+      }
+      if ( sqRing_ != MAP_FAILED )
+      {
+        ::munmap(sqRing_, sqRingSize_);
+      }
+      ::close(ringFd_);
+    }
+
+    Backend backend() const { return Backend::Uring; }
+
+    void registerFile(int fd)
+    {
+      if ( std::find(files_.begin(), files_.end(), fd) == files_.end() )
+      {
+        files_.push_back(fd);
+        updateFiles();
+      }
+    }
+
+    void unregisterFile(int fd)
+    {
+      std::vector<int>::iterator file = std::find(files_.begin(), files_.end(), fd);
+      if ( file != files_.end() )
+      {
+        files_.erase(file);
+        updateFiles();
+      }
+    }
+
+    void registerBuffer(char* data, size_t size)
+    {
+      if ( buffer_ )
+      {
+        enter(IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        buffer_ = nullptr;
+      }
+
+      iovec region = { data, size };
+      if ( enter(IORING_REGISTER_BUFFERS, &region, 1) == 0 )
+      {
+        buffer_ = data;
+        bufferSize_ = size;
+      }
+    }
+
+    void submit()
+    {
+      std::vector<Operation> operations;
+      operations.swap(queued_);
+
+      std::vector<int> results(operations.size());
+      for (size_t first = 0; first < operations.size(); first += parameters_.sq_entries)
+      {
+        run(operations, first, std::min<size_t>(parameters_.sq_entries, operations.size() - first), results);
+      }
+
+      const Operation* failed = nullptr;
+      int failure = 0;
+      for (size_t index = 0; index < operations.size(); ++index)
+      {
+        const Operation& operation = operations[index];
+        int result = results[index];
+        int error = 0;
+        if ( result == -ECANCELED )
+        {
+          /** Its chain was cut by an earlier operation that failed or came up short, which has been dealt with */
+          error = runSynchronously(operation);
+        }
+        else if ( result < 0 )
+        {
+          error = -result;
+        }
+        else if ( operation.type_ != Operation::Type::Sync && static_cast<size_t>(result) < operation.length_ )
+        {
+          error = runSynchronously(operation, result);
+        }
+        else if ( operation.transferred_ )
+        {
+          *operation.transferred_ = result;
+        }
+
+        if ( error && ! failed )
+        {
+          failed = &operation;
+          failure = error;
+        }
+      }
+      if ( failed )
+      {
+        fail(*failed, failure);
+      }
+    }
+
+  private: // methods
+    UringQueue(int ringFd, const io_uring_params& parameters) :
+      ringFd_(ringFd),
+      parameters_(parameters),
+      sqRing_(MAP_FAILED),
+      cqRing_(MAP_FAILED),
+      sqes_(MAP_FAILED),
+      sqRingSize_(0),
+      cqRingSize_(0),
+      buffer_(nullptr),
+      bufferSize_(0)
+    {
+
+    }
+
+    int enter(unsigned opcode, const void* argument, unsigned count)
+    {
+      return static_cast<int>(::syscall(__NR_io_uring_register, ringFd_, opcode, argument, count));
+    }
+
+    bool mapRings()
+    {
+      sqRingSize_ = parameters_.sq_off.array + parameters_.sq_entries * sizeof(unsigned);
+      cqRingSize_ = parameters_.cq_off.cqes + parameters_.cq_entries * sizeof(io_uring_cqe);
+      bool single = parameters_.features & IORING_FEAT_SINGLE_MMAP;
+      if ( single )
+      {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+      }
+
+      sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+                       IORING_OFF_SQ_RING);
+      if ( sqRing_ == MAP_FAILED )
+      {
+        return false;
+      }
+      cqRing_ = single ? sqRing_ : ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          ringFd_, IORING_OFF_CQ_RING);
+      sqes_ = ::mmap(nullptr, parameters_.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+      return cqRing_ != MAP_FAILED && sqes_ != MAP_FAILED;
+    }
+
+    /** Plain reads and writes need 5.6, older kernels get the synchronous queue */
+    bool supportsOperations()
+    {
+      const unsigned PROBED_OPERATIONS = IORING_OP_LAST;
+      std::vector<char> memory(sizeof(io_uring_probe) + PROBED_OPERATIONS * sizeof(io_uring_probe_op), 0);
+      io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(memory.data());
+      if ( enter(IORING_REGISTER_PROBE, probe, PROBED_OPERATIONS) != 0 )
+      {
+        return false;
+      }
+
+      for (unsigned operation : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED,
+                                  IORING_OP_FSYNC })
+      {
+        if ( operation > probe->last_op || ! (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) )
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void updateFiles()
+    {
+      if ( filesRegistered_ )
+      {
+        enter(IORING_UNREGISTER_FILES, nullptr, 0);
+      }
+      filesRegistered_ = ! files_.empty()
+                         && enter(IORING_REGISTER_FILES, files_.data(), static_cast<unsigned>(files_.size())) == 0;
+    }
+
+    template <typename T>
+    T* ringField(void* ring, uint32_t offset) const
+    {
+      return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+    }
+
+    /** Submit count operations from first, which fit in the ring, and wait for all of them */
+    void run(const std::vector<Operation>& operations, size_t first, size_t count, std::vector<int>& results)
+    {
+      unsigned* sqTail = ringField<unsigned>(sqRing_, parameters_.sq_off.tail);
+      unsigned* sqHead = ringField<unsigned>(sqRing_, parameters_.sq_off.head);
+      unsigned sqMask = *ringField<unsigned>(sqRing_, parameters_.sq_off.ring_mask);
+      unsigned* sqArray = ringField<unsigned>(sqRing_, parameters_.sq_off.array);
+
+      unsigned tail = *sqTail;
+      for (size_t index = first; index < first + count; ++index)
+      {
+        unsigned slot = tail & sqMask;
+        prepare(operations, index, first + count, sqes()[slot]);
+        sqArray[slot] = slot;
+        ++tail;
+      }
+      __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+      unsigned* cqHead = ringField<unsigned>(cqRing_, parameters_.cq_off.head);
+      unsigned* cqTail = ringField<unsigned>(cqRing_, parameters_.cq_off.tail);
+      unsigned cqMask = *ringField<unsigned>(cqRing_, parameters_.cq_off.ring_mask);
+      io_uring_cqe* cqes = ringField<io_uring_cqe>(cqRing_, parameters_.cq_off.cqes);
+
+      size_t completed = 0;
+      while ( completed < count )
+      {
+        unsigned unsubmitted = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        long entered = ::syscall(__NR_io_uring_enter, ringFd_, unsubmitted, static_cast<unsigned>(count - completed),
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+        if ( entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+        {
+          throw userstore::systemError("Unable to submit file operations", *operations[first].path_);
+        }
+
+        unsigned head = *cqHead;
+        for (unsigned end = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE); head != end; ++head, ++completed)
+        {
+          const io_uring_cqe& completion = cqes[head & cqMask];
+          results[completion.user_data] = completion.res;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+      }
+    }
+
+    io_uring_sqe* sqes() { return static_cast<io_uring_sqe*>(sqes_); }
+
+    void prepare(const std::vector<Operation>& operations, size_t index, size_t end, io_uring_sqe& entry)
+    {
+      const Operation& operation = operations[index];
+      std::memset(&entry, 0, sizeof(entry));
+      entry.user_data = index;
+
+      std::vector<int>::const_iterator file = std::find(files_.begin(), files_.end(), operation.fd_);
+      if ( filesRegistered_ && file != files_.end() )
+      {
+        entry.fd = static_cast<int>(file - files_.begin());
+        entry.flags |= IOSQE_FIXED_FILE;
+      }
+      else
+      {
+        entry.fd = operation.fd_;
+      }
+
+      if ( operation.type_ == Operation::Type::Sync )
+      {
+        entry.opcode = IORING_OP_FSYNC;
+        entry.fsync_flags = IORING_FSYNC_DATASYNC;
+      }
+      else
+      {
+        bool fixed = buffer_ && operation.buffer_ >= buffer_ && operation.buffer_ + operation.length_ <= buffer_ + bufferSize_;
+        bool read = operation.type_ == Operation::Type::Read;
+        entry.opcode = fixed ? (read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED) :
+                                  (read ? IORING_OP_READ : IORING_OP_WRITE);
+        entry.addr = reinterpret_cast<uint64_t>(operation.buffer_);
+        entry.len = static_cast<uint32_t>(operation.length_);
+        entry.off = operation.offset_;
+        entry.buf_index = 0;
+      }
+
+      if ( index + 1 < end && chainsToSync(operations, index) )
+      {
+        entry.flags |= IOSQE_IO_LINK;
+      }
+    }
+
+    /** @returns true if the operations from this one on are all on its descriptor up to a sync */
+    static bool chainsToSync(const std::vector<Operation>& operations, size_t index)
+    {
+      for (size_t next = index + 1; next < operations.size() && operations[next].fd_ == operations[index].fd_; ++next)
+      {
+        if ( operations[next].type_ == Operation::Type::Sync )
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private: // data
+    int ringFd_;
+    io_uring_params parameters_;
+    void* sqRing_;
+    void* cqRing_;
+    void* sqes_;
+    size_t sqRingSize_;
+    size_t cqRingSize_;
+
+    std::vector<int> files_; // registered descriptors, by fixed file index
+    bool filesRegistered_ = false;
+    char* buffer_;           // registered region, null if there is none
+    size_t bufferSize_;
+
+  }; // class
+#endif
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<IoQueue> IoQueue::create(Backend preferred, unsigned depth)
+  {
+#ifdef USERSTORE_HAVE_IO_URING
+    if ( preferred == Backend::Uring )
+    {
+      if ( std::unique_ptr<IoQueue> queue = UringQueue::open(depth) )
+      {
+        return queue;
+      }
+    }
+#endif
+    return std::unique_ptr<IoQueue>( new SynchronousQueue() );
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void IoQueue::read(int fd, char* buffer, size_t length, uint64_t offset, const std::string& path,
+                     size_t* transferred)
+  {
+    Operation operation = { Operation::Type::Read, fd, buffer, length, offset, &path, transferred };
+    queued_.push_back(operation);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void IoQueue::write(int fd, const char* buffer, size_t length, uint64_t offset, const std::string& path)
+  {
+    Operation operation = { Operation::Type::Write, fd, const_cast<char*>(buffer), length, offset, &path, nullptr };
+    queued_.push_back(operation);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void IoQueue::sync(int fd, const std::string& path)
+  {
+    Operation operation = { Operation::Type::Sync, fd, nullptr, 0, 0, &path, nullptr };
+    queued_.push_back(operation);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  int IoQueue::runSynchronously(const Operation& operation, size_t alreadyTransferred)
+  {
+    if ( operation.type_ == Operation::Type::Sync )
+    {
+      while ( ::fdatasync(operation.fd_) != 0 )
+      {
+        if ( errno != EINTR )
+        {
+          return errno;
+        }
+      }
+      return 0;
+    }
+
+    size_t done = alreadyTransferred;
+    while ( done < operation.length_ )
+    {
+      ssize_t transferred = operation.type_ == Operation::Type::Read ?
+                              ::pread(operation.fd_, operation.buffer_ + done, operation.length_ - done,
+                                      operation.offset_ + done) :
+                                 ::pwrite(operation.fd_, operation.buffer_ + done, operation.length_ - done,
+                                          operation.offset_ + done);
+      if ( transferred < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        return errno;
+      }
+      if ( transferred == 0 ) // end of file, only reads get here
+      {
+        break;
+      }
+      done += transferred;
+    }
+
+    if ( operation.transferred_ )
+    {
+      *operation.transferred_ = done;
+    }
+    return 0;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void IoQueue::fail(const Operation& operation, int error)
+  {
+    static const char* const WHAT[] = { "Unable to read file", "Unable to write file", "Unable to sync file" };
+    errno = error;
+    throw systemError(WHAT[static_cast<int>(operation.type_)], *operation.path_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,106 @@
+#ifndef USERSTORE_IOQUEUE_HPP
+#define USERSTORE_IOQUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Batches of file reads, writes and syncs, submitted together and waited for together
+   *
+   * The Uring backend hands a whole batch to the kernel with a single io_uring_enter, so operations on different files
+   * are in flight at once and a batch costs one system call rather than one per operation. Descriptors used for many
+   * batches can be registered as fixed files and a memory region as a fixed buffer, saving the kernel looking them up
+   * and pinning them for every operation. Where io_uring isn't built in or the kernel refuses it (too old, disabled by
+   * sysctl or seccomp) the Synchronous backend runs the same batches one pread, pwrite or fdatasync at a time.
+   *
+   * Operations queued back to back on the same descriptor and ending in a sync run in order, so a sync flushes the
+   * writes queued just before it. Anything else may run in any order.
+   */
+  class IoQueue
+  {
+  public: // types
+    enum class Backend { Synchronous, Uring };
+
+  public: // interface
+    /** @param preferred: Uring falls back to Synchronous where io_uring is unavailable
+     *  @param depth: operations the kernel is handed at once, larger batches are submitted in several goes.
+     */
+    static std::unique_ptr<IoQueue> create(Backend preferred=Backend::Uring, unsigned depth=64);
+
+    virtual ~IoQueue() {}
+
+    IoQueue(const IoQueue&) = delete;
+    IoQueue& operator=(const IoQueue&) = delete;
+
+    virtual Backend backend() const = 0;
+
+    /** Register a descriptor many batches will use, it must be unregistered before it is closed. Registering is only
+     *  an optimisation, a descriptor the kernel won't take is used as it is. */
+    virtual void registerFile(int fd) = 0;
+    virtual void unregisterFile(int fd) = 0;
+
+    /** Register the memory transfers are mostly made to and from, replacing any region registered before. Transfers
+     *  elsewhere still work, and a region the kernel won't pin is used as it is. */
+    virtual void registerBuffer(char* data, size_t size) = 0;
+
+    /** Queue a read, a short read only happens at the end of the file
+     *
+     * @param path: of the file for error messages, must outlive submit().
+     * @param transferred: where to store the number of bytes read, if wanted.
+     */
+    void read(int fd, char* buffer, size_t length, uint64_t offset, const std::string& path,
+              size_t* transferred=nullptr);
+
+    /** Queue a write of the whole buffer */
+    void write(int fd, const char* buffer, size_t length, uint64_t offset, const std::string& path);
+
+    /** Queue an fdatasync */
+    void sync(int fd, const std::string& path);
+
+    size_t queued() const { return queued_.size(); }
+
+    /** Run every queued operation and wait for them all to finish, the queue is empty afterwards
+     *
+     * @throws StoreError: for the first operation that failed, the others have still finished.
+     */
+    virtual void submit() = 0;
+
+  protected: // types
+    struct Operation
+    {
+      enum class Type { Read, Write, Sync };
+
+      Type type_;
+      int fd_;
+      char* buffer_;
+      size_t length_;
+      uint64_t offset_;
+      const std::string* path_;
+      size_t* transferred_;
+
+    }; // struct
+
+  protected: // methods
+    IoQueue() {}
+
+    /** Run an operation with plain system calls, @returns 0 or the errno it failed with */
+    static int runSynchronously(const Operation& operation, size_t alreadyTransferred=0);
+
+    /** @throws StoreError: describing the operation failing with the errno */
+    static void fail(const Operation& operation, int error);
+
+  protected: // data
+    std::vector<Operation> queued_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_IOQUEUE_HPP
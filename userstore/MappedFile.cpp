@@ -0,0 +1,161 @@
+#include "MappedFile.hpp"
+
+#include "Utils.hpp"
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  MappedFile::MappedFile(const std::string& path, bool writable, size_t minimumSize) :
+    path_(path),
+    fd_(-1),
+    data_(nullptr),
+    size_(0),
+    writable_(writable)
+  {
+    fd_ = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT | O_CLOEXEC) : (O_RDONLY | O_CLOEXEC), 0644);
+    if ( fd_ < 0 )
+    {
+      throw systemError("Unable to open store file", path_);
+    }
+
+    struct stat fileInfo;
+    if ( ::fstat(fd_, &fileInfo) != 0 )
+    {
+      ::close(fd_);
+      throw systemError("Unable to stat store file", path_);
+    }
+    size_ = fileInfo.st_size;
+
+    if ( writable_ && size_ < minimumSize )
+    {
+      if ( ::ftruncate(fd_, minimumSize) != 0 )
+      {
+        ::close(fd_);
+        throw systemError("Unable to extend store file", path_);
+      }
+      size_ = minimumSize;
+    }
+
+    try
+    {
+      map();
+    }
+    catch (...)
+    {
+      ::close(fd_);
+      throw;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  MappedFile::~MappedFile()
+  {
+    unmap();
+    ::close(fd_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void MappedFile::resize(size_t newSize)
+  {
+    if ( ! writable_ )
+    {
+      throw StoreError("Attempt to resize a read only store file", path_);
+    }
+
+    unmap();
+    if ( ::ftruncate(fd_, newSize) != 0 )
+    {
+      throw systemError("Unable to resize store file", path_);
+    }
+    size_ = newSize;
+    map();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void MappedFile::sync()
+  {
+    if ( data_ && writable_ && ::msync(data_, size_, MS_SYNC) != 0 )
+    {
+      throw systemError("Unable to sync store file", path_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void MappedFile::sync(size_t offset, size_t length)
+  {
+    if ( ! data_ || ! writable_ )
+    {
+      return;
+    }
+
+    static const size_t PAGE_SIZE = ::sysconf(_SC_PAGESIZE);
+    size_t pageStart = offset - (offset % PAGE_SIZE);
+    if ( ::msync(data_ + pageStart, std::min(size_, offset + length) - pageStart, MS_SYNC) != 0 )
+    {
+      throw systemError("Unable to sync store file", path_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void MappedFile::map()
+  {
+    if ( size_ == 0 )
+    {
+      data_ = nullptr;
+      return;
+    }
+
+    void* mapping = ::mmap(nullptr, size_, writable_ ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd_, 0);
+    if ( mapping == MAP_FAILED )
+    {
+      data_ = nullptr;
+      throw systemError("Unable to map store file", path_);
+    }
+
+    data_ = static_cast<char*>(mapping);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void MappedFile::unmap()
+  {
+    if ( data_ )
+    {
+      ::munmap(data_, size_);
+      data_ = nullptr;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  FileLock::FileLock(const std::string& path, bool exclusive) :
+    fd_(-1)
+  {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if ( fd_ < 0 )
+    {
+      throw systemError("Unable to open lock file", path);
+    }
+
+    if ( ::flock(fd_, exclusive ? LOCK_EX : LOCK_SH) != 0 )
+    {
+      ::close(fd_);
+      throw systemError("Unable to lock store", path);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  FileLock::~FileLock()
+  {
+    ::close(fd_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,85 @@
+#ifndef USERSTORE_MAPPEDFILE_HPP
+#define USERSTORE_MAPPEDFILE_HPP
+
+#include <string>
+#include <cstddef>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** A file mapped shared into the address space of the process
+   *
+   * Writes through data() land directly in the page cache, so there is no load or save step; sync() is only needed
+   * when the caller wants the pages on stable storage. A read only mapping of an empty file has no data.
+   */
+  class MappedFile
+  {
+  public: // interface
+    /** Open and map a file
+     *
+     * @param minimumSize: writable files shorter than this are extended (zero filled) before mapping.
+     * @throws StoreError: if the file can't be opened, sized or mapped.
+     */
+    MappedFile(const std::string& path, bool writable, size_t minimumSize=0);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char*       data()       { return data_; }
+    const char* data() const { return data_; }
+    size_t      size() const { return size_; }
+
+    bool writable() const { return writable_; }
+    const std::string& path() const { return path_; }
+
+    /** Grow or shrink the file and remap it, pointers into the old mapping are invalidated
+     *
+     * @throws StoreError: if the mapping is read only or the resize fails.
+     */
+    void resize(size_t newSize);
+
+    /** Flush dirty pages of the mapping to stable storage */
+    void sync();
+
+    /** Flush only the pages covering the given byte range */
+    void sync(size_t offset, size_t length);
+
+  private: // methods
+    void map();
+    void unmap();
+
+  private: // data
+    std::string path_;
+    int fd_;
+    char* data_;
+    size_t size_;
+    bool writable_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Scoped advisory lock (flock) on a file, shared for readers and exclusive for writers
+   *
+   * The lock is held for the lifetime of the object and released when the descriptor is closed.
+   */
+  class FileLock
+  {
+  public: // interface
+    /** @throws StoreError: if the lock file can't be opened or locked */
+    FileLock(const std::string& path, bool exclusive);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+  private: // data
+    int fd_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_MAPPEDFILE_HPP
@@ -0,0 +1,242 @@
+#include "Record.hpp"
+
+#include "Utils.hpp"
+#include "Uuid.hpp"
+
+#include <cstring>
+
+namespace
+{
+  const size_t MAX_VARINT_SIZE = 10;
+
+  /** Flags plus the checksum, the part of a record after its size prefix that isn't payload */
+  const uint64_t RECORD_OVERHEAD = sizeof(uint8_t) + sizeof(uint32_t);
+
+  size_t varintSize(uint64_t value)
+  {
+    size_t size = 1;
+    for ( ; value >= 0x80; value >>= 7)
+    {
+      ++size;
+    }
+    return size;
+  }
+
+  /** Little endian base 128, 7 bits per byte with the high bit set on every byte but the last */
+  char* writeVarint(char* out, uint64_t value)
+  {
+    for ( ; value >= 0x80; value >>= 7)
+    {
+      *out++ = static_cast<char>((value & 0x7F) | 0x80);
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+  }
+
+  /** @returns the number of bytes read, or 0 if the varint runs past the available bytes or is too long */
+  size_t readVarint(const char* in, uint64_t available, uint64_t& value)
+  {
+    value = 0;
+    size_t limit = available < MAX_VARINT_SIZE ? available : MAX_VARINT_SIZE;
+    for (size_t size = 0; size < limit; ++size)
+    {
+      uint8_t byte = static_cast<uint8_t>(in[size]);
+      value |= static_cast<uint64_t>(byte & 0x7F) << (7 * size);
+      if ( ! (byte & 0x80) )
+      {
+        return size + 1;
+      }
+    }
+    return 0;
+  }
+
+  /** Take a [varint length][bytes] field off the front of the payload, @returns false if it doesn't fit */
+  bool readLengthPrefixed(boost::string_view& payload, boost::string_view& field)
+  {
+    uint64_t length;
+    size_t prefix = readVarint(payload.data(), payload.size(), length);
+    if ( ! prefix || length > payload.size() - prefix )
+    {
+      return false;
+    }
+    field = payload.substr(prefix, length);
+    payload.remove_prefix(prefix + length);
+    return true;
+  }
+
+  uint32_t recordChecksum(uint8_t flags, const char* payload, uint64_t payloadSize)
+  {
+    uint8_t checkedFlags = flags & ~userstore::RECORD_LIVE;
+    return userstore::crc32c(payload, payloadSize, userstore::crc32c(&checkedFlags, sizeof(checkedFlags)));
+  }
+
+  /** The varint that leads the display name, see Record.hpp */
+  uint64_t displayNameTag(const userstore::StoredUser& user)
+  {
+    return user.displayNameRecord_ ? user.displayNameRecord_ << 1 | 1 : user.displayName_.size() << 1;
+  }
+
+  size_t userPayloadSize(const userstore::StoredUser& user)
+  {
+    size_t uuidSize = user.binaryUuid_ ? userstore::UUID_BINARY_LENGTH : varintSize(user.uuid_.size()) + user.uuid_.size();
+    size_t displayNameSize = varintSize(displayNameTag(user)) + (user.displayNameRecord_ ? 0 : user.displayName_.size());
+    return uuidSize + displayNameSize + varintSize(user.email_.size()) + user.email_.size();
+  }
+
+  size_t recordSize(size_t payloadSize)
+  {
+    return varintSize(payloadSize + RECORD_OVERHEAD) + payloadSize + RECORD_OVERHEAD;
+  }
+
+  /** Write the size prefix and flags, @returns where the payload goes */
+  char* writeRecordStart(char* out, uint8_t flags, size_t payloadSize)
+  {
+    out = writeVarint(out, payloadSize + RECORD_OVERHEAD);
+    *out++ = static_cast<char>(flags);
+    return out;
+  }
+
+  /** Write the checksum after the payload, @returns the end of the record */
+  char* writeRecordEnd(char* payload, uint8_t flags, size_t payloadSize)
+  {
+    uint32_t checksum = recordChecksum(flags, payload, payloadSize);
+    std::memcpy(payload + payloadSize, &checksum, sizeof(checksum));
+    return payload + payloadSize + sizeof(checksum);
+  }
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  RecordReader::RecordReader(const char* data, uint64_t offset, uint64_t end) :
+    data_(data),
+    offset_(offset),
+    end_(end),
+    torn_(false)
+  {
+
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool RecordReader::next(RecordFrame& frame)
+  {
+    if ( offset_ >= end_ )
+    {
+      return false;
+    }
+
+    uint64_t body;
+    size_t prefix = readVarint(data_ + offset_, end_ - offset_, body);
+    if ( ! prefix || body < RECORD_OVERHEAD || body > end_ - offset_ - prefix )
+    {
+      torn_ = true;
+      return false;
+    }
+
+    frame.offset_ = offset_;
+    frame.size_ = prefix + body;
+    frame.flags_ = static_cast<uint8_t>(data_[offset_ + prefix]);
+    frame.payload_ = data_ + offset_ + prefix + sizeof(uint8_t);
+    frame.payloadSize_ = body - RECORD_OVERHEAD;
+
+    offset_ += frame.size_;
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  RecordFrame RecordReader::frameAt(const char* data, uint64_t offset)
+  {
+    RecordFrame frame = RecordFrame();
+    RecordReader reader(data, offset, UINT64_MAX);
+    reader.next(frame);
+    return frame;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool checksumMatches(const RecordFrame& frame)
+  {
+    uint32_t stored;
+    std::memcpy(&stored, frame.payload_ + frame.payloadSize_, sizeof(stored));
+    return stored == recordChecksum(frame.flags_, frame.payload_, frame.payloadSize_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool decodeUser(const RecordFrame& frame, StoredUser& user)
+  {
+    boost::string_view payload(frame.payload_, frame.payloadSize_);
+    user.binaryUuid_ = frame.flags_ & RECORD_BINARY_UUID;
+    if ( user.binaryUuid_ )
+    {
+      if ( payload.size() < UUID_BINARY_LENGTH )
+      {
+        return false;
+      }
+      user.uuid_ = payload.substr(0, UUID_BINARY_LENGTH);
+      payload.remove_prefix(UUID_BINARY_LENGTH);
+    }
+    else if ( ! readLengthPrefixed(payload, user.uuid_) )
+    {
+      return false;
+    }
+
+    uint64_t tag;
+    size_t prefix = readVarint(payload.data(), payload.size(), tag);
+    if ( ! prefix )
+    {
+      return false;
+    }
+    payload.remove_prefix(prefix);
+    user.displayName_ = boost::string_view();
+    user.displayNameRecord_ = 0;
+    if ( tag & 1 )
+    {
+      user.displayNameRecord_ = tag >> 1;
+    }
+    else
+    {
+      if ( (tag >> 1) > payload.size() )
+      {
+        return false;
+      }
+      user.displayName_ = payload.substr(0, tag >> 1);
+      payload.remove_prefix(tag >> 1);
+    }
+
+    return readLengthPrefixed(payload, user.email_) && payload.empty();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t userRecordSize(const StoredUser& user)
+  {
+    return recordSize(userPayloadSize(user));
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t writeUserRecord(char* out, const StoredUser& user)
+  {
+    uint8_t flags = RECORD_LIVE | (user.binaryUuid_ ? RECORD_BINARY_UUID : 0);
+    size_t payloadSize = userPayloadSize(user);
+    char* payload = writeRecordStart(out, flags, payloadSize);
+
+    char* cursor = payload;
+    if ( ! user.binaryUuid_ )
+    {
+      cursor = writeVarint(cursor, user.uuid_.size());
+    }
+    std::memcpy(cursor, user.uuid_.data(), user.uuid_.size());
+    cursor = writeVarint(cursor + user.uuid_.size(), displayNameTag(user));
+    if ( ! user.displayNameRecord_ )
+    {
+      std::memcpy(cursor, user.displayName_.data(), user.displayName_.size());
+      cursor += user.displayName_.size();
+    }
+    cursor = writeVarint(cursor, user.email_.size());
+    std::memcpy(cursor, user.email_.data(), user.email_.size());
+
+    return writeRecordEnd(payload, flags, payloadSize) - out;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
@@ -0,0 +1,104 @@
+#ifndef USERSTORE_RECORD_HPP
+#define USERSTORE_RECORD_HPP
+
+#include "boost/utility/string_view.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Layout of the records in a store data file, from store version 2
+   *
+   * Each record is [varint size][uint8_t flags][payload][uint32_t crc32c], where size counts everything after itself.
+   * The checksum covers the flags and the payload, with the live flag masked out as deleting a user clears it in place.
+   * Records are packed back to back with no alignment, everything is read with memcpy.
+   *
+   * A user record's payload is the uuid, then the display name, then the email:
+   *  - a uuid in canonical text form is stored as its 16 bytes (flagged RECORD_BINARY_UUID), any other uuid as
+   *    [varint length][bytes].
+   *  - display names are interned. A varint tag with its low bit clear is followed by (tag >> 1) bytes of the name, with
+   *    it set (tag >> 1) is the offset of an earlier user record that holds the name itself. Only the first user to
+   *    take a name pays for its bytes, and a name nobody else has costs a single byte more than its text.
+   *  - the email is [varint length][bytes], emails are unique so there is nothing to share.
+   */
+  const uint8_t RECORD_LIVE = 0x1;
+  const uint8_t RECORD_BINARY_UUID = 0x2;
+
+  /** Where a record and its payload lie, as read from the size prefix and flags alone
+   */
+  struct RecordFrame
+  {
+    uint64_t offset_;      // of the record in the data
+    uint64_t size_;        // of the whole record, prefix to checksum
+    uint8_t flags_;
+    const char* payload_;
+    uint64_t payloadSize_;
+
+  }; // struct
+
+  /** The fields of a user record as stored, see decodeUser
+   */
+  struct StoredUser
+  {
+    boost::string_view uuid_;        // the UUID_BINARY_LENGTH bytes if binaryUuid_, otherwise the text
+    bool binaryUuid_;
+    boost::string_view displayName_; // when it is held by this record
+    uint64_t displayNameRecord_;     // offset of the record holding the display name, 0 if this one holds it
+    boost::string_view email_;
+
+  }; // struct
+
+//**********************************************************************************************************************
+  /** Walks the records in a range of the data file
+   *
+   * Stepping over a record only reads its size prefix and flags, nothing is decoded or checksummed unless the caller
+   * asks for it with checksumMatches() or decodeUser(), so skipping past records costs the same whatever they hold.
+   */
+  class RecordReader
+  {
+  public: // interface
+    RecordReader(const char* data, uint64_t offset, uint64_t end);
+
+    /** Frame the next record and move past it
+     *
+     * @returns false at the end of the range, or if the next record doesn't fit in what is left of it (see torn()).
+     */
+    bool next(RecordFrame& frame);
+
+    /** True if next() stopped because a record ran past the end of the range */
+    bool torn() const { return torn_; }
+
+    /** Offset of the next record */
+    uint64_t offset() const { return offset_; }
+
+    /** Frame the record at an offset known to hold an intact one, such as an index entry */
+    static RecordFrame frameAt(const char* data, uint64_t offset);
+
+  private: // data
+    const char* data_;
+    uint64_t offset_;
+    uint64_t end_;
+    bool torn_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+  bool checksumMatches(const RecordFrame& frame);
+
+  /** @returns false if the payload doesn't hold a user record's fields exactly */
+  bool decodeUser(const RecordFrame& frame, StoredUser& user);
+
+  size_t userRecordSize(const StoredUser& user);
+
+  /** Write a live user record, out must have room for userRecordSize()
+   *
+   * @returns the number of bytes written.
+   */
+  size_t writeUserRecord(char* out, const StoredUser& user);
+
+} // namespace
+
+#endif // USERSTORE_RECORD_HPP
@@ -0,0 +1,177 @@
+#include "UsageTable.hpp"
+
+#include "Utils.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+  const char USAGE_MAGIC[8] = { 'R', 'G', 'W', 'U', 'U', 'S', 'G', '1' };
+  const uint32_t USAGE_VERSION = 1;
+
+  const uint64_t MINIMUM_CAPACITY = 1024;
+
+  /** Grow once rows pass 7/10 of the table, as HashIndex does */
+  const uint64_t MAX_LOAD_NUMERATOR = 7;
+  const uint64_t MAX_LOAD_DENOMINATOR = 10;
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  UsageTable::UsageTable(const std::string& path, bool writable) :
+    path_(path)
+  {
+    static_assert(sizeof(Header) == 64, "UsageTable::Header is part of the on disk format");
+    static_assert(sizeof(Row) == 32, "UsageTable::Row is part of the on disk format");
+
+    file_.reset( new MappedFile(path_, writable) );
+    if ( writable && file_->size() == 0 )
+    {
+      file_->resize(sizeof(Header) + MINIMUM_CAPACITY * sizeof(Row));
+      initialise(*file_, MINIMUM_CAPACITY);
+    }
+    validate();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserUsage UsageTable::get(uint64_t hash) const
+  {
+    const Row& row = rows()[position(key(hash))];
+    return row.key_ == EMPTY_ROW ? UserUsage() : row.usage_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UsageTable::add(uint64_t hash, const UserUsage& delta)
+  {
+    if ( (size() + 1) * MAX_LOAD_DENOMINATOR > header()->capacity_ * MAX_LOAD_NUMERATOR )
+    {
+      rehash(header()->capacity_ * 2);
+    }
+
+    Row& row = rows()[position(key(hash))];
+    if ( row.key_ == EMPTY_ROW )
+    {
+      row.key_ = key(hash);
+      row.usage_ = UserUsage();
+      ++header()->count_;
+    }
+    row.usage_ += delta;
+    header()->totals_ += delta;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UsageTable::erase(uint64_t hash)
+  {
+    Row* table = rows();
+    const uint64_t mask = header()->capacity_ - 1;
+    uint64_t hole = position(key(hash));
+    if ( table[hole].key_ == EMPTY_ROW )
+    {
+      return;
+    }
+
+    header()->totals_ -= table[hole].usage_;
+    --header()->count_;
+
+    /** Move back each following row of the run whose home is at or before the hole, so every row stays reachable from
+     *  its home without tombstones */
+    for (uint64_t next = (hole + 1) & mask; table[next].key_ != EMPTY_ROW; next = (next + 1) & mask)
+    {
+      uint64_t home = table[next].key_ & mask;
+      if ( ((next - home) & mask) >= ((next - hole) & mask) )
+      {
+        table[hole] = table[next];
+        hole = next;
+      }
+    }
+    table[hole].key_ = EMPTY_ROW;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UsageTable::position(uint64_t key) const
+  {
+    const Row* table = rows();
+    const uint64_t mask = header()->capacity_ - 1;
+    uint64_t position = key & mask;
+    while ( table[position].key_ != EMPTY_ROW && table[position].key_ != key )
+    {
+      position = (position + 1) & mask;
+    }
+    return position;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UsageTable::rehash(uint64_t newCapacity)
+  {
+    std::string sidePath = path_ + ".tmp";
+    std::remove(sidePath.c_str());
+    {
+      MappedFile side(sidePath, true, sizeof(Header) + newCapacity * sizeof(Row));
+      initialise(side, newCapacity);
+
+      Header* sideHeader = reinterpret_cast<Header*>(side.data());
+      Row* sideRows = reinterpret_cast<Row*>(side.data() + sizeof(Header));
+      const uint64_t mask = newCapacity - 1;
+
+      const Row* table = rows();
+      for (uint64_t position = 0; position < header()->capacity_; ++position)
+      {
+        if ( table[position].key_ != EMPTY_ROW )
+        {
+          uint64_t placed = table[position].key_ & mask;
+          while ( sideRows[placed].key_ != EMPTY_ROW )
+          {
+            placed = (placed + 1) & mask;
+          }
+          sideRows[placed] = table[position];
+        }
+      }
+      sideHeader->count_ = size();
+      sideHeader->totals_ = totals();
+    }
+
+    if ( std::rename(sidePath.c_str(), path_.c_str()) != 0 )
+    {
+      throw systemError("Unable to replace usage file", path_);
+    }
+    file_.reset( new MappedFile(path_, true) );
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UsageTable::validate() const
+  {
+    const size_t fileSize = file_->size();
+    if ( fileSize < sizeof(Header) )
+    {
+      throw StoreError("Usage file is truncated: " + path_, path_);
+    }
+    if ( std::memcmp(header()->magic_, USAGE_MAGIC, sizeof(USAGE_MAGIC)) != 0 || header()->version_ != USAGE_VERSION )
+    {
+      throw StoreError("Not a supported usage table: " + path_, path_);
+    }
+
+    uint64_t rowCount = header()->capacity_;
+    if ( rowCount == 0 || (rowCount & (rowCount - 1)) != 0 || sizeof(Header) + rowCount * sizeof(Row) > fileSize
+         || header()->count_ >= rowCount )
+    {
+      throw StoreError("Usage file is corrupt: " + path_, path_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UsageTable::initialise(MappedFile& file, uint64_t capacity)
+  {
+    std::memset(file.data(), 0, sizeof(Header)); // the rows of a freshly sized file are already zero
+
+    Header* header = reinterpret_cast<Header*>(file.data());
+    std::memcpy(header->magic_, USAGE_MAGIC, sizeof(USAGE_MAGIC));
+    header->version_ = USAGE_VERSION;
+    header->capacity_ = capacity;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
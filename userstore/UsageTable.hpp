@@ -0,0 +1,131 @@
+#ifndef USERSTORE_USAGETABLE_HPP
+#define USERSTORE_USAGETABLE_HPP
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Usage counters of a user, or a change to them
+   */
+  struct UserUsage
+  {
+    UserUsage() : objects_(0), bytes_(0), ops_(0) {}
+
+    UserUsage& operator+=(const UserUsage& other)
+    {
+      objects_ += other.objects_;
+      bytes_ += other.bytes_;
+      ops_ += other.ops_;
+      return *this;
+    }
+
+    UserUsage& operator-=(const UserUsage& other)
+    {
+      objects_ -= other.objects_;
+      bytes_ -= other.bytes_;
+      ops_ -= other.ops_;
+      return *this;
+    }
+
+    int64_t  objects_;
+    int64_t  bytes_;
+    uint64_t ops_;
+
+  }; // struct
+
+//**********************************************************************************************************************
+  /** Usage counters by uuid hash, a table of fixed width rows kept in its own mapped file
+   *
+   * Rows are placed by linear probing on the uuid's 64 bit hash, which is all a row holds of the uuid, and removed by
+   * shifting the rows after them back so there are no tombstones. The header keeps the totals of every row, so a
+   * user's counters and the totals are both a read or two whatever the number of users.
+   *
+   * Unlike HashIndex the table is not derived data, nothing else holds the counters, so it is never reset. It is only
+   * as durable as its last sync().
+   */
+  class UsageTable
+  {
+  public: // interface
+    /** Open the table file, a writable open creates an empty table if the file doesn't exist
+     *
+     * @throws StoreError: if the file can't be opened or is not a valid usage table.
+     */
+    UsageTable(const std::string& path, bool writable);
+
+    UsageTable(const UsageTable&) = delete;
+    UsageTable& operator=(const UsageTable&) = delete;
+
+    /** @returns the counters of the user with the uuid hash, all zero if it has none */
+    UserUsage get(uint64_t hash) const;
+
+    /** Add a change to the counters of the user with the uuid hash, growing the table if it is getting full */
+    void add(uint64_t hash, const UserUsage& delta);
+
+    /** Drop the counters of the user with the uuid hash, taking them off the totals */
+    void erase(uint64_t hash);
+
+    UserUsage totals() const { return header()->totals_; }
+
+    uint64_t size() const { return header()->count_; }
+
+    void sync() { file_->sync(); }
+
+  private: // types
+    struct Header
+    {
+      char      magic_[8];
+      uint32_t  version_;
+      uint32_t  flags_;
+      uint64_t  capacity_; // number of rows, always a power of two
+      uint64_t  count_;
+      UserUsage totals_;
+      uint8_t   reserved_[8];
+
+    }; // struct
+
+    struct Row
+    {
+      uint64_t  key_; // see key(), EMPTY_ROW if the row is free
+      UserUsage usage_;
+
+    }; // struct
+
+    static const uint64_t EMPTY_ROW = 0;
+
+  private: // methods
+    Header*       header()       { return reinterpret_cast<Header*>(file_->data()); }
+    const Header* header() const { return reinterpret_cast<const Header*>(file_->data()); }
+
+    Row*       rows()       { return reinterpret_cast<Row*>(file_->data() + sizeof(Header)); }
+    const Row* rows() const { return reinterpret_cast<const Row*>(file_->data() + sizeof(Header)); }
+
+    /** The hash as it is stored, never EMPTY_ROW */
+    static uint64_t key(uint64_t hash) { return hash == EMPTY_ROW ? 1 : hash; }
+
+    /** @returns the position of the row with the key, or of the free row where it would go */
+    uint64_t position(uint64_t key) const;
+
+    /** Rebuild the table with a new capacity in a side file and rename it into place */
+    void rehash(uint64_t newCapacity);
+
+    void validate() const;
+
+    /** Write an empty header, the file must be freshly created so the rows are zero */
+    static void initialise(MappedFile& file, uint64_t capacity);
+
+  private: // data
+    std::string path_;
+    std::unique_ptr<MappedFile> file_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_USAGETABLE_HPP
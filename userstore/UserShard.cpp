@@ -0,0 +1,1425 @@
+#include "UserShard.hpp"
+
+#include "Record.hpp"
+#include "Utils.hpp"
+
+#include "boost/filesystem.hpp"
+
+#include <cstring>
+
+namespace
+{
+  using userstore::RecordFrame;
+  using userstore::RecordReader;
+  using userstore::StoredUser;
+
+  const char STORE_MAGIC[8] = { 'R', 'G', 'W', 'U', 'S', 'E', 'R', 'S' };
+  const uint32_t STORE_VERSION = 2;
+  const uint32_t UNPACKED_STORE_VERSION = 1; // see UserShard::upgrade()
+
+  const size_t INITIAL_STORE_SIZE = 64 * 1024;
+
+  const uint32_t STORE_DIRTY = 0x1;
+
+  const uint16_t UUID_FIELD = 0;
+  const uint16_t DISPLAY_NAME_FIELD = 1;
+  const uint16_t EMAIL_FIELD = 2;
+  const uint16_t USER_FIELD_COUNT = 3;
+
+  const std::string DATA_FILE_NAME = "users.db";
+  const std::string UPGRADE_FILE_NAME = "users.db.upgrade";
+  const std::string INDEX_FILE_NAMES[USER_FIELD_COUNT] = { "users.idx", "users.name.idx", "users.email.idx" };
+  const std::string FILTER_FILE_NAME = "users.filter";
+  const std::string USAGE_FILE_NAME = "users.usage";
+  const std::string LOG_FILE_NAME = "users.wal";
+  const std::string LOCK_FILE_NAME = "LOCK";
+
+  /** Compacted copies are built in these, one for writers and one for online compactions which are serialised by the
+   *  lock, as an online compaction can be waiting for the store while a writer compacts it */
+  const std::string COMPACT_DIRECTORY_NAME = "compact";
+  const std::string ONLINE_COMPACT_DIRECTORY_NAME = "compact.online";
+  const std::string COMPACT_LOCK_FILE_NAME = "COMPACT";
+
+  const uint64_t CHECKPOINT_LOG_BYTES = 64 * 1024 * 1024;
+  const uint64_t COMPACT_MIN_DEAD_RECORDS = 64 * 1024;
+
+  /** Usage changes held in memory are added to the usage table once there are this many users' or the oldest is this
+   *  old, like RGW's usage log flush threshold and tick */
+  const size_t USAGE_FLUSH_USERS = 4096;
+  const std::chrono::seconds USAGE_FLUSH_INTERVAL(5);
+
+  /** Fixed header at the start of the data file, records follow immediately after it
+   */
+  struct StoreHeader
+  {
+    char     magic_[8];
+    uint32_t version_;
+    uint32_t flags_;
+    uint64_t dataEnd_;   // offset one past the last record
+    uint64_t liveCount_;
+    uint64_t deadCount_;
+    uint8_t  reserved_[24];
+
+  }; // struct
+
+  /** Version 1 records are this header followed by fieldCount_ fields of [uint16_t length][bytes], padded to alignment.
+   *  They are only ever read to upgrade a store.
+   */
+  struct UnpackedRecordHeader
+  {
+    uint32_t length_;    // whole record including header and padding
+    uint16_t flags_;
+    uint16_t fieldCount_;
+
+  }; // struct
+
+  const size_t UNPACKED_RECORD_ALIGNMENT = 8;
+  const uint16_t UNPACKED_RECORD_LIVE = 0x1;
+
+  static_assert(sizeof(StoreHeader) == 64, "StoreHeader is part of the on disk format");
+  static_assert(sizeof(UnpackedRecordHeader) == 8, "UnpackedRecordHeader is part of the on disk format");
+  static_assert(USER_FIELD_COUNT == 3, "UserShard keeps an index per user field");
+
+  /** Read a version 1 record, fields it doesn't have are left as they are
+   *
+   * @returns false if the record and its fields don't fit inside the space that is left before the end of the data.
+   */
+  bool decodeUnpackedRecord(const char* record, uint64_t available, UnpackedRecordHeader& header,
+                            boost::string_view* fields)
+  {
+    if ( available < sizeof(header) )
+    {
+      return false;
+    }
+    std::memcpy(&header, record, sizeof(header));
+    if ( header.length_ < sizeof(header) || header.length_ > available
+         || header.length_ % UNPACKED_RECORD_ALIGNMENT != 0 || header.fieldCount_ == 0 )
+    {
+      return false;
+    }
+
+    boost::string_view encoded(record + sizeof(header), header.length_ - sizeof(header));
+    for (uint16_t field = 0; field < header.fieldCount_; ++field)
+    {
+      uint16_t length;
+      if ( encoded.size() < sizeof(length) )
+      {
+        return false;
+      }
+      std::memcpy(&length, encoded.data(), sizeof(length));
+      encoded.remove_prefix(sizeof(length));
+      if ( encoded.size() < length )
+      {
+        return false;
+      }
+      if ( field < USER_FIELD_COUNT )
+      {
+        fields[field] = encoded.substr(0, length);
+      }
+      encoded.remove_prefix(length);
+    }
+    return true;
+  }
+
+  /** A field value to match against user records, a uuid is converted to the form it would be stored in just once
+   */
+  struct FieldKey
+  {
+    FieldKey(uint16_t field, boost::string_view value) :
+      field_(field),
+      value_(value),
+      binaryUuid_(field == UUID_FIELD && userstore::Uuid::parse(value, binary_))
+    {
+
+    }
+
+    uint16_t field_;
+    boost::string_view value_;
+    userstore::Uuid binary_;
+    bool binaryUuid_;
+
+  }; // struct
+
+  bool isLive(const RecordFrame& frame)
+  {
+    return frame.flags_ & userstore::RECORD_LIVE;
+  }
+
+  boost::string_view displayNameOf(const char* base, const StoredUser& user)
+  {
+    if ( ! user.displayNameRecord_ )
+    {
+      return user.displayName_;
+    }
+
+    StoredUser holder;
+    userstore::decodeUser(RecordReader::frameAt(base, user.displayNameRecord_), holder);
+    return holder.displayName_;
+  }
+
+  /** @returns the display name or email of the user */
+  boost::string_view secondaryField(const char* base, const StoredUser& user, uint16_t field)
+  {
+    return field == DISPLAY_NAME_FIELD ? displayNameOf(base, user) : user.email_;
+  }
+
+  /** @returns the text form of the uuid, formatted into the buffer if it is stored in binary */
+  boost::string_view uuidText(const StoredUser& user, char* buffer)
+  {
+    if ( ! user.binaryUuid_ )
+    {
+      return user.uuid_;
+    }
+    userstore::formatUuid(reinterpret_cast<const uint8_t*>(user.uuid_.data()), buffer);
+    return boost::string_view(buffer, userstore::UUID_TEXT_LENGTH);
+  }
+
+  /** @returns true if the frame holds a user, live or not, whose field has the key's value */
+  bool userMatches(const char* base, const RecordFrame& frame, const FieldKey& key)
+  {
+    StoredUser user;
+    if ( ! userstore::decodeUser(frame, user) )
+    {
+      return false;
+    }
+
+    if ( key.field_ != UUID_FIELD )
+    {
+      return secondaryField(base, user, key.field_) == key.value_;
+    }
+    if ( user.binaryUuid_ != key.binaryUuid_ )
+    {
+      return false;
+    }
+    return key.binaryUuid_ ? userstore::uuidEquals(reinterpret_cast<const uint8_t*>(user.uuid_.data()), key.binary_.bytes_)
+                           : user.uuid_ == key.value_;
+  }
+
+  bool liveUserMatches(const char* base, uint64_t offset, const FieldKey& key)
+  {
+    RecordFrame frame = RecordReader::frameAt(base, offset);
+    return isLive(frame) && userMatches(base, frame, key);
+  }
+
+  /** Check a user record that shares its display name refers to an earlier record that holds the name itself, so even
+   *  a record with garbage that happens to pass its checksum can't send a lookup outside the data
+   */
+  bool referencesIntactName(const char* base, const RecordFrame& frame, const StoredUser& user)
+  {
+    if ( ! user.displayNameRecord_ )
+    {
+      return true;
+    }
+    if ( user.displayNameRecord_ < sizeof(StoreHeader) || user.displayNameRecord_ >= frame.offset_ )
+    {
+      return false;
+    }
+
+    RecordFrame holderFrame = RecordReader::frameAt(base, user.displayNameRecord_);
+    StoredUser holder;
+    return holderFrame.size_ && holderFrame.size_ <= frame.offset_ - user.displayNameRecord_
+           && userstore::decodeUser(holderFrame, holder) && ! holder.displayNameRecord_;
+  }
+
+  userstore::UserRecord userAt(const char* base, const RecordFrame& frame)
+  {
+    StoredUser stored;
+    userstore::decodeUser(frame, stored);
+
+    userstore::UserRecord user;
+    user.uuid_ = uuidText(stored, user.uuidText_);
+    user.displayName_ = displayNameOf(base, stored);
+    user.email_ = stored.email_;
+    return user;
+  }
+
+  userstore::UserRecord userAt(const char* base, uint64_t offset)
+  {
+    return userAt(base, RecordReader::frameAt(base, offset));
+  }
+
+  /** Log payloads and staged users lay fields out as [uint16_t length][bytes]
+   */
+  size_t encodedSize(const boost::string_view* fields, uint16_t count)
+  {
+    size_t size = 0;
+    for (uint16_t field = 0; field < count; ++field)
+    {
+      size += sizeof(uint16_t) + fields[field].size();
+    }
+    return size;
+  }
+
+  char* encodeFields(char* out, const boost::string_view* fields, uint16_t count)
+  {
+    for (uint16_t field = 0; field < count; ++field)
+    {
+      uint16_t length = static_cast<uint16_t>(fields[field].size());
+      std::memcpy(out, &length, sizeof(length));
+      std::memcpy(out + sizeof(length), fields[field].data(), length);
+      out += sizeof(length) + length;
+    }
+    return out;
+  }
+
+  /** @returns false if the encoded data doesn't hold exactly count fields */
+  bool decodeFields(boost::string_view encoded, boost::string_view* fields, uint16_t count)
+  {
+    for (uint16_t field = 0; field < count; ++field)
+    {
+      uint16_t length;
+      if ( encoded.size() < sizeof(length) )
+      {
+        return false;
+      }
+      std::memcpy(&length, encoded.data(), sizeof(length));
+      encoded.remove_prefix(sizeof(length));
+      if ( encoded.size() < length )
+      {
+        return false;
+      }
+      fields[field] = encoded.substr(0, length);
+      encoded.remove_prefix(length);
+    }
+    return encoded.empty();
+  }
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  void StagedUsers::add(boost::string_view uuid, boost::string_view displayName, boost::string_view email)
+  {
+    const boost::string_view fields[USER_FIELD_COUNT] = { uuid, displayName, email };
+    for (const boost::string_view& field : fields)
+    {
+      if ( field.size() > UINT16_MAX )
+      {
+        throw StoreError("User field is too long to be stored, uuid: " + uuid.to_string());
+      }
+    }
+
+    Entry entry;
+    entry.hash_ = HashIndex::hash(uuid);
+    entry.offset_ = encoded_.size();
+    entry.length_ = static_cast<uint32_t>(encodedSize(fields, USER_FIELD_COUNT));
+    entry.uuidLength_ = static_cast<uint16_t>(uuid.size());
+
+    encoded_.resize(entry.offset_ + entry.length_);
+    encodeFields(&encoded_[entry.offset_], fields, USER_FIELD_COUNT);
+    entry.checksum_ = WriteAheadLog::checksum(WriteAheadLog::Operation::Insert,
+                                              boost::string_view(encoded_.data() + entry.offset_, entry.length_));
+    entries_.push_back(entry);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::string_view StagedUsers::uuid(size_t position) const
+  {
+    const Entry& entry = entries_[position];
+    return boost::string_view(encoded_.data() + entry.offset_ + sizeof(uint16_t), entry.uuidLength_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::string_view StagedUsers::email(size_t position) const
+  {
+    const Entry& entry = entries_[position];
+    boost::string_view decoded[USER_FIELD_COUNT];
+    decodeFields(boost::string_view(encoded_.data() + entry.offset_, entry.length_), decoded, USER_FIELD_COUNT);
+    return decoded[EMAIL_FIELD];
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void StagedUsers::clear()
+  {
+    encoded_.clear();
+    entries_.clear();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::UserShard(const std::string& directory, OpenMode mode, const WriteAheadLog::CommitWindow& commitWindow) :
+    directory_(directory),
+    mode_(mode)
+  {
+    boost::filesystem::path dataPath = boost::filesystem::path(directory_) / DATA_FILE_NAME;
+
+    if ( mode_ == OpenMode::ReadOnly )
+    {
+      if ( ! boost::filesystem::exists(dataPath) )
+      {
+        return; // nothing has ever been written, behave as an empty store
+      }
+
+      lock_.reset( new FileLock((boost::filesystem::path(directory_) / LOCK_FILE_NAME).string(), false) );
+      data_.reset( new MappedFile(dataPath.string(), false) );
+      validate();
+      openIndexes();
+    }
+    else
+    {
+      boost::system::error_code error;
+      boost::filesystem::create_directories(directory_, error);
+      if ( error )
+      {
+        throw StoreError("Unable to create store directory (" + directory_ + "): " + error.message(), directory_);
+      }
+
+      lock_.reset( new FileLock((boost::filesystem::path(directory_) / LOCK_FILE_NAME).string(), true) );
+      data_.reset( new MappedFile(dataPath.string(), true, INITIAL_STORE_SIZE) );
+
+      StoreHeader* header = reinterpret_cast<StoreHeader*>(data_->data());
+      if ( header->dataEnd_ == 0 ) // freshly created, the file is all zeros
+      {
+        initialise();
+      }
+      validate();
+      if ( reinterpret_cast<const StoreHeader*>(data_->data())->version_ == UNPACKED_STORE_VERSION )
+      {
+        upgrade();
+      }
+      openIndexes();
+      markDirty(true);
+
+      io_ = IoQueue::create();
+      log_.reset( new WriteAheadLog((boost::filesystem::path(directory_) / LOG_FILE_NAME).string(), commitWindow,
+                                    *io_) );
+      recover();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::~UserShard()
+  {
+    if ( mode_ != OpenMode::ReadWrite )
+    {
+      return;
+    }
+
+    try
+    {
+      sync();
+      markDirty(false);
+    }
+    catch (StoreError&)
+    {
+      // leaving the store dirty is safe, the next writer replays the log and rebuilds the index
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::exists(const std::string& directory)
+  {
+    return boost::filesystem::exists(boost::filesystem::path(directory) / DATA_FILE_NAME);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::InsertResult UserShard::insert(boost::string_view uuid,
+                                            boost::string_view displayName,
+                                            boost::string_view email)
+  {
+    requireWritable();
+    const boost::string_view fields[USER_FIELD_COUNT] = { uuid, displayName, email };
+    for (const boost::string_view& field : fields)
+    {
+      if ( field.size() > UINT16_MAX )
+      {
+        throw StoreError("User field is too long to be stored, uuid: " + uuid.to_string(), data_->path());
+      }
+    }
+
+    uint64_t uuidHash = HashIndex::hash(uuid);
+    InsertResult result = checkInsert(uuid, uuidHash, email);
+    if ( result != InsertResult::Inserted )
+    {
+      return result;
+    }
+
+    logPayload_.resize(encodedSize(fields, USER_FIELD_COUNT));
+    encodeFields(&logPayload_[0], fields, USER_FIELD_COUNT);
+    log_->append(WriteAheadLog::Operation::Insert, logPayload_);
+    appendRecord(logPayload_, uuidHash);
+    checkpointIfDue();
+    return InsertResult::Inserted;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::InsertResult UserShard::insert(const StagedUsers& users, size_t position)
+  {
+    requireWritable();
+
+    const StagedUsers::Entry& entry = users.entries_[position];
+    boost::string_view fields(users.encoded_.data() + entry.offset_, entry.length_);
+    boost::string_view decoded[USER_FIELD_COUNT];
+    decodeFields(fields, decoded, USER_FIELD_COUNT);
+
+    InsertResult result = checkInsert(decoded[UUID_FIELD], entry.hash_, decoded[EMAIL_FIELD]);
+    if ( result != InsertResult::Inserted )
+    {
+      return result;
+    }
+
+    log_->append(WriteAheadLog::Operation::Insert, fields, entry.checksum_);
+    appendRecord(fields, entry.hash_);
+    checkpointIfDue();
+    return InsertResult::Inserted;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::remove(boost::string_view uuid)
+  {
+    requireWritable();
+    uint64_t offset = find(uuid);
+    if ( ! offset )
+    {
+      return false;
+    }
+
+    log_->append(WriteAheadLog::Operation::Remove, uuid);
+    removeRecord(offset);
+    checkpointIfDue();
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::commit()
+  {
+    requireWritable();
+    log_->commit();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<WriteAheadLog::Clock::time_point> UserShard::commitIfDue()
+  {
+    requireWritable();
+    return log_->commitIfDue();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::setCommitWindow(const WriteAheadLog::CommitWindow& commitWindow)
+  {
+    requireWritable();
+    log_->setCommitWindow(commitWindow);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::setPrecommit(const WriteAheadLog::Precommit& precommit)
+  {
+    requireWritable();
+    log_->setPrecommit(precommit);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::appendRecord(boost::string_view fields, uint64_t uuidHash)
+  {
+    boost::string_view decoded[USER_FIELD_COUNT];
+    decodeFields(fields, decoded, USER_FIELD_COUNT);
+
+    Uuid binaryUuid;
+    StoredUser user;
+    user.binaryUuid_ = Uuid::parse(decoded[UUID_FIELD], binaryUuid);
+    user.uuid_ = user.binaryUuid_ ? binaryUuid.bytes() : decoded[UUID_FIELD];
+    user.displayName_ = decoded[DISPLAY_NAME_FIELD];
+    user.displayNameRecord_ = user.displayName_.empty() ? 0 : sharedDisplayName(user.displayName_);
+    user.email_ = decoded[EMAIL_FIELD];
+
+    size_t userSize = userRecordSize(user);
+    reserve(userSize);
+
+    StoreHeader* header = reinterpret_cast<StoreHeader*>(data_->data());
+    uint64_t offset = header->dataEnd_;
+    writeUserRecord(data_->data() + offset, user);
+
+    indexes_[UUID_FIELD]->insert(uuidHash, offset);
+    addToUuidFilter(uuidHash);
+    indexSecondaryFields(offset);
+
+    header->dataEnd_ = offset + userSize;
+    ++header->liveCount_;
+    for (std::unique_ptr<HashIndex>& index : indexes_)
+    {
+      index->setIndexedEnd(header->dataEnd_);
+    }
+    uuidFilter_->setIndexedEnd(header->dataEnd_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::indexSecondaryFields(uint64_t offset)
+  {
+    const char* base = data_->data();
+    StoredUser user;
+    decodeUser(RecordReader::frameAt(base, offset), user);
+    for (uint16_t field : { DISPLAY_NAME_FIELD, EMAIL_FIELD })
+    {
+      boost::string_view value = secondaryField(base, user, field);
+      if ( ! value.empty() )
+      {
+        indexes_[field]->insert(HashIndex::hash(value), offset);
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::unindexSecondaryFields(uint64_t offset)
+  {
+    const char* base = data_->data();
+    StoredUser user;
+    decodeUser(RecordReader::frameAt(base, offset), user);
+    for (uint16_t field : { DISPLAY_NAME_FIELD, EMAIL_FIELD })
+    {
+      boost::string_view value = secondaryField(base, user, field);
+      if ( ! value.empty() )
+      {
+        indexes_[field]->erase(HashIndex::hash(value), [offset](uint64_t candidate) { return candidate == offset; });
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::InsertResult UserShard::checkInsert(boost::string_view uuid,
+                                                 uint64_t uuidHash,
+                                                 boost::string_view email) const
+  {
+    if ( find(uuid, uuidHash) )
+    {
+      return InsertResult::UuidExists;
+    }
+    if ( ! email.empty()
+         && ! findField(EMAIL_FIELD, email, HashIndex::hash(email), [](uint64_t) { return false; }) )
+    {
+      return InsertResult::EmailExists;
+    }
+    return InsertResult::Inserted;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserShard::sharedDisplayName(boost::string_view displayName) const
+  {
+    const char* base = data_->data();
+    uint64_t shared = 0;
+    findField(DISPLAY_NAME_FIELD, displayName, HashIndex::hash(displayName), [&](uint64_t offset)
+    {
+      StoredUser user;
+      decodeUser(RecordReader::frameAt(base, offset), user);
+      shared = user.displayNameRecord_ ? user.displayNameRecord_ : offset;
+      return false;
+    });
+    return shared;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::removeRecord(uint64_t offset)
+  {
+    char* base = data_->data();
+    RecordFrame frame = RecordReader::frameAt(base, offset);
+    StoredUser user;
+    decodeUser(frame, user);
+
+    char uuidBuffer[UUID_TEXT_LENGTH];
+    uint64_t uuidHash = HashIndex::hash(uuidText(user, uuidBuffer));
+    indexes_[UUID_FIELD]->erase(uuidHash, [offset](uint64_t candidate) { return candidate == offset; });
+    uuidFilter_->erase(uuidHash);
+    unindexSecondaryFields(offset);
+
+    /** A user created again with the uuid starts from nothing */
+    std::unordered_map<uint64_t, UserUsage>::iterator pending = pendingUsage_.find(uuidHash);
+    if ( pending != pendingUsage_.end() )
+    {
+      pendingTotal_ -= pending->second;
+      pendingUsage_.erase(pending);
+    }
+    if ( UsageTable* table = usageTable(false) )
+    {
+      table->erase(uuidHash);
+    }
+
+    /** The flags byte sits just before the payload */
+    base[frame.payload_ - base - 1] = static_cast<char>(frame.flags_ & ~RECORD_LIVE);
+
+    StoreHeader* header = reinterpret_cast<StoreHeader*>(data_->data());
+    --header->liveCount_;
+    ++header->deadCount_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::contains(boost::string_view uuid) const
+  {
+    return find(uuid) != 0;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<UserRecord> UserShard::get(boost::string_view uuid) const
+  {
+    uint64_t offset = find(uuid);
+    if ( ! offset )
+    {
+      return boost::none;
+    }
+
+    return userAt(data_->data(), offset);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<UserRecord> UserShard::getByEmail(boost::string_view email) const
+  {
+    boost::optional<UserRecord> user;
+    if ( ! data_ || email.empty() )
+    {
+      return user;
+    }
+
+    const char* base = data_->data();
+    findField(EMAIL_FIELD, email, HashIndex::hash(email), [&](uint64_t offset)
+    {
+      user = userAt(base, offset);
+      return false; // unique, the first match is the only one
+    });
+    return user;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::forEachWithDisplayName(boost::string_view displayName, const Visitor& visitor) const
+  {
+    if ( ! data_ || displayName.empty() )
+    {
+      return;
+    }
+
+    const char* base = data_->data();
+    findField(DISPLAY_NAME_FIELD, displayName, HashIndex::hash(displayName), [&](uint64_t offset)
+    {
+      visitor( userAt(base, offset) );
+      return true;
+    });
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::forEach(const Visitor& visitor) const
+  {
+    if ( ! data_ )
+    {
+      return;
+    }
+
+    const char* base = data_->data();
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(base);
+    RecordReader reader(base, sizeof(StoreHeader), header->dataEnd_);
+    RecordFrame frame;
+    while ( reader.next(frame) )
+    {
+      if ( isLive(frame) )
+      {
+        visitor( userAt(base, frame) );
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::forEach(boost::string_view marker, uint64_t maxEntries, const Visitor& visitor) const
+  {
+    if ( ! data_ )
+    {
+      if ( ! marker.empty() )
+      {
+        throw StoreError("No user with the marker uuid " + marker.to_string() + " to resume after", directory_);
+      }
+      return false;
+    }
+
+    const char* base = data_->data();
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(base);
+    uint64_t visited = 0;
+    RecordReader reader(base, marker.empty() ? sizeof(StoreHeader) : offsetAfter(marker), header->dataEnd_);
+    RecordFrame frame;
+    while ( reader.next(frame) )
+    {
+      if ( isLive(frame) )
+      {
+        if ( visited == maxEntries )
+        {
+          return true;
+        }
+        visitor( userAt(base, frame) );
+        ++visited;
+      }
+    }
+
+    return false;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserShard::size() const
+  {
+    return data_ ? reinterpret_cast<const StoreHeader*>(data_->data())->liveCount_ : 0;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::addUsage(boost::string_view uuid, const UserUsage& delta)
+  {
+    requireWritable();
+    uint64_t uuidHash = HashIndex::hash(uuid);
+    if ( ! find(uuid, uuidHash) )
+    {
+      return false;
+    }
+
+    if ( pendingUsage_.empty() )
+    {
+      pendingSince_ = std::chrono::steady_clock::now();
+    }
+    pendingUsage_[uuidHash] += delta;
+    pendingTotal_ += delta;
+
+    if ( pendingUsage_.size() >= USAGE_FLUSH_USERS
+         || std::chrono::steady_clock::now() - pendingSince_ >= USAGE_FLUSH_INTERVAL )
+    {
+      flushUsage();
+    }
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<UserUsage> UserShard::usage(boost::string_view uuid) const
+  {
+    uint64_t uuidHash = HashIndex::hash(uuid);
+    if ( ! find(uuid, uuidHash) )
+    {
+      return boost::none;
+    }
+
+    UserUsage usage;
+    if ( const UsageTable* table = usageTable(false) )
+    {
+      usage = table->get(uuidHash);
+    }
+    std::unordered_map<uint64_t, UserUsage>::const_iterator pending = pendingUsage_.find(uuidHash);
+    if ( pending != pendingUsage_.end() )
+    {
+      usage += pending->second;
+    }
+    return usage;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserUsage UserShard::totalUsage() const
+  {
+    UserUsage total;
+    if ( const UsageTable* table = usageTable(false) )
+    {
+      total = table->totals();
+    }
+    total += pendingTotal_;
+    return total;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::sync()
+  {
+    if ( mode_ != OpenMode::ReadWrite )
+    {
+      return;
+    }
+
+    log_->commit();
+    for (std::unique_ptr<HashIndex>& index : indexes_)
+    {
+      index->sync();
+    }
+    uuidFilter_->sync();
+    data_->sync();
+    log_->truncate();
+
+    flushUsage();
+    if ( usage_ )
+    {
+      usage_->sync();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::CompactionResult UserShard::compact()
+  {
+    requireWritable();
+    sync(); // the copy is not logged, so the log has to be empty before the data file is replaced
+
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data_->data());
+    CompactionResult result;
+    result.liveUsers_ = header->liveCount_;
+    result.deadRecords_ = header->deadCount_;
+    result.bytesBefore_ = header->dataEnd_ - sizeof(StoreHeader);
+
+    std::string copy = (boost::filesystem::path(directory_) / COMPACT_DIRECTORY_NAME).string();
+    boost::system::error_code error;
+    boost::filesystem::remove_all(copy, error); // left behind by a crash
+    copyLiveUsers(copy);
+    adoptCopy(copy);
+
+    result.bytesAfter_ = reinterpret_cast<const StoreHeader*>(data_->data())->dataEnd_ - sizeof(StoreHeader);
+    return result;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard::CompactionResult UserShard::compact(const std::string& directory)
+  {
+    FileLock compacting((boost::filesystem::path(directory) / COMPACT_LOCK_FILE_NAME).string(), true);
+    std::string copy = (boost::filesystem::path(directory) / ONLINE_COMPACT_DIRECTORY_NAME).string();
+    boost::system::error_code error;
+    boost::filesystem::remove_all(copy, error);
+
+    bool copied = false;
+    CompactionResult result = CompactionResult();
+    {
+      UserShard source(directory, OpenMode::ReadOnly);
+      if ( ! source.data_ )
+      {
+        return result; // nothing has ever been written
+      }
+
+      /** A dirty store needs a writer to recover it first, so it is left to the exclusive compaction below */
+      if ( ! source.dirty() )
+      {
+        const StoreHeader* header = reinterpret_cast<const StoreHeader*>(source.data_->data());
+        result.liveUsers_ = header->liveCount_;
+        result.deadRecords_ = header->deadCount_;
+        result.bytesBefore_ = header->dataEnd_ - sizeof(StoreHeader);
+        source.copyLiveUsers(copy);
+        copied = true;
+      }
+    }
+
+    UserShard store(directory, OpenMode::ReadWrite);
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(store.data_->data());
+    if ( ! copied || header->liveCount_ != result.liveUsers_ || header->deadCount_ != result.deadRecords_
+         || header->dataEnd_ - sizeof(StoreHeader) != result.bytesBefore_ )
+    {
+      boost::filesystem::remove_all(copy, error);
+      return store.compact();
+    }
+
+    store.adoptCopy(copy);
+    result.bytesAfter_ = reinterpret_cast<const StoreHeader*>(store.data_->data())->dataEnd_ - sizeof(StoreHeader);
+    return result;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::copyLiveUsers(const std::string& directory) const
+  {
+    UserShard copy(directory, OpenMode::ReadWrite);
+    for (std::unique_ptr<HashIndex>& index : copy.indexes_)
+    {
+      index->reset(size());
+    }
+    copy.uuidFilter_->reset(size());
+
+    std::string fields;
+    forEach([&](const UserRecord& user)
+    {
+      const boost::string_view values[USER_FIELD_COUNT] = { user.uuid_, user.displayName_, user.email_ };
+      fields.resize(encodedSize(values, USER_FIELD_COUNT));
+      encodeFields(&fields[0], values, USER_FIELD_COUNT);
+      copy.appendRecord(fields, HashIndex::hash(user.uuid_));
+    });
+  } // the copy is synced and marked clean as it closes
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::adoptCopy(const std::string& directory)
+  {
+    /** Marked dirty before it is moved into place, so a crash part way through the renames leaves a data file whose
+     *  indexes are rebuilt rather than trusted */
+    boost::filesystem::path copy(directory);
+    {
+      MappedFile copyData((copy / DATA_FILE_NAME).string(), true);
+      reinterpret_cast<StoreHeader*>(copyData.data())->flags_ |= STORE_DIRTY;
+      copyData.sync(0, sizeof(StoreHeader));
+    }
+
+    boost::filesystem::path storeDirectory(directory_);
+    boost::system::error_code error;
+    boost::filesystem::rename(copy / DATA_FILE_NAME, storeDirectory / DATA_FILE_NAME, error);
+    for (uint16_t field = 0; field < USER_FIELD_COUNT && ! error; ++field)
+    {
+      boost::filesystem::rename(copy / INDEX_FILE_NAMES[field], storeDirectory / INDEX_FILE_NAMES[field], error);
+    }
+    if ( ! error )
+    {
+      boost::filesystem::rename(copy / FILTER_FILE_NAME, storeDirectory / FILTER_FILE_NAME, error);
+    }
+    if ( error )
+    {
+      throw StoreError("Unable to move the compacted store into place (" + directory + "): " + error.message(),
+                       directory_);
+    }
+
+    data_.reset( new MappedFile((storeDirectory / DATA_FILE_NAME).string(), true) );
+    for (uint16_t field = 0; field < USER_FIELD_COUNT; ++field)
+    {
+      indexes_[field].reset( new HashIndex((storeDirectory / INDEX_FILE_NAMES[field]).string(), true) );
+    }
+    uuidFilter_.reset( new CuckooFilter((storeDirectory / FILTER_FILE_NAME).string(), true) );
+    boost::filesystem::remove_all(copy, error);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::checkpointIfDue()
+  {
+    if ( log_->size() >= CHECKPOINT_LOG_BYTES )
+    {
+      sync();
+    }
+
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data_->data());
+    if ( header->deadCount_ >= COMPACT_MIN_DEAD_RECORDS && header->deadCount_ > header->liveCount_ )
+    {
+      compact();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UsageTable* UserShard::usageTable(bool create) const
+  {
+    if ( ! usage_ && data_ )
+    {
+      boost::filesystem::path usagePath = boost::filesystem::path(directory_) / USAGE_FILE_NAME;
+      if ( create || boost::filesystem::exists(usagePath) )
+      {
+        usage_.reset( new UsageTable(usagePath.string(), mode_ == OpenMode::ReadWrite) );
+      }
+    }
+    return usage_.get();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::flushUsage()
+  {
+    if ( pendingUsage_.empty() )
+    {
+      return;
+    }
+
+    UsageTable* table = usageTable(true);
+    for (const std::pair<const uint64_t, UserUsage>& pending : pendingUsage_)
+    {
+      table->add(pending.first, pending.second);
+    }
+    pendingUsage_.clear();
+    pendingTotal_ = UserUsage();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::recover()
+  {
+    /** Replay is idempotent, each record is applied only if it would change the store, so records whose effects had
+     *  already reached the data file before the crash are harmless */
+    uint64_t replayed = log_->replay([this](WriteAheadLog::Operation operation, boost::string_view payload)
+    {
+      if ( operation == WriteAheadLog::Operation::Remove )
+      {
+        if ( uint64_t offset = find(payload) )
+        {
+          removeRecord(offset);
+        }
+        return;
+      }
+
+      boost::string_view fields[USER_FIELD_COUNT];
+      if ( ! decodeFields(payload, fields, USER_FIELD_COUNT) )
+      {
+        throw StoreError("Store log holds a malformed insert record: " + log_->path(), log_->path());
+      }
+      if ( ! find(fields[UUID_FIELD]) )
+      {
+        appendRecord(payload, HashIndex::hash(fields[UUID_FIELD]));
+      }
+    });
+
+    if ( replayed )
+    {
+      sync();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::initialise()
+  {
+    StoreHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version_ = STORE_VERSION;
+    header.dataEnd_ = sizeof(StoreHeader);
+
+    std::memcpy(data_->data(), &header, sizeof(header));
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::validate() const
+  {
+    if ( data_->size() < sizeof(StoreHeader) )
+    {
+      throw StoreError("Store file is truncated: " + data_->path(), data_->path());
+    }
+
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data_->data());
+    if ( std::memcmp(header->magic_, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 )
+    {
+      throw StoreError("Not a user store: " + data_->path(), data_->path());
+    }
+    if ( header->version_ == UNPACKED_STORE_VERSION && mode_ == OpenMode::ReadOnly )
+    {
+      throw StoreError("User store version 1 can't be read until it has been opened for writing once, which upgrades it: "
+                       + data_->path(), data_->path());
+    }
+    if ( header->version_ != STORE_VERSION && header->version_ != UNPACKED_STORE_VERSION )
+    {
+      throw StoreError("Unsupported user store version " + std::to_string(header->version_) + ": " + data_->path(),
+                       data_->path());
+    }
+    if ( header->dataEnd_ < sizeof(StoreHeader) || header->dataEnd_ > data_->size() )
+    {
+      throw StoreError("Store file is corrupt, data extends past the end of the file: " + data_->path(), data_->path());
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::upgrade()
+  {
+    /** The live users are copied into a new data file that replaces the old one once it is complete, so a crash part
+     *  way through leaves the version 1 store in place to be upgraded again. Log records haven't changed format, so
+     *  recover() replays anything the log still holds over the upgraded file. */
+    boost::filesystem::path dataPath = boost::filesystem::path(directory_) / DATA_FILE_NAME;
+    boost::filesystem::path upgradePath = boost::filesystem::path(directory_) / UPGRADE_FILE_NAME;
+    boost::system::error_code error;
+    boost::filesystem::remove(upgradePath, error);
+
+    std::unique_ptr<MappedFile> unpacked = std::move(data_);
+    data_.reset( new MappedFile(upgradePath.string(), true, INITIAL_STORE_SIZE) );
+    initialise();
+    markDirty(true);
+    openIndexes();
+
+    const char* base = unpacked->data();
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(base);
+    for (std::unique_ptr<HashIndex>& index : indexes_)
+    {
+      index->reset(header->liveCount_);
+    }
+    uuidFilter_->reset(header->liveCount_);
+    std::string fields;
+    for (uint64_t offset = sizeof(StoreHeader); offset < header->dataEnd_; )
+    {
+      UnpackedRecordHeader record;
+      boost::string_view user[USER_FIELD_COUNT];
+      if ( ! decodeUnpackedRecord(base + offset, header->dataEnd_ - offset, record, user) )
+      {
+        break; // torn by a crash, the log holds anything past here that was committed
+      }
+
+      if ( (record.flags_ & UNPACKED_RECORD_LIVE) && ! find(user[UUID_FIELD]) )
+      {
+        fields.resize(encodedSize(user, USER_FIELD_COUNT));
+        encodeFields(&fields[0], user, USER_FIELD_COUNT);
+        appendRecord(fields, HashIndex::hash(user[UUID_FIELD]));
+      }
+      offset += record.length_;
+    }
+
+    for (std::unique_ptr<HashIndex>& index : indexes_)
+    {
+      index->sync();
+    }
+    uuidFilter_->sync();
+    data_->sync();
+    boost::filesystem::rename(upgradePath, dataPath, error);
+    if ( error )
+    {
+      throw StoreError("Unable to replace the store file with its upgrade (" + upgradePath.string() + "): "
+                       + error.message(), directory_);
+    }
+    data_.reset( new MappedFile(dataPath.string(), true) );
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::openIndexes()
+  {
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(data_->data());
+    bool consistent = true;
+    for (uint16_t field = 0; field < USER_FIELD_COUNT; ++field)
+    {
+      boost::filesystem::path indexPath = boost::filesystem::path(directory_) / INDEX_FILE_NAMES[field];
+      std::unique_ptr<HashIndex>& index = indexes_[field];
+      if ( mode_ == OpenMode::ReadOnly )
+      {
+        if ( dirty() || ! boost::filesystem::exists(indexPath) )
+        {
+          continue; // a writer died mid update or never built this index, scanning is the only safe option
+        }
+
+        index.reset( new HashIndex(indexPath.string(), false) );
+        if ( index->indexedEnd() != header->dataEnd_ )
+        {
+          index.reset();
+        }
+        continue;
+      }
+
+      /** Stores written before an index existed get an empty one here, which the rebuild fills */
+      index.reset( new HashIndex(indexPath.string(), true) );
+      consistent = consistent && index->indexedEnd() == header->dataEnd_;
+    }
+
+    boost::filesystem::path filterPath = boost::filesystem::path(directory_) / FILTER_FILE_NAME;
+    if ( mode_ == OpenMode::ReadOnly )
+    {
+      if ( ! dirty() && boost::filesystem::exists(filterPath) )
+      {
+        uuidFilter_.reset( new CuckooFilter(filterPath.string(), false) );
+        if ( uuidFilter_->indexedEnd() != header->dataEnd_ )
+        {
+          uuidFilter_.reset();
+        }
+      }
+      return;
+    }
+
+    uuidFilter_.reset( new CuckooFilter(filterPath.string(), true) );
+    if ( dirty() || ! consistent )
+    {
+      rebuildIndexes();
+    }
+    else if ( uuidFilter_->indexedEnd() != header->dataEnd_ )
+    {
+      /** Only the filter is stale, which the uuid index has everything to refill */
+      rebuildUuidFilter();
+      uuidFilter_->setIndexedEnd(header->dataEnd_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::rebuildUuidFilter()
+  {
+    const HashIndex& index = *indexes_[UUID_FIELD];
+    for (uint64_t expected = index.size(); ; expected = expected * 2 + 1)
+    {
+      uuidFilter_->reset(expected);
+      bool complete = true;
+      index.forEachHash([&](uint64_t hash) { complete = uuidFilter_->insert(hash) && complete; });
+      if ( complete )
+      {
+        return;
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::addToUuidFilter(uint64_t uuidHash)
+  {
+    /** The uuid index already holds the new entry, so refilling from it takes care of this one too */
+    if ( ! uuidFilter_->insert(uuidHash) )
+    {
+      rebuildUuidFilter();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::rebuildIndexes()
+  {
+    const char* base = data_->data();
+    StoreHeader* header = reinterpret_cast<StoreHeader*>(data_->data());
+
+    /** After a crash the header can be ahead of records that never reached the disk. Everything from the first record
+     *  that doesn't hang together or fails its checksum is dropped, the log still holds any of it that was committed. */
+    uint64_t liveCount = 0;
+    uint64_t deadCount = 0;
+    for (std::unique_ptr<HashIndex>& index : indexes_)
+    {
+      index->reset(header->liveCount_);
+    }
+
+    RecordReader reader(base, sizeof(StoreHeader), header->dataEnd_);
+    RecordFrame frame;
+    char uuidBuffer[UUID_TEXT_LENGTH];
+    while ( reader.next(frame) )
+    {
+      StoredUser user;
+      if ( ! checksumMatches(frame) || ! decodeUser(frame, user) || ! referencesIntactName(base, frame, user) )
+      {
+        header->dataEnd_ = frame.offset_;
+        break;
+      }
+
+      if ( frame.flags_ & RECORD_LIVE )
+      {
+        indexes_[UUID_FIELD]->insert(HashIndex::hash(uuidText(user, uuidBuffer)), frame.offset_);
+        indexSecondaryFields(frame.offset_);
+        ++liveCount;
+      }
+      else
+      {
+        ++deadCount;
+      }
+    }
+    if ( reader.torn() )
+    {
+      header->dataEnd_ = reader.offset();
+    }
+
+    header->liveCount_ = liveCount;
+    header->deadCount_ = deadCount;
+    for (std::unique_ptr<HashIndex>& index : indexes_)
+    {
+      index->setIndexedEnd(header->dataEnd_);
+    }
+    rebuildUuidFilter();
+    uuidFilter_->setIndexedEnd(header->dataEnd_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::markDirty(bool dirty)
+  {
+    StoreHeader* header = reinterpret_cast<StoreHeader*>(data_->data());
+    if ( dirty )
+    {
+      header->flags_ |= STORE_DIRTY;
+      data_->sync(0, sizeof(StoreHeader));
+    }
+    else
+    {
+      header->flags_ &= ~STORE_DIRTY;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::dirty() const
+  {
+    return reinterpret_cast<const StoreHeader*>(data_->data())->flags_ & STORE_DIRTY;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserShard::find(boost::string_view uuid) const
+  {
+    return find(uuid, HashIndex::hash(uuid));
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserShard::find(boost::string_view uuid, uint64_t uuidHash) const
+  {
+    if ( ! data_ )
+    {
+      return 0;
+    }
+
+    if ( uuidFilter_ && ! uuidFilter_->mayContain(uuidHash) )
+    {
+      return 0;
+    }
+
+    const char* base = data_->data();
+    if ( ! indexes_[UUID_FIELD] )
+    {
+      uint64_t found = 0;
+      scan(UUID_FIELD, uuid, [&found](uint64_t offset) { found = offset; return false; });
+      return found;
+    }
+
+    FieldKey key(UUID_FIELD, uuid);
+    return indexes_[UUID_FIELD]->find(uuidHash, [&](uint64_t offset) { return liveUserMatches(base, offset, key); });
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::findField(uint16_t field,
+                            boost::string_view value,
+                            uint64_t valueHash,
+                            const std::function<bool(uint64_t)>& visitor) const
+  {
+    if ( ! indexes_[field] )
+    {
+      return scan(field, value, visitor);
+    }
+
+    const char* base = data_->data();
+    FieldKey key(field, value);
+    return indexes_[field]->forEach(valueHash, [&](uint64_t offset)
+    {
+      if ( ! liveUserMatches(base, offset, key) )
+      {
+        return true; // a different value with the same hash
+      }
+      return visitor(offset);
+    });
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserShard::scan(uint16_t field, boost::string_view value, const std::function<bool(uint64_t)>& visitor) const
+  {
+    const char* base = data_->data();
+    const StoreHeader* header = reinterpret_cast<const StoreHeader*>(base);
+    FieldKey key(field, value);
+    RecordReader reader(base, sizeof(StoreHeader), header->dataEnd_);
+    RecordFrame frame;
+    while ( reader.next(frame) )
+    {
+      if ( isLive(frame) && userMatches(base, frame, key) && ! visitor(frame.offset_) )
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserShard::offsetAfter(boost::string_view marker) const
+  {
+    const char* base = data_->data();
+    uint64_t offset = find(marker);
+    if ( ! offset )
+    {
+      /** Deleted since the page that ended with it, its record is still in place, the latest one if it was recreated */
+      const StoreHeader* header = reinterpret_cast<const StoreHeader*>(base);
+      FieldKey key(UUID_FIELD, marker);
+      RecordReader reader(base, sizeof(StoreHeader), header->dataEnd_);
+      RecordFrame frame;
+      while ( reader.next(frame) )
+      {
+        if ( userMatches(base, frame, key) )
+        {
+          offset = frame.offset_;
+        }
+      }
+    }
+    if ( ! offset )
+    {
+      throw StoreError("No user with the marker uuid " + marker.to_string() + " to resume after", directory_);
+    }
+
+    RecordFrame frame = RecordReader::frameAt(base, offset);
+    return offset + frame.size_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::reserve(size_t bytes)
+  {
+    uint64_t dataEnd = reinterpret_cast<const StoreHeader*>(data_->data())->dataEnd_;
+    if ( dataEnd + bytes <= data_->size() )
+    {
+      return;
+    }
+
+    size_t newSize = data_->size();
+    while ( dataEnd + bytes > newSize )
+    {
+      newSize *= 2;
+    }
+    data_->resize(newSize);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserShard::requireWritable() const
+  {
+    if ( mode_ != OpenMode::ReadWrite )
+    {
+      throw StoreError("Attempt to modify a store opened read only: " + directory_, directory_);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
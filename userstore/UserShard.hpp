@@ -0,0 +1,347 @@
+#ifndef USERSTORE_USERSHARD_HPP
+#define USERSTORE_USERSHARD_HPP
+
+#include "MappedFile.hpp"
+#include "CuckooFilter.hpp"
+#include "HashIndex.hpp"
+#include "IoQueue.hpp"
+#include "UsageTable.hpp"
+#include "WriteAheadLog.hpp"
+#include "Uuid.hpp"
+
+#include "boost/utility/string_view.hpp"
+#include "boost/optional.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** View of a single user as stored, the referenced memory belongs to the store mapping
+   *
+   * Only valid until the next mutation of the store, copy out anything that needs to live longer.
+   */
+  struct UserRecord
+  {
+    UserRecord() {}
+    UserRecord(const UserRecord& other) { *this = other; }
+
+    /** uuid_ refers to uuidText_ when the uuid is stored in binary, a copy has to refer to its own */
+    UserRecord& operator=(const UserRecord& other)
+    {
+      std::memcpy(uuidText_, other.uuidText_, sizeof(uuidText_));
+      uuid_ = other.uuid_.data() == other.uuidText_ ? boost::string_view(uuidText_, other.uuid_.size()) : other.uuid_;
+      displayName_ = other.displayName_;
+      email_ = other.email_;
+      return *this;
+    }
+
+    boost::string_view uuid_;
+    boost::string_view displayName_; // empty if not set
+    boost::string_view email_;       // empty if not set
+
+    char uuidText_[UUID_TEXT_LENGTH]; // the text of a uuid stored in binary
+
+  }; // struct
+
+//**********************************************************************************************************************
+  /** Users encoded for insertion ahead of time, see UserStore::insert(const StagedUsers&)
+   *
+   * Staging does the parts of an insert that don't depend on the store (validating, hashing, encoding and checksumming
+   * the log record), so a bulk load can stage on many threads while a single thread applies the results.
+   */
+  class StagedUsers
+  {
+  public: // interface
+    /** @throws StoreError: if a field is too long to be stored */
+    void add(boost::string_view uuid,
+             boost::string_view displayName=boost::string_view(),
+             boost::string_view email=boost::string_view());
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+    /** The uuid of the user staged at the position, in the order they were added */
+    boost::string_view uuid(size_t position) const;
+
+    /** HashIndex::hash of the uuid */
+    uint64_t uuidHash(size_t position) const { return entries_[position].hash_; }
+
+    boost::string_view email(size_t position) const;
+
+    /** Keeps the allocated space so a buffer can be refilled without allocating */
+    void clear();
+
+  private: // types
+    friend class UserShard;
+
+    struct Entry
+    {
+      uint64_t hash_;      // HashIndex::hash of the uuid
+      uint64_t offset_;    // into encoded_
+      uint32_t length_;
+      uint32_t checksum_;  // of the log record holding the encoded fields
+      uint16_t uuidLength_;
+
+    }; // struct
+
+  private: // data
+    std::string encoded_; // every user's fields back to back, in the log format
+    std::vector<Entry> entries_;
+
+  }; // class
+
+//**********************************************************************************************************************
+  /** Persistent collection of users kept in a memory mapped file inside a directory, a UserStore is one or more
+   *
+   * Opening a shard is a single mmap of the data file, there is no load step. Records are appended to the end of the
+   * mapping and deleted in place by clearing their live flag, so neither operation moves any other record. Records are
+   * packed as described in Record.hpp: canonical uuids take 16 bytes and users that share a display name share a single
+   * copy of it. Lookups by uuid, email and display name go through HashIndexes kept next to the data file, so they are
+   * constant time regardless of the store size. Emails are unique among live users, display names needn't be. A
+   * CuckooFilter of the live uuids sits in front of the uuid index, so looking up or deleting a uuid that isn't there
+   * usually reads a few bytes of the filter and none of the index or data.
+   *
+   * Every mutation is appended to a WriteAheadLog before it is applied to the mapping, and a mutation is durable once
+   * its log record is committed. The mapping itself is only flushed by sync() (and on close), which then empties the
+   * log, so a process that runs many mutations pays one fsync per commit window rather than per mutation.
+   *
+   * A writer marks the store dirty for as long as it has it open. If a process dies with the store dirty the index
+   * can't be trusted; readers fall back to scanning and the next writer rebuilds it from the records and replays the
+   * log over them. Readers never replay, they see the state as of the last sync until a writer has recovered.
+   *
+   * Users' usage counters are kept in a UsageTable next to the data file. Changes to them aren't logged, a writer
+   * gathers them in memory and adds them to the table at most a few seconds or a few thousand users later and at every
+   * sync(), so a process that dies loses at most the changes it hadn't added yet. The writer's own lookups include the
+   * changes it still holds.
+   *
+   * The shard directory is locked for the lifetime of the object, shared for ReadOnly and exclusive for ReadWrite, so
+   * concurrent invocations of the application serialise their writes to it rather than corrupting the mapping.
+   */
+  class UserShard
+  {
+  public: // types
+    enum class OpenMode { ReadOnly, ReadWrite };
+
+    typedef std::function<void(const UserRecord&)> Visitor;
+
+    enum class InsertResult { Inserted, UuidExists, EmailExists };
+
+    struct CompactionResult
+    {
+      uint64_t liveUsers_;
+      uint64_t deadRecords_; // dropped
+      uint64_t bytesBefore_; // of records in the data file
+      uint64_t bytesAfter_;
+
+    }; // struct
+
+  public: // interface
+    /** Open the store in the given directory
+     *
+     * A ReadWrite open creates the directory and an empty store if needed, a ReadOnly open of a missing store behaves
+     * as an empty store.
+     *
+     * @param commitWindow: how many mutations a writer may buffer before committing them to the log, the default
+     *                      commits every mutation as it is made.
+     * @throws StoreError: if the store can't be opened or is not a valid user store.
+     */
+    UserShard(const std::string& directory,
+              OpenMode mode,
+              const WriteAheadLog::CommitWindow& commitWindow=WriteAheadLog::CommitWindow());
+
+    /** Flushes the store and clears the dirty mark, see sync() */
+    ~UserShard();
+
+    UserShard(const UserShard&) = delete;
+    UserShard& operator=(const UserShard&) = delete;
+
+    /** @returns true if anything has ever been written to a shard in the directory */
+    static bool exists(const std::string& directory);
+
+    /** Nothing is inserted unless the result is Inserted, an empty email is never taken */
+    InsertResult insert(boost::string_view uuid,
+                        boost::string_view displayName=boost::string_view(),
+                        boost::string_view email=boost::string_view());
+
+    /** Insert the user staged at the position, exactly as insert() would */
+    InsertResult insert(const StagedUsers& users, size_t position);
+
+    /** @returns false if no user with the uuid exists */
+    bool remove(boost::string_view uuid);
+
+    bool contains(boost::string_view uuid) const;
+
+    boost::optional<UserRecord> get(boost::string_view uuid) const;
+
+    boost::optional<UserRecord> getByEmail(boost::string_view email) const;
+
+    /** Call the visitor for every live user with the display name, in no particular order */
+    void forEachWithDisplayName(boost::string_view displayName, const Visitor& visitor) const;
+
+    /** Call the visitor for every live user in insertion order */
+    void forEach(const Visitor& visitor) const;
+
+    /** Call the visitor for up to maxEntries live users in insertion order, resuming after the user with the marker
+     *  uuid or from the start if the marker is empty
+     *
+     * Insertion order is stable, users created while a listing is paged through show up on later pages and deleted
+     * users are skipped. A page costs O(maxEntries) plus the deleted records in its range, whatever the store size.
+     *
+     * @returns true if there are more users after the last one visited.
+     * @throws StoreError: if there never was a user with the marker uuid.
+     */
+    bool forEach(boost::string_view marker, uint64_t maxEntries, const Visitor& visitor) const;
+
+    uint64_t size() const;
+
+    /** Add a change to the usage counters of the user with the uuid, see the class comment for when it is persisted
+     *
+     * @returns false if no user with the uuid exists.
+     */
+    bool addUsage(boost::string_view uuid, const UserUsage& delta);
+
+    /** @returns the usage counters of the user with the uuid, or none if no user with the uuid exists */
+    boost::optional<UserUsage> usage(boost::string_view uuid) const;
+
+    /** @returns the usage counters of every user added up */
+    UserUsage totalUsage() const;
+
+    /** Commit any mutations still buffered in the commit window to the log */
+    void commit();
+
+    /** Commit the buffered mutations if they have waited out the commit window, see WriteAheadLog::commitIfDue */
+    boost::optional<WriteAheadLog::Clock::time_point> commitIfDue();
+
+    /** Change the commit window of a store that is already open, see WriteAheadLog::setCommitWindow */
+    void setCommitWindow(const WriteAheadLog::CommitWindow& commitWindow);
+
+    /** Run the callback ahead of every commit of the log, see WriteAheadLog::setPrecommit */
+    void setPrecommit(const WriteAheadLog::Precommit& precommit);
+
+    /** Commit the log, flush the data file, indexes and usage counters to stable storage and empty the log */
+    void sync();
+
+    /** Rewrite the data file with only the live users, still in insertion order, and rebuild the indexes to match
+     *
+     * Deleted users' records otherwise stay in the data file for good, and a writer recovering from a crash walks all
+     * of them. Writers compact on their own once deleted records outnumber live ones, this is for doing it sooner.
+     */
+    CompactionResult compact();
+
+    /** Compact the store in a directory while only holding it open for reading until the very end
+     *
+     * The compacted copy is built under a shared lock, so readers carry on as normal and only writers wait. Swapping
+     * the copy in takes the exclusive lock briefly, and if a writer got in between the two the store is compacted
+     * again under the exclusive lock instead.
+     */
+    static CompactionResult compact(const std::string& directory);
+
+    const std::string& directory() const { return directory_; }
+
+  private: // methods
+    void initialise();
+    void validate() const;
+
+    /** Rewrite a version 1 data file, whose records held every field as it is in log records, in the current format */
+    void upgrade();
+
+    /** Open the indexes that match the data file, a writer rebuilds them all if any doesn't */
+    void openIndexes();
+    void rebuildIndexes();
+
+    /** Refill the uuid filter from the uuid index, sizing it for the users there are now */
+    void rebuildUuidFilter();
+    void addToUuidFilter(uint64_t uuidHash);
+
+    /** The usage table, opened the first time it is needed, @returns null if there is none and create is false */
+    UsageTable* usageTable(bool create) const;
+
+    /** Add the usage changes held in memory to the usage table */
+    void flushUsage();
+
+    /** Replay whatever the log holds over the data file, it is only non empty if a writer died */
+    void recover();
+
+    /** Sync once the log has grown past a bound and compact once most records are dead, so the work a crash can
+     *  leave for the next writer stays bounded however many mutations a writer makes */
+    void checkpointIfDue();
+
+    /** Write every live user into a new store in the directory, which must not exist */
+    void copyLiveUsers(const std::string& directory) const;
+
+    /** Move the data file and indexes of a copy made by copyLiveUsers over this store's and remove the copy */
+    void adoptCopy(const std::string& directory);
+
+    /** Change the mapping and indexes without logging, callers have already logged the change or are replaying it
+     *
+     * @param fields: the user's fields already encoded, as they are in log records.
+     */
+    void appendRecord(boost::string_view fields, uint64_t uuidHash);
+
+    /** Index or unindex the record's fields other than the uuid, empty fields aren't indexed */
+    void indexSecondaryFields(uint64_t offset);
+    void unindexSecondaryFields(uint64_t offset);
+
+    /** @returns the insert result for a user that would have these fields */
+    InsertResult checkInsert(boost::string_view uuid, uint64_t uuidHash, boost::string_view email) const;
+
+    /** @returns the offset of the record holding the display name for the live users that have it, or 0 if none do */
+    uint64_t sharedDisplayName(boost::string_view displayName) const;
+    void removeRecord(uint64_t offset);
+
+    /** Set or clear the dirty mark, setting it is flushed before any other write can reach the disk */
+    void markDirty(bool dirty);
+    bool dirty() const;
+
+    /** @returns the offset of the live record for the uuid or 0 if there isn't one */
+    uint64_t find(boost::string_view uuid) const;
+    uint64_t find(boost::string_view uuid, uint64_t uuidHash) const;
+
+    /** Call the visitor with the offset of each live record with the field value, through its index if there is one
+     *
+     * @returns false as soon as the visitor does, true if it saw every match.
+     */
+    bool findField(uint16_t field, boost::string_view value, uint64_t valueHash,
+                   const std::function<bool(uint64_t)>& visitor) const;
+    bool scan(uint16_t field, boost::string_view value, const std::function<bool(uint64_t)>& visitor) const;
+
+    /** @returns the offset of the record after the marker user's, it is only scanned for if the user has been deleted */
+    uint64_t offsetAfter(boost::string_view marker) const;
+
+    /** Make sure there are at least the requested number of bytes free past the end of the data */
+    void reserve(size_t bytes);
+
+    void requireWritable() const;
+
+  private: // data
+    std::string directory_;
+    OpenMode mode_;
+
+    std::unique_ptr<FileLock> lock_;
+    std::unique_ptr<MappedFile> data_;
+    std::unique_ptr<HashIndex> indexes_[3]; // by field: uuid, display name, email; null where none is consistent
+    std::unique_ptr<CuckooFilter> uuidFilter_; // of live uuid hashes; null where none is consistent
+    std::unique_ptr<IoQueue> io_;        // writers only, outlives log_
+    std::unique_ptr<WriteAheadLog> log_; // writers only
+    std::string logPayload_;             // reused to encode log records
+
+    mutable std::unique_ptr<UsageTable> usage_;               // null until first needed
+    std::unordered_map<uint64_t, UserUsage> pendingUsage_;    // by uuid hash, not yet in usage_
+    UserUsage pendingTotal_;                                   // of pendingUsage_
+    std::chrono::steady_clock::time_point pendingSince_;       // when the oldest pending change was made
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_USERSHARD_HPP
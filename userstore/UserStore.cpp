@@ -0,0 +1,521 @@
+#include "UserStore.hpp"
+
+#include "HashIndex.hpp"
+#include "Utils.hpp"
+
+#include "boost/filesystem.hpp"
+
+#include <fstream>
+
+namespace
+{
+  /** Holds the shard count of a store with more than one shard, a store without it has a single shard */
+  const std::string SHARD_COUNT_FILE_NAME = "SHARDS";
+  const std::string SHARD_DIRECTORY_PREFIX = "shard.";
+
+  /** Email claims of a store with more than one shard, see UserStore, and the mark that they cover every user */
+  const std::string CLAIM_DIRECTORY_PREFIX = "emails.";
+  const std::string CLAIMS_BUILT_FILE_NAME = "EMAILS";
+
+  const unsigned MAX_SHARDS = 1024;
+
+  size_t readShardCount(const std::string& directory)
+  {
+    boost::filesystem::path path = boost::filesystem::path(directory) / SHARD_COUNT_FILE_NAME;
+    if ( ! boost::filesystem::exists(path) )
+    {
+      return 1;
+    }
+
+    std::ifstream in(path.string());
+    unsigned shards = 0;
+    if ( ! (in >> shards) || shards == 0 || shards > MAX_SHARDS )
+    {
+      throw userstore::StoreError("Store shard count is unreadable: " + path.string(), path.string());
+    }
+    return shards;
+  }
+
+  /** The user shards' directories followed by the claim shards', a store with a single shard has no claim shards */
+  std::vector<std::string> shardDirectories(const std::string& directory, size_t shards)
+  {
+    if ( shards == 1 )
+    {
+      return std::vector<std::string>(1, directory);
+    }
+
+    std::vector<std::string> directories;
+    for (const std::string& prefix : { SHARD_DIRECTORY_PREFIX, CLAIM_DIRECTORY_PREFIX })
+    {
+      for (size_t shard = 0; shard < shards; ++shard)
+      {
+        directories.push_back( (boost::filesystem::path(directory) / (prefix + std::to_string(shard))).string() );
+      }
+    }
+    return directories;
+  }
+
+  /** Write a small file in place of any existing one, so readers never see part of it */
+  void writeStoreFile(const boost::filesystem::path& path, const std::string& contents, const std::string& what)
+  {
+    std::string partialPath = path.string() + ".tmp";
+    {
+      std::ofstream out(partialPath);
+      out << contents;
+      if ( ! out.flush() )
+      {
+        throw userstore::StoreError("Unable to write the " + what + ": " + partialPath, partialPath);
+      }
+    }
+    boost::system::error_code error;
+    boost::filesystem::rename(partialPath, path, error);
+    if ( error )
+    {
+      throw userstore::StoreError("Unable to write the " + what + " (" + path.string() + "): " + error.message(),
+                                  path.string());
+    }
+  }
+
+  void addCompaction(userstore::UserStore::CompactionResult& total, const userstore::UserStore::CompactionResult& shard)
+  {
+    total.liveUsers_ += shard.liveUsers_;
+    total.deadRecords_ += shard.deadRecords_;
+    total.bytesBefore_ += shard.bytesBefore_;
+    total.bytesAfter_ += shard.bytesAfter_;
+  }
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserStore::UserStore(const std::string& directory, OpenMode mode, const WriteAheadLog::CommitWindow& commitWindow) :
+    directory_(directory),
+    mode_(mode),
+    commitWindow_(commitWindow),
+    shardCount_(readShardCount(directory)),
+    claimsBuilt_(shardCount_ == 1),
+    shardDirectories_(shardDirectories(directory, shardCount_))
+  {
+    shards_.resize(shardDirectories_.size());
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserStore::~UserStore()
+  {
+    for (size_t index = shards_.size(); index > 0; --index)
+    {
+      shards_[index - 1].reset();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::create(const std::string& directory, unsigned shards)
+  {
+    if ( shards == 0 || shards > MAX_SHARDS )
+    {
+      throw StoreError("A store has between 1 and " + std::to_string(MAX_SHARDS) + " shards", directory);
+    }
+
+    boost::filesystem::path countPath = boost::filesystem::path(directory) / SHARD_COUNT_FILE_NAME;
+    if ( boost::filesystem::exists(countPath) || UserShard::exists(directory) )
+    {
+      throw StoreError("A store already exists in " + directory, directory);
+    }
+    if ( shards == 1 )
+    {
+      UserShard(directory, OpenMode::ReadWrite); // the layout a store's first writer makes anyway
+      return;
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::create_directories(directory, error);
+    writeStoreFile(boost::filesystem::path(directory) / CLAIMS_BUILT_FILE_NAME, "", "store email claims mark");
+    writeStoreFile(countPath, std::to_string(shards) + '\n', "store shard count");
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserStore::InsertResult UserStore::insert(boost::string_view uuid,
+                                            boost::string_view displayName,
+                                            boost::string_view email)
+  {
+    size_t home = shardFor(HashIndex::hash(uuid));
+    if ( ! email.empty() && shardCount_ > 1 )
+    {
+      if ( shard(home).contains(uuid) ) // an existing uuid is reported first, as a single shard does
+      {
+        return InsertResult::UuidExists;
+      }
+      if ( ! claimEmail(email) )
+      {
+        return InsertResult::EmailExists;
+      }
+    }
+    return shard(home).insert(uuid, displayName, email);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserStore::insert(const StagedUsers& users, const std::function<void(size_t, InsertResult)>& rejected)
+  {
+    /** Bulk loads touch every shard, taking them all up front saves reopening them out of order */
+    for (size_t index = 0; index < shards_.size(); ++index)
+    {
+      shard(index);
+    }
+    if ( ! users.empty() && shardCount_ > 1 )
+    {
+      buildClaims();
+    }
+
+    uint64_t inserted = 0;
+    for (size_t position = 0; position < users.size(); ++position)
+    {
+      size_t home = shardFor(users.uuidHash(position));
+      boost::string_view email = users.email(position);
+      UserShard& target = shard(home);
+
+      InsertResult result = InsertResult::Inserted;
+      if ( ! email.empty() && shardCount_ > 1 && target.contains(users.uuid(position)) )
+      {
+        result = InsertResult::UuidExists;
+      }
+      else if ( ! email.empty() && shardCount_ > 1 && ! claimEmail(email) )
+      {
+        result = InsertResult::EmailExists;
+      }
+      else
+      {
+        result = target.insert(users, position);
+      }
+      if ( result == InsertResult::Inserted )
+      {
+        ++inserted;
+      }
+      else if ( rejected )
+      {
+        rejected(position, result);
+      }
+    }
+    return inserted;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserStore::remove(boost::string_view uuid)
+  {
+    return shard(shardFor(HashIndex::hash(uuid))).remove(uuid);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserStore::contains(boost::string_view uuid) const
+  {
+    return shard(shardFor(HashIndex::hash(uuid))).contains(uuid);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<UserRecord> UserStore::get(boost::string_view uuid) const
+  {
+    return shard(shardFor(HashIndex::hash(uuid))).get(uuid);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<UserRecord> UserStore::getByEmail(boost::string_view email) const
+  {
+    for (size_t index = 0; index < shardCount_; ++index)
+    {
+      if ( boost::optional<UserRecord> user = shard(index).getByEmail(email) )
+      {
+        return user;
+      }
+    }
+    return boost::none;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::forEachWithDisplayName(boost::string_view displayName, const Visitor& visitor) const
+  {
+    for (size_t index = 0; index < shardCount_; ++index)
+    {
+      shard(index).forEachWithDisplayName(displayName, visitor);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::forEach(const Visitor& visitor) const
+  {
+    for (size_t index = 0; index < shardCount_; ++index)
+    {
+      shard(index).forEach(visitor);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserStore::forEach(boost::string_view marker, uint64_t maxEntries, const Visitor& visitor) const
+  {
+    size_t first = marker.empty() ? 0 : shardFor(HashIndex::hash(marker));
+    uint64_t remaining = maxEntries;
+    for (size_t index = first; index < shardCount_; ++index)
+    {
+      uint64_t visited = 0;
+      bool truncated = shard(index).forEach(index == first ? marker : boost::string_view(), remaining,
+                                            [&](const UserRecord& user)
+                                            {
+                                              visitor(user);
+                                              ++visited;
+                                            });
+      if ( truncated ) // with nothing left to visit a shard still reports whether it has users
+      {
+        return true;
+      }
+      remaining -= visited;
+    }
+    return false;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t UserStore::size() const
+  {
+    uint64_t users = 0;
+    for (size_t index = 0; index < shardCount_; ++index)
+    {
+      users += shard(index).size();
+    }
+    return users;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserStore::addUsage(boost::string_view uuid, const UserUsage& delta)
+  {
+    return shard(shardFor(HashIndex::hash(uuid))).addUsage(uuid, delta);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<UserUsage> UserStore::usage(boost::string_view uuid) const
+  {
+    return shard(shardFor(HashIndex::hash(uuid))).usage(uuid);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserUsage UserStore::totalUsage() const
+  {
+    UserUsage total;
+    for (size_t index = 0; index < shardCount_; ++index)
+    {
+      total += shard(index).totalUsage();
+    }
+    return total;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::commit()
+  {
+    for (std::unique_ptr<UserShard>& open : shards_)
+    {
+      if ( open )
+      {
+        open->commit();
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<WriteAheadLog::Clock::time_point> UserStore::commitIfDue()
+  {
+    boost::optional<WriteAheadLog::Clock::time_point> next;
+    if ( mode_ != OpenMode::ReadWrite )
+    {
+      return next;
+    }
+
+    for (std::unique_ptr<UserShard>& open : shards_)
+    {
+      if ( ! open )
+      {
+        continue;
+      }
+      boost::optional<WriteAheadLog::Clock::time_point> due = open->commitIfDue();
+      if ( due && (! next || *due < *next) )
+      {
+        next = due;
+      }
+    }
+    return next;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::setCommitWindow(const WriteAheadLog::CommitWindow& commitWindow)
+  {
+    commitWindow_ = commitWindow;
+    for (std::unique_ptr<UserShard>& open : shards_)
+    {
+      if ( open )
+      {
+        open->setCommitWindow(commitWindow);
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::sync()
+  {
+    for (std::unique_ptr<UserShard>& open : shards_)
+    {
+      if ( open )
+      {
+        open->sync();
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserStore::CompactionResult UserStore::compact()
+  {
+    CompactionResult total = CompactionResult();
+    for (size_t index = 0; index < shardCount_; ++index)
+    {
+      addCompaction(total, shard(index).compact());
+    }
+
+    for (size_t index = shardCount_; index < shards_.size(); ++index)
+    {
+      std::vector<std::string> unheld;
+      shard(index).forEach([&](const UserRecord& claim)
+                           {
+                             if ( ! getByEmail(claim.uuid_) )
+                             {
+                               unheld.push_back(claim.uuid_.to_string());
+                             }
+                           });
+      for (const std::string& email : unheld)
+      {
+        shard(index).remove(email);
+      }
+      shard(index).compact(); // claims aren't users, they are left out of the result
+    }
+    return total;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserStore::CompactionResult UserStore::compact(const std::string& directory)
+  {
+    CompactionResult total = CompactionResult();
+    size_t shards = readShardCount(directory);
+    std::vector<std::string> directories = shardDirectories(directory, shards);
+    for (size_t index = 0; index < directories.size(); ++index)
+    {
+      if ( ! UserShard::exists(directories[index]) ) // shards nobody has written to yet have nothing to compact
+      {
+        continue;
+      }
+
+      CompactionResult compacted = UserShard::compact(directories[index]);
+      if ( index < shards ) // claims aren't users, they are left out of the result
+      {
+        addCompaction(total, compacted);
+      }
+    }
+    return total;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t UserStore::shardFor(uint64_t uuidHash) const
+  {
+    /** The low bits pick the slot within a shard's index, shards are picked by the high bits so they don't correlate */
+    return (uuidHash >> 32) % shardCount_;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard& UserStore::shard(size_t index) const
+  {
+    if ( shards_[index] )
+    {
+      return *shards_[index];
+    }
+
+    size_t highest = index;
+    for (size_t above = index + 1; above < shards_.size(); ++above)
+    {
+      if ( shards_[above] )
+      {
+        highest = above;
+        shards_[above].reset();
+      }
+    }
+    for (size_t open = index; open <= highest; ++open)
+    {
+      if ( ! shards_[open] )
+      {
+        shards_[open].reset( new UserShard(shardDirectories_[open], mode_, commitWindow_) );
+        if ( open < shardCount_ && shardCount_ > 1 && mode_ == OpenMode::ReadWrite )
+        {
+          shards_[open]->setPrecommit([this]() { commitClaims(); });
+        }
+      }
+    }
+    return *shards_[index];
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  UserShard& UserStore::claimShard(boost::string_view email) const
+  {
+    return shard(shardCount_ + shardFor(HashIndex::hash(email)));
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool UserStore::claimEmail(boost::string_view email)
+  {
+    buildClaims();
+    if ( ! claimShard(email).contains(email) )
+    {
+      claimShard(email).insert(email);
+      return true;
+    }
+    return ! getByEmail(email); // the claim of a removed user, which is taken over as it is
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::buildClaims()
+  {
+    boost::filesystem::path builtPath = boost::filesystem::path(directory_) / CLAIMS_BUILT_FILE_NAME;
+    if ( claimsBuilt_ || boost::filesystem::exists(builtPath) )
+    {
+      claimsBuilt_ = true;
+      return;
+    }
+
+    for (size_t index = 0; index < shards_.size(); ++index)
+    {
+      shard(index);
+    }
+    if ( ! boost::filesystem::exists(builtPath) ) // another writer may have built them while this one waited
+    {
+      for (size_t index = 0; index < shardCount_; ++index)
+      {
+        shard(index).forEach([&](const UserRecord& user)
+                             {
+                               if ( ! user.email_.empty() && ! claimShard(user.email_).contains(user.email_) )
+                               {
+                                 claimShard(user.email_).insert(user.email_);
+                               }
+                             });
+      }
+      commitClaims();
+      writeStoreFile(builtPath, "", "store email claims mark");
+    }
+    claimsBuilt_ = true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void UserStore::commitClaims() const
+  {
+    for (size_t index = shardCount_; index < shards_.size(); ++index)
+    {
+      if ( shards_[index] )
+      {
+        shards_[index]->commit();
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
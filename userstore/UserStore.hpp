@@ -0,0 +1,183 @@
+#ifndef USERSTORE_USERSTORE_HPP
+#define USERSTORE_USERSTORE_HPP
+
+#include "UserShard.hpp"
+#include "WriteAheadLog.hpp"
+
+#include "boost/utility/string_view.hpp"
+#include "boost/optional.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Persistent collection of users kept in a store directory, split into shards by a hash of the uuid
+   *
+   * Each shard is a UserShard with its own data file, indexes, log and lock in a directory of its own, so writers
+   * working on users in different shards run side by side where a single shard would serialise them, much as RGW
+   * shards a bucket index. The shard count is fixed when the store is made, see create(). A store with one shard, which
+   * is what a store created implicitly by its first writer gets, keeps it in the store directory itself.
+   *
+   * Shards are opened as they are first needed and stay open with the store. Operations on a single user open only
+   * that user's shard. Listing and lookups by email or display name visit every shard.
+   *
+   * Emails are unique across the store. A store with more than one shard keeps a claim on each email in use in one of
+   * as many email claim shards, picked by a hash of the email, so an insert with an email takes its own shard and the
+   * email's claim shard and no other. A claim is a record keyed by the email in a UserShard of its own, committed no
+   * later than the user holding it. Removing a user leaves its claim behind: a claim is only taken to mean the email is
+   * in use once every shard has been checked for it, so reusing a deleted user's email visits every shard, and compact()
+   * drops the claims nobody holds.
+   *
+   * Shard locks are only ever taken in shard order, with the claim shards after every user shard, so processes holding
+   * several shards can't deadlock. Needing a shard below one already held closes (and so flushes) the shards above it,
+   * which are then taken again along with it. A UserRecord can be invalidated by the next call on a sharded store, not
+   * only by the next mutation.
+   */
+  class UserStore
+  {
+  public: // types
+    typedef UserShard::OpenMode OpenMode;
+    typedef UserShard::Visitor Visitor;
+    typedef UserShard::InsertResult InsertResult;
+    typedef UserShard::CompactionResult CompactionResult;
+
+  public: // interface
+    /** Open the store in the given directory, see UserShard for how each shard is opened
+     *
+     * @throws StoreError: if the store's shard count can't be read.
+     */
+    UserStore(const std::string& directory,
+              OpenMode mode,
+              const WriteAheadLog::CommitWindow& commitWindow=WriteAheadLog::CommitWindow());
+
+    /** Closes the shards in the reverse of the order they are locked in */
+    ~UserStore();
+
+    UserStore(const UserStore&) = delete;
+    UserStore& operator=(const UserStore&) = delete;
+
+    /** Make an empty store with the given number of shards
+     *
+     * @throws StoreError: if the directory already holds a store or the shard count is out of range.
+     */
+    static void create(const std::string& directory, unsigned shards);
+
+    size_t shardCount() const { return shardCount_; }
+
+    /** Nothing is inserted unless the result is Inserted, an empty email is never taken */
+    InsertResult insert(boost::string_view uuid,
+                        boost::string_view displayName=boost::string_view(),
+                        boost::string_view email=boost::string_view());
+
+    /** Insert every staged user in the order they were staged, exactly as if insert() was called for each
+     *
+     * @param rejected: called with the position and result of each staged user that wasn't inserted.
+     * @returns the number of users inserted.
+     */
+    uint64_t insert(const StagedUsers& users,
+                    const std::function<void(size_t, InsertResult)>& rejected=nullptr);
+
+    /** @returns false if no user with the uuid exists */
+    bool remove(boost::string_view uuid);
+
+    bool contains(boost::string_view uuid) const;
+
+    boost::optional<UserRecord> get(boost::string_view uuid) const;
+
+    boost::optional<UserRecord> getByEmail(boost::string_view email) const;
+
+    /** Call the visitor for every live user with the display name, in no particular order */
+    void forEachWithDisplayName(boost::string_view displayName, const Visitor& visitor) const;
+
+    /** Call the visitor for every live user, shard by shard and in insertion order within each */
+    void forEach(const Visitor& visitor) const;
+
+    /** Call the visitor for up to maxEntries live users in the order forEach() visits them, resuming after the user
+     *  with the marker uuid or from the start if the marker is empty
+     *
+     * See UserShard::forEach, a page costs the same however many users there are.
+     *
+     * @returns true if there are more users after the last one visited.
+     * @throws StoreError: if there never was a user with the marker uuid.
+     */
+    bool forEach(boost::string_view marker, uint64_t maxEntries, const Visitor& visitor) const;
+
+    uint64_t size() const;
+
+    /** Add a change to the usage counters of the user with the uuid, see UserShard::addUsage
+     *
+     * @returns false if no user with the uuid exists.
+     */
+    bool addUsage(boost::string_view uuid, const UserUsage& delta);
+
+    /** @returns the usage counters of the user with the uuid, or none if no user with the uuid exists */
+    boost::optional<UserUsage> usage(boost::string_view uuid) const;
+
+    /** @returns the usage counters of every user in every shard added up */
+    UserUsage totalUsage() const;
+
+    /** Commit any mutations still buffered in the commit window of every open shard */
+    void commit();
+
+    /** Commit the open shards whose buffered mutations have waited out the commit window's time bound
+     *
+     * @returns when the next of the rest are due, none if no open shard has mutations waiting on a time bound.
+     */
+    boost::optional<WriteAheadLog::Clock::time_point> commitIfDue();
+
+    /** Change the commit window of the open shards and those opened from now on */
+    void setCommitWindow(const WriteAheadLog::CommitWindow& commitWindow);
+
+    /** Sync every open shard, usage counters included, see UserShard::sync */
+    void sync();
+
+    /** Compact every shard, see UserShard::compact, dropping the email claims of removed users first */
+    CompactionResult compact();
+
+    /** Compact every shard of the store in a directory while readers carry on, see UserShard::compact */
+    static CompactionResult compact(const std::string& directory);
+
+    const std::string& directory() const { return directory_; }
+
+  private: // methods
+    size_t shardFor(uint64_t uuidHash) const;
+
+    /** The shard, opened in the store's mode if it isn't already, keeping to shard order */
+    UserShard& shard(size_t index) const;
+
+    /** The claim shard for the email, which comes after every user shard, opened like shard() */
+    UserShard& claimShard(boost::string_view email) const;
+
+    /** Claim the email for a user about to be inserted, an existing claim is only honoured if a live user has the email
+     *
+     * @returns false if the email is in use.
+     */
+    bool claimEmail(boost::string_view email);
+
+    /** Claim the email of every user in a store sharded before emails were claimed, once */
+    void buildClaims();
+
+    /** Commit the claim shards, ahead of any commit of a user shard */
+    void commitClaims() const;
+
+  private: // data
+    std::string directory_;
+    OpenMode mode_;
+    WriteAheadLog::CommitWindow commitWindow_;
+    size_t shardCount_;
+    bool claimsBuilt_;
+    std::vector<std::string> shardDirectories_;              // the user shards', then any claim shards'
+    mutable std::vector<std::unique_ptr<UserShard>> shards_; // null until first needed
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_USERSTORE_HPP
@@ -0,0 +1,63 @@
+#include "Utils.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+namespace
+{
+  const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78; // reflected Castagnoli polynomial
+
+  struct Crc32cTable
+  {
+    uint32_t entries_[256];
+
+    Crc32cTable()
+    {
+      for (uint32_t index = 0; index < 256; ++index)
+      {
+        uint32_t crc = index;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+          crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+        }
+        entries_[index] = crc;
+      }
+    }
+
+  }; // struct
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  StoreError::StoreError(const std::string& whatMessage, const std::string& path) :
+    std::runtime_error(whatMessage),
+    path_(path)
+  {
+
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  StoreError systemError(const std::string& what, const std::string& path)
+  {
+    return StoreError(what + " (" + path + "): " + std::strerror(errno), path);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint32_t crc32c(const void* data, size_t length, uint32_t seed)
+  {
+    static const Crc32cTable table;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint32_t crc = ~seed;
+    for (size_t index = 0; index < length; ++index)
+    {
+      crc = table.entries_[(crc ^ bytes[index]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
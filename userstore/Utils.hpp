@@ -0,0 +1,42 @@
+#ifndef USERSTORE_UTILS_HPP
+#define USERSTORE_UTILS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Exception type raised for any failure to open, read or modify a user store
+   *
+   * Carries the path of the file involved so the application can report something more useful than an errno string.
+   */
+  class StoreError : public std::runtime_error
+  {
+  public: // interface
+    StoreError(const std::string& whatMessage, const std::string& path=std::string());
+
+    virtual ~StoreError() throw() {} // required by runtime_error inheritance
+
+    const std::string& path() const { return path_; }
+
+  private: // data
+    std::string path_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+  /** Build a StoreError from the current errno, in the form "<what> (<path>): <strerror>"
+   */
+  StoreError systemError(const std::string& what, const std::string& path);
+
+  /** CRC32C (Castagnoli) of a buffer, pass a previous result as the seed to checksum data in pieces
+   */
+  uint32_t crc32c(const void* data, size_t length, uint32_t seed=0);
+
+} // namespace
+
+#endif // USERSTORE_UTILS_HPP
@@ -0,0 +1,214 @@
+#include "Uuid.hpp"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  const char HEX_DIGITS[] = "0123456789abcdef";
+
+  /** Where each run of hex digits starts in the text, runs are separated by single dashes */
+  const size_t DIGIT_RUN_STARTS[] = { 0, 9, 14, 19, 24 };
+  const size_t DIGIT_RUN_LENGTHS[] = { 8, 4, 4, 4, 12 };
+  const size_t DIGIT_COUNT = 2 * userstore::UUID_BINARY_LENGTH;
+
+  /** Text positions of the dashes, every other position holds a hex digit */
+  bool isDashPosition(size_t position)
+  {
+    return position == 8 || position == 13 || position == 18 || position == 23;
+  }
+
+  bool hasCanonicalLayout(boost::string_view text)
+  {
+    return text.size() == userstore::UUID_TEXT_LENGTH
+           && text[8] == '-' && text[13] == '-' && text[18] == '-' && text[23] == '-';
+  }
+
+  /** Copy the 32 digits out of the text, without the dashes */
+  void gatherDigits(const char* text, char* digits)
+  {
+    for (size_t run = 0; run < sizeof(DIGIT_RUN_STARTS) / sizeof(DIGIT_RUN_STARTS[0]); ++run)
+    {
+      std::memcpy(digits, text + DIGIT_RUN_STARTS[run], DIGIT_RUN_LENGTHS[run]);
+      digits += DIGIT_RUN_LENGTHS[run];
+    }
+  }
+
+  /** Put the 32 digits into the text around the dashes */
+  void scatterDigits(const char* digits, char* text)
+  {
+    for (size_t run = 0; run < sizeof(DIGIT_RUN_STARTS) / sizeof(DIGIT_RUN_STARTS[0]); ++run)
+    {
+      std::memcpy(text + DIGIT_RUN_STARTS[run], digits, DIGIT_RUN_LENGTHS[run]);
+      digits += DIGIT_RUN_LENGTHS[run];
+    }
+    for (size_t position : { 8, 13, 18, 23 })
+    {
+      text[position] = '-';
+    }
+  }
+
+  /** @returns the value of a lower case hex digit, or -1 */
+  int hexValue(char digit)
+  {
+    if ( digit >= '0' && digit <= '9' )
+    {
+      return digit - '0';
+    }
+    if ( digit >= 'a' && digit <= 'f' )
+    {
+      return digit - 'a' + 10;
+    }
+    return -1;
+  }
+
+  bool isHexDigit(char digit)
+  {
+    return hexValue(digit) >= 0 || (digit >= 'A' && digit <= 'F');
+  }
+
+#ifdef __SSE2__
+  /** Turn 16 lower case hex digits into 8 bytes, each in the low half of a 16 bit lane
+   *
+   * @returns false if any of them isn't a lower case hex digit.
+   */
+  bool packDigits(__m128i digits, __m128i& packed)
+  {
+    /** Bytes from 0x80 up compare as negative, so they fail both ranges */
+    __m128i decimal = _mm_and_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8('0' - 1)),
+                                    _mm_cmplt_epi8(digits, _mm_set1_epi8('9' + 1)));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmplt_epi8(digits, _mm_set1_epi8('f' + 1)));
+    if ( _mm_movemask_epi8(_mm_or_si128(decimal, letter)) != 0xFFFF )
+    {
+      return false;
+    }
+
+    __m128i values = _mm_sub_epi8(_mm_sub_epi8(digits, _mm_set1_epi8('0')),
+                                  _mm_and_si128(letter, _mm_set1_epi8('a' - '0' - 10)));
+
+    /** Each 16 bit lane holds a digit pair, the first (high nibble) in its low byte */
+    packed = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4), _mm_srli_epi16(values, 8));
+    return true;
+  }
+
+  /** Turn 8 bytes, each in a 16 bit lane, into 16 lower case hex digits */
+  __m128i unpackDigits(__m128i bytes)
+  {
+    __m128i nibbles = _mm_or_si128(_mm_srli_epi16(bytes, 4), _mm_slli_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0x000F)), 8));
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+  }
+#endif
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool parseUuid(boost::string_view text, uint8_t* binary)
+  {
+    if ( ! hasCanonicalLayout(text) )
+    {
+      return false;
+    }
+
+    char digits[DIGIT_COUNT];
+    gatherDigits(text.data(), digits);
+
+#ifdef __SSE2__
+    __m128i high, low;
+    if ( ! packDigits(_mm_loadu_si128(reinterpret_cast<const __m128i*>(digits)), high)
+         || ! packDigits(_mm_loadu_si128(reinterpret_cast<const __m128i*>(digits + 16)), low) )
+    {
+      return false;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(binary), _mm_packus_epi16(high, low));
+#else
+    for (size_t byte = 0; byte < UUID_BINARY_LENGTH; ++byte)
+    {
+      int high = hexValue(digits[2 * byte]);
+      int low = hexValue(digits[2 * byte + 1]);
+      if ( high < 0 || low < 0 )
+      {
+        return false;
+      }
+      binary[byte] = static_cast<uint8_t>(high << 4 | low);
+    }
+#endif
+    return true;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void formatUuid(const uint8_t* binary, char* text)
+  {
+    char digits[DIGIT_COUNT];
+
+#ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(binary));
+    __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digits), unpackDigits(_mm_unpacklo_epi8(bytes, zero)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digits + 16), unpackDigits(_mm_unpackhi_epi8(bytes, zero)));
+#else
+    for (size_t byte = 0; byte < UUID_BINARY_LENGTH; ++byte)
+    {
+      digits[2 * byte] = HEX_DIGITS[binary[byte] >> 4];
+      digits[2 * byte + 1] = HEX_DIGITS[binary[byte] & 0xF];
+    }
+#endif
+
+    scatterDigits(digits, text);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool uuidEquals(const uint8_t* one, const uint8_t* other)
+  {
+#ifdef __SSE2__
+    __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(one)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(other)));
+    return _mm_movemask_epi8(equal) == 0xFFFF;
+#else
+    return std::memcmp(one, other, UUID_BINARY_LENGTH) == 0;
+#endif
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool isMalformedUuid(boost::string_view text)
+  {
+    uint8_t binary[UUID_BINARY_LENGTH];
+    if ( parseUuid(text, binary) )
+    {
+      return false;
+    }
+    if ( text.empty() )
+    {
+      return true;
+    }
+
+    for (char character : text)
+    {
+      if ( static_cast<unsigned char>(character) <= ' ' || character == '\x7F' )
+      {
+        return true;
+      }
+    }
+
+    if ( hasCanonicalLayout(text) )
+    {
+      for (size_t position = 0; position < UUID_TEXT_LENGTH; ++position)
+      {
+        if ( ! isDashPosition(position) && ! isHexDigit(text[position]) )
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
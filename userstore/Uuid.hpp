@@ -0,0 +1,62 @@
+#ifndef USERSTORE_UUID_HPP
+#define USERSTORE_UUID_HPP
+
+#include "boost/utility/string_view.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Conversions between the canonical text form of a uuid (8-4-4-4-12 lower case hex digits) and its 16 bytes
+   *
+   * On x86 parsing, formatting and comparing work on all the digits or bytes at once with SSE2, which every x86-64
+   * has, elsewhere they fall back to a byte at a time.
+   */
+  const size_t UUID_TEXT_LENGTH = 36;
+  const size_t UUID_BINARY_LENGTH = 16;
+
+  /** Parse the canonical text form, anything else (upper case digits included) is rejected so that formatting the
+   *  result gives back exactly the text that was parsed
+   *
+   * @returns false if the text is not a canonical uuid.
+   */
+  bool parseUuid(boost::string_view text, uint8_t* binary);
+
+  /** Write the canonical text form, UUID_TEXT_LENGTH characters without a terminator */
+  void formatUuid(const uint8_t* binary, char* text);
+
+  /** Compare two binary uuids, neither needs to be aligned */
+  bool uuidEquals(const uint8_t* one, const uint8_t* other);
+
+  /** @returns true for text that can't be a uuid at all
+   *
+   * Uuids needn't be canonical, any other text is stored as it is, but an empty uuid, one holding white space or
+   * control characters (which would break the tab separated output and input files) or one laid out as a canonical
+   * uuid with something other than hex digits in it is malformed.
+   */
+  bool isMalformedUuid(boost::string_view text);
+
+//**********************************************************************************************************************
+  /** A uuid in its binary form, compared as a single 128 bit value
+   */
+  struct Uuid
+  {
+    /** @returns false if the text is not a canonical uuid, see parseUuid() */
+    static bool parse(boost::string_view text, Uuid& uuid) { return parseUuid(text, uuid.bytes_); }
+
+    bool operator==(const Uuid& other) const { return uuidEquals(bytes_, other.bytes_); }
+    bool operator!=(const Uuid& other) const { return ! (*this == other); }
+
+    boost::string_view bytes() const { return boost::string_view(reinterpret_cast<const char*>(bytes_), sizeof(bytes_)); }
+
+    alignas(16) uint8_t bytes_[UUID_BINARY_LENGTH];
+
+  }; // struct
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_UUID_HPP
@@ -0,0 +1,99 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  WorkStealingPool::WorkStealingPool(unsigned threads) :
+    queued_(0),
+    nextQueue_(0),
+    stopping_(false)
+  {
+    threads = std::max(threads, 1u);
+    for (unsigned queue = 0; queue < threads; ++queue)
+    {
+      queues_.emplace_back( new Queue() );
+    }
+    for (unsigned worker = 0; worker < threads; ++worker)
+    {
+      threads_.emplace_back(&WorkStealingPool::work, this, worker);
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  WorkStealingPool::~WorkStealingPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(idleMutex_);
+      stopping_ = true;
+    }
+    workAvailable_.notify_all();
+
+    for (std::thread& thread : threads_)
+    {
+      thread.join();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WorkStealingPool::submit(Task task)
+  {
+    Queue& queue = *queues_[nextQueue_++ % queues_.size()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex_);
+      queue.tasks_.push_back(std::move(task));
+    }
+
+    /** Counted under the idle lock so a worker can't check for work, miss this task and then sleep through the notify */
+    {
+      std::lock_guard<std::mutex> lock(idleMutex_);
+      ++queued_;
+    }
+    workAvailable_.notify_one();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WorkStealingPool::work(unsigned self)
+  {
+    for (;;)
+    {
+      Task task;
+      if ( take(self, task) )
+      {
+        task();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(idleMutex_);
+      workAvailable_.wait(lock, [this]() { return queued_ > 0 || stopping_; });
+      if ( stopping_ && queued_ == 0 )
+      {
+        return;
+      }
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  bool WorkStealingPool::take(unsigned self, Task& task)
+  {
+    for (size_t attempt = 0; attempt < queues_.size(); ++attempt) // own queue first, then the others in turn
+    {
+      Queue& queue = *queues_[(self + attempt) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex_);
+      if ( queue.tasks_.empty() )
+      {
+        continue;
+      }
+
+      task = std::move(queue.tasks_.front());
+      queue.tasks_.pop_front();
+      --queued_;
+      return true;
+    }
+    return false;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
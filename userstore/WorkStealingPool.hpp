@@ -0,0 +1,77 @@
+#ifndef USERSTORE_WORKSTEALINGPOOL_HPP
+#define USERSTORE_WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Fixed size pool of threads that each run tasks from their own queue and steal from the others when it is empty
+   *
+   * Submitted tasks are dealt round robin onto the workers' queues, and a worker that runs out steals from the others
+   * so uneven tasks don't leave threads idle while another still has a backlog. Tasks are taken oldest first both from
+   * a worker's own queue and when stealing, so work submitted in order also finishes roughly in order, which is what a
+   * consumer merging results in order wants. Tasks are expected to be coarse (thousands of users each), so every queue
+   * has its own lock rather than being lock free.
+   *
+   * Tasks must not throw, anything that can fail should capture its error for the submitter to pick up.
+   */
+  class WorkStealingPool
+  {
+  public: // types
+    typedef std::function<void()> Task;
+
+  public: // interface
+    /** Start the threads, a pool always has at least one */
+    explicit WorkStealingPool(unsigned threads);
+
+    /** Runs every task still queued then joins the threads */
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void submit(Task task);
+
+    unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+  private: // types
+    struct Queue
+    {
+      std::mutex mutex_;
+      std::deque<Task> tasks_;
+
+    }; // struct
+
+  private: // methods
+    void work(unsigned self);
+
+    /** Take a task from the worker's own queue, or steal one from another */
+    bool take(unsigned self, Task& task);
+
+  private: // data
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<uint64_t> queued_;  // tasks submitted and not yet taken by a worker
+    std::atomic<unsigned> nextQueue_;
+
+    std::mutex idleMutex_;          // guards stopping_ and the wait for work
+    std::condition_variable workAvailable_;
+    bool stopping_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_WORKSTEALINGPOOL_HPP
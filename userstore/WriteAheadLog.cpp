@@ -0,0 +1,329 @@
+#include "WriteAheadLog.hpp"
+
+#include "MappedFile.hpp"
+#include "Utils.hpp"
+
+#include "boost/filesystem.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  const char LOG_MAGIC[8] = { 'R', 'G', 'W', 'U', 'W', 'A', 'L', '1' };
+  const uint32_t LOG_VERSION = 2; // 2: insert records carry every user field, not just the uuid
+
+  struct LogHeader
+  {
+    char     magic_[8];
+    uint32_t version_;
+    uint32_t reserved_;
+
+  }; // struct
+
+  /** Each record is this header followed by length_ bytes of payload, the checksum covers the operation and payload
+   */
+  struct RecordHeader
+  {
+    uint32_t length_;
+    uint32_t checksum_;
+    uint8_t  operation_;
+
+  }; // struct
+
+  const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t); // packed on disk
+
+  static_assert(sizeof(LogHeader) == 16, "LogHeader is part of the on disk format");
+
+  uint32_t recordChecksum(uint8_t operation, const char* payload, size_t length)
+  {
+    return userstore::crc32c(payload, length, userstore::crc32c(&operation, sizeof(operation)));
+  }
+
+  /** A newly created file only survives a crash once the directory entry pointing at it is on disk too */
+  void syncParentDirectory(const std::string& path)
+  {
+    std::string parent = boost::filesystem::path(path).parent_path().string();
+    int fd = ::open(parent.empty() ? "." : parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if ( fd >= 0 )
+    {
+      ::fsync(fd);
+      ::close(fd);
+    }
+  }
+
+} // namespace
+
+namespace userstore {
+
+//----------------------------------------------------------------------------------------------------------------------
+  WriteAheadLog::WriteAheadLog(const std::string& path, const CommitWindow& window, IoQueue& io) :
+    path_(path),
+    fd_(-1),
+    window_(window),
+    io_(io),
+    registeredBuffer_(nullptr),
+    registeredSize_(0),
+    fileSize_(0),
+    pendingCount_(0)
+  {
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if ( fd_ < 0 )
+    {
+      throw systemError("Unable to open log file", path_);
+    }
+
+    struct stat fileInfo;
+    if ( ::fstat(fd_, &fileInfo) != 0 )
+    {
+      ::close(fd_);
+      throw systemError("Unable to stat log file", path_);
+    }
+    fileSize_ = fileInfo.st_size;
+
+    try
+    {
+      if ( fileSize_ < headerSize() ) // new, or the crash came before the header was written
+      {
+        writeHeader();
+        syncParentDirectory(path_);
+      }
+      else
+      {
+        LogHeader header;
+        if ( ::pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) )
+        {
+          throw systemError("Unable to read log file header", path_);
+        }
+        if ( std::memcmp(header.magic_, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || header.version_ != LOG_VERSION )
+        {
+          throw StoreError("Not a supported user store log: " + path_, path_);
+        }
+      }
+    }
+    catch (...)
+    {
+      ::close(fd_);
+      throw;
+    }
+    io_.registerFile(fd_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  WriteAheadLog::~WriteAheadLog()
+  {
+    try
+    {
+      commit();
+    }
+    catch (StoreError&)
+    {
+      // the records are lost, exactly as if the process had died before committing them
+    }
+    io_.unregisterFile(fd_);
+    ::close(fd_);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint64_t WriteAheadLog::replay(const Replayer& replayer)
+  {
+    if ( fileSize_ == headerSize() )
+    {
+      return 0;
+    }
+
+    uint64_t replayed = 0;
+    uint64_t offset = headerSize();
+    {
+      MappedFile file(path_, false);
+      const char* base = file.data();
+      while ( offset + RECORD_HEADER_SIZE <= file.size() )
+      {
+        RecordHeader record;
+        std::memcpy(&record.length_, base + offset, sizeof(record.length_));
+        std::memcpy(&record.checksum_, base + offset + sizeof(uint32_t), sizeof(record.checksum_));
+        std::memcpy(&record.operation_, base + offset + 2 * sizeof(uint32_t), sizeof(record.operation_));
+
+        const char* payload = base + offset + RECORD_HEADER_SIZE;
+        if ( record.length_ > file.size() - offset - RECORD_HEADER_SIZE
+             || record.checksum_ != recordChecksum(record.operation_, payload, record.length_)
+             || (record.operation_ != static_cast<uint8_t>(Operation::Insert)
+                 && record.operation_ != static_cast<uint8_t>(Operation::Remove)) )
+        {
+          break; // torn write, nothing after this point was committed
+        }
+
+        replayer(static_cast<Operation>(record.operation_), boost::string_view(payload, record.length_));
+        offset += RECORD_HEADER_SIZE + record.length_;
+        ++replayed;
+      }
+    }
+
+    if ( offset != fileSize_ )
+    {
+      if ( ::ftruncate(fd_, offset) != 0 || ::fdatasync(fd_) != 0 )
+      {
+        throw systemError("Unable to truncate torn log tail", path_);
+      }
+      fileSize_ = offset;
+    }
+
+    return replayed;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WriteAheadLog::append(Operation operation, boost::string_view payload)
+  {
+    append(operation, payload, checksum(operation, payload));
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WriteAheadLog::append(Operation operation, boost::string_view payload, uint32_t checksum)
+  {
+    if ( payload.size() > UINT32_MAX )
+    {
+      throw StoreError("Log record is too long to be stored", path_);
+    }
+
+    char header[RECORD_HEADER_SIZE];
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    uint8_t operationByte = static_cast<uint8_t>(operation);
+    std::memcpy(header, &length, sizeof(length));
+    std::memcpy(header + sizeof(uint32_t), &checksum, sizeof(checksum));
+    std::memcpy(header + 2 * sizeof(uint32_t), &operationByte, sizeof(operationByte));
+
+    pending_.append(header, sizeof(header));
+    pending_.append(payload.data(), payload.size());
+    if ( pendingCount_++ == 0 && window_.microseconds_ )
+    {
+      firstPending_ = Clock::now();
+    }
+
+    if ( (window_.records_ && pendingCount_ >= window_.records_)
+         || (window_.microseconds_
+             && Clock::now() - firstPending_ >= std::chrono::microseconds(window_.microseconds_)) )
+    {
+      commit();
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  uint32_t WriteAheadLog::checksum(Operation operation, boost::string_view payload)
+  {
+    return recordChecksum(static_cast<uint8_t>(operation), payload.data(), payload.size());
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  boost::optional<WriteAheadLog::Clock::time_point> WriteAheadLog::commitIfDue()
+  {
+    if ( ! pendingCount_ || ! window_.microseconds_ )
+    {
+      return boost::none;
+    }
+
+    Clock::time_point due = firstPending_ + std::chrono::microseconds(window_.microseconds_);
+    if ( Clock::now() < due )
+    {
+      return due;
+    }
+    commit();
+    return boost::none;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WriteAheadLog::commit()
+  {
+    if ( ! pendingCount_ )
+    {
+      return;
+    }
+    if ( precommit_ )
+    {
+      precommit_();
+    }
+
+    /** pending_ keeps its storage once it has grown to a commit's worth, so this is rarely more than a compare */
+    if ( pending_.data() != registeredBuffer_ || pending_.capacity() != registeredSize_ )
+    {
+      registeredBuffer_ = pending_.data();
+      registeredSize_ = pending_.capacity();
+      io_.registerBuffer(const_cast<char*>(registeredBuffer_), registeredSize_);
+    }
+
+    io_.write(fd_, pending_.data(), pending_.size(), fileSize_, path_);
+    io_.sync(fd_, path_);
+    io_.submit();
+
+    fileSize_ += pending_.size();
+    pending_.clear();
+    pendingCount_ = 0;
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WriteAheadLog::truncate()
+  {
+    assert( ! pendingCount_ && "Truncating the log would drop records that were never committed");
+
+    /** The truncation has to be durable before anything is appended, otherwise a crash could leave new records
+     *  followed by stale ones that still checksum correctly */
+    if ( ::ftruncate(fd_, headerSize()) != 0 || ::fdatasync(fd_) != 0 )
+    {
+      throw systemError("Unable to truncate log file", path_);
+    }
+    fileSize_ = headerSize();
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  size_t WriteAheadLog::headerSize()
+  {
+    return sizeof(LogHeader);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WriteAheadLog::writeHeader()
+  {
+    LogHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, LOG_MAGIC, sizeof(LOG_MAGIC));
+    header.version_ = LOG_VERSION;
+
+    if ( ::ftruncate(fd_, 0) != 0 )
+    {
+      throw systemError("Unable to initialise log file", path_);
+    }
+    writeAll(reinterpret_cast<const char*>(&header), sizeof(header), 0);
+    if ( ::fsync(fd_) != 0 )
+    {
+      throw systemError("Unable to sync log file", path_);
+    }
+    fileSize_ = sizeof(header);
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+  void WriteAheadLog::writeAll(const char* data, size_t length, uint64_t offset)
+  {
+    while ( length > 0 )
+    {
+      ssize_t written = ::pwrite(fd_, data, length, offset);
+      if ( written < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        throw systemError("Unable to write log file", path_);
+      }
+      data += written;
+      length -= written;
+      offset += written;
+    }
+  }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+} // namespace
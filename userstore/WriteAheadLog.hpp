@@ -0,0 +1,141 @@
+#ifndef USERSTORE_WRITEAHEADLOG_HPP
+#define USERSTORE_WRITEAHEADLOG_HPP
+
+#include "IoQueue.hpp"
+
+#include "boost/utility/string_view.hpp"
+#include "boost/optional.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace userstore
+{
+//**********************************************************************************************************************
+  /** Append only log of store mutations, a mutation is durable once the log record holding it has been committed
+   *
+   * Records are checksummed so a write torn by a crash is detected on replay and cut off, everything before it is
+   * intact. Appended records are buffered and written with a single write and fdatasync per commit (group commit), the
+   * commit window decides how many records or how much time may accumulate before that happens. Anything appended but
+   * not yet committed is lost if the process dies.
+   *
+   * The write and the fdatasync of a commit go to the IoQueue as one batch, so with io_uring a commit is a single
+   * system call into a registered buffer and fixed file.
+   */
+  class WriteAheadLog
+  {
+  public: // types
+    enum class Operation : uint8_t { Insert = 1, Remove = 2 };
+
+    /** Commit once either bound is reached, a bound of zero is disabled
+     *
+     * The time bound is checked when a record is appended and by commitIfDue(), there is no background flusher: a
+     * record past it stays pending until one of those or an explicit commit(), so a process left waiting with records
+     * pending calls commitIfDue() by the time it returned. With both bounds disabled records are only committed by an
+     * explicit commit().
+     */
+    struct CommitWindow
+    {
+      CommitWindow(uint32_t records=1, uint64_t microseconds=0) : records_(records), microseconds_(microseconds) {}
+
+      uint32_t records_;
+      uint64_t microseconds_;
+
+    }; // struct
+
+    typedef std::function<void(Operation, boost::string_view)> Replayer;
+
+    typedef std::chrono::steady_clock Clock;
+
+    /** Called before a commit writes anything, see setPrecommit() */
+    typedef std::function<void()> Precommit;
+
+  public: // interface
+    /** Open or create the log file
+     *
+     * @param io: commits are submitted through, it must outlive the log.
+     * @throws StoreError: if the file can't be opened or is not a valid log.
+     */
+    WriteAheadLog(const std::string& path, const CommitWindow& window, IoQueue& io);
+
+    /** Commits anything pending, errors are swallowed as they can't be reported from here */
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /** Call the replayer for every intact record in order, a torn or corrupt tail is truncated away
+     *
+     * @returns the number of records replayed.
+     */
+    uint64_t replay(const Replayer& replayer);
+
+    /** Buffer a record, committing if that fills the commit window */
+    void append(Operation operation, boost::string_view payload);
+
+    /** As above with the checksum already computed by checksum(), so it can be done away from the appending thread */
+    void append(Operation operation, boost::string_view payload, uint32_t checksum);
+
+    /** The checksum a record for the operation and payload is stored with */
+    static uint32_t checksum(Operation operation, boost::string_view payload);
+
+    /** Write every pending record and wait for it to reach stable storage */
+    void commit();
+
+    /** Commit if the first pending record was appended longer ago than the commit window's time bound
+     *
+     * @returns when the pending records are due, none if nothing is pending or the window has no time bound.
+     */
+    boost::optional<Clock::time_point> commitIfDue();
+
+    /** Discard every record, only valid once their effects are durable elsewhere
+     *
+     * @pre: nothing is pending.
+     */
+    void truncate();
+
+    /** Takes effect from the next append, anything already pending stays pending */
+    void setCommitWindow(const CommitWindow& window) { window_ = window; }
+
+    /** Run the callback ahead of every commit that has records to write, so records in another log that these depend
+     *  on can be committed first whichever of the commit window, a sync or an explicit commit() triggers it
+     */
+    void setPrecommit(const Precommit& precommit) { precommit_ = precommit; }
+
+    uint64_t pendingRecords() const { return pendingCount_; }
+
+    /** Bytes of records held, committed or pending, which is what a replay would have to get through */
+    uint64_t size() const { return fileSize_ - headerSize() + pending_.size(); }
+    bool empty() const { return pendingCount_ == 0 && fileSize_ == headerSize(); }
+
+    const std::string& path() const { return path_; }
+
+  private: // methods
+    static size_t headerSize();
+
+    void writeHeader();
+    void writeAll(const char* data, size_t length, uint64_t offset);
+
+  private: // data
+    std::string path_;
+    int fd_;
+    CommitWindow window_;
+    Precommit precommit_;
+    IoQueue& io_;
+    const char* registeredBuffer_; // pending_'s storage as last registered with io_
+    size_t registeredSize_;
+
+    uint64_t fileSize_;   // end of the committed records
+    std::string pending_; // encoded records not yet written
+    uint64_t pendingCount_;
+    Clock::time_point firstPending_;
+
+  }; // class
+
+//**********************************************************************************************************************
+
+} // namespace
+
+#endif // USERSTORE_WRITEAHEADLOG_HPP